@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    AudioBufferView arithmetic, scalar kernels against every vector instruction set.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /** Run op(dst, src) on a (block, channels) buffer with the kernels of the level given as third argument. */
+    template<typename sT, typename Op>
+    void RunBinary(benchmark::State& state, Op&& op)
+    {
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1);
+        PennyBench::ScopedSIMDLevel<sT> level{ state, (Penny::SIMDLevel)state.range(2) };
+
+        juce::AudioBuffer<sT> dstBuffer{ numChannels, blockSize }, srcBuffer{ numChannels, blockSize };
+        juce::AudioBuffer<sT> ramp{ 1, blockSize };
+        PennyBench::FillNoise(dstBuffer, 1);
+        PennyBench::FillNoise(srcBuffer, 2);
+        PennyBench::FillNoise(ramp, 3);
+        Penny::AudioBufferView<sT> dst{ dstBuffer }, src{ srcBuffer };
+
+        for (auto _ : state)
+        {
+            op(dst, src, ramp.getReadPointer(0));
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    template<typename sT>
+    void BM_Add(benchmark::State& state)
+    {
+        RunBinary<sT>(state, [](Penny::AudioBufferView<sT>& dst, const Penny::AudioBufferView<sT>& src, const sT*) { dst += src; });
+    }
+    template<typename sT>
+    void BM_MulScalar(benchmark::State& state)
+    {
+        RunBinary<sT>(state, [](Penny::AudioBufferView<sT>& dst, const Penny::AudioBufferView<sT>&, const sT*) { dst *= (sT)0.999; });
+    }
+    template<typename sT>
+    void BM_MulAdd(benchmark::State& state)
+    {
+        RunBinary<sT>(state, [](Penny::AudioBufferView<sT>& dst, const Penny::AudioBufferView<sT>& src, const sT*) { dst.MulAdd(src, (sT)0.5); });
+    }
+    template<typename sT>
+    void BM_LinearCombination(benchmark::State& state)
+    {
+        RunBinary<sT>(state, [](Penny::AudioBufferView<sT>& dst, const Penny::AudioBufferView<sT>& src, const sT*) { dst.LinearCombination(src, (sT)0.5, (sT)0.5); });
+    }
+    template<typename sT>
+    void BM_CrossFade(benchmark::State& state)
+    {
+        RunBinary<sT>(state, [](Penny::AudioBufferView<sT>& dst, const Penny::AudioBufferView<sT>& src, const sT* ramp) { dst.CrossFade(src, ramp); });
+    }
+
+    /** (block, channels, level) for 256 and 4096 samples, 2 channels, every instruction set. */
+    void LevelArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int blockSize : { 256, 4096 })
+            for (int level = (int)Penny::SIMDLevel::Scalar; level <= (int)Penny::SIMDLevel::AVX512; level++)
+                benchmark->Args({ blockSize, 2, level });
+        benchmark->ArgNames({ "block", "channels", "simd" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Add, float)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_Add, double)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_MulScalar, float)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_MulScalar, double)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_MulAdd, float)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_MulAdd, double)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_LinearCombination, float)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_LinearCombination, double)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_CrossFade, float)->Apply(LevelArgs);
+BENCHMARK_TEMPLATE(BM_CrossFade, double)->Apply(LevelArgs);
@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    Shared helpers of the penny-bench microbenchmarks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace PennyBench
+{
+    constexpr int sampleRate = 48000;
+
+    /** Fill every channel with white noise at -6dB, deterministic so runs compare. */
+    template<typename sT>
+    void FillNoise(juce::AudioBuffer<sT>& buffer, juce::uint32 seed = 1)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+        {
+            sT* data = buffer.getWritePointer(channel);
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+            {
+                seed = seed * 1664525u + 22695477u;
+                data[i] = (sT)((double)(seed >> 8) / (double)(1u << 24) - 0.5);
+            }
+        }
+    }
+
+    /** Report samples (frames times channels) per second. */
+    inline void SetSamplesProcessed(benchmark::State& state, int numChannels, int blockSize)
+    {
+        state.SetItemsProcessed((int64_t)state.iterations() * numChannels * blockSize);
+    }
+
+    /** Block sizes from 32 to 4096 samples times 1, 2 and 8 channels, as (blockSize, numChannels). */
+    inline void BlockAndChannelArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int numChannels : { 1, 2, 8 })
+            for (int blockSize = 32; blockSize <= 4096; blockSize *= 4)
+                benchmark->Args({ blockSize, numChannels });
+        benchmark->ArgNames({ "block", "channels" });
+    }
+
+    /** Run the kernels of level for the lifetime of the object, skip the benchmark if the machine lacks it. */
+    template<typename sT>
+    class ScopedSIMDLevel
+    {
+    public:
+        ScopedSIMDLevel(benchmark::State& state, Penny::SIMDLevel level) : previous{ Penny::SIMDKernels<sT>::GetLevel() }
+        {
+            if ((int)level > (int)Penny::GetSupportedSIMDLevel())
+                state.SkipWithError("instruction set not supported");
+            Penny::SIMDKernels<sT>::SetLevel(level);
+        }
+        ~ScopedSIMDLevel() { Penny::SIMDKernels<sT>::SetLevel(previous); }
+    private:
+        Penny::SIMDLevel previous;
+    };
+}
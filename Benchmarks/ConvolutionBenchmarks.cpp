@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    Direct, uniformly partitioned and non-uniform convolution, and the Prepare of an instance
+    with its impulse response spectra computed, shared in memory or mapped from an IRCache file.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /** Convolution::Convolve of a block with the impulse response, args are (block, channels, irLength). */
+    template<typename sT>
+    void BM_Convolve(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1), irLength = (int)state.range(2);
+
+        juce::AudioBuffer<sT> input{ numChannels, blockSize }, ir{ numChannels, irLength };
+        juce::AudioBuffer<sT> output{ numChannels, blockSize + irLength - 1 };
+        PennyBench::FillNoise(input, 1);
+        PennyBench::FillNoise(ir, 2);
+        Penny::AudioBufferView<sT> inputView{ input }, irView{ ir }, outputView{ output };
+
+        for (auto _ : state)
+        {
+            Penny::Convolution<sT>::Convolve(inputView, irView, outputView);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    /** A Process call of a partitioned convolution, args are (block, channels, irLength). */
+    template<typename Convolution>
+    void RunPartitioned(benchmark::State& state, Convolution& convolution)
+    {
+        using sT = typename Convolution::SampleType;
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1), irLength = (int)state.range(2);
+
+        juce::AudioBuffer<sT> ir{ numChannels, irLength }, buffer{ numChannels, blockSize };
+        PennyBench::FillNoise(ir, 2);
+        Penny::AudioBufferView<sT> irView{ ir };
+        convolution.SetImpulseResponse(irView);
+        convolution.Prepare(PennyBench::sampleRate, blockSize);
+
+        PennyBench::FillNoise(buffer, 1);
+        Penny::AudioBufferView<sT> view{ buffer };
+        Penny::ProcessContext<sT> ctx{ view };
+
+        for (auto _ : state)
+        {
+            convolution.Process(ctx);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    template<typename sT>
+    void BM_FFTConvolution(benchmark::State& state)
+    {
+        Penny::FFTConvolution<sT> convolution{ (int)state.range(1), 512 };
+        RunPartitioned(state, convolution);
+    }
+    template<typename sT>
+    void BM_NonUniformConvolution(benchmark::State& state)
+    {
+        Penny::NonUniformConvolution<sT> convolution{ (int)state.range(1), 128, 8192 };
+        RunPartitioned(state, convolution);
+    }
+
+    /**
+        Args are (irLength, source), the Prepare of a stereo NonUniformConvolution. Source 0 computes the spectra,
+        1 shares them with an instance already prepared, 2 maps them from the files of a previous process.
+    */
+    template<typename sT>
+    void BM_NonUniformConvolutionPrepare(benchmark::State& state)
+    {
+        int irLength = (int)state.range(0), source = (int)state.range(1);
+        constexpr int numChannels = 2, blockSize = 512;
+
+        juce::AudioBuffer<sT> ir{ numChannels, irLength };
+        PennyBench::FillNoise(ir, 2);
+        Penny::AudioBufferView<sT> irView{ ir };
+
+        juce::File directory = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("penny-bench-ircache");
+        Penny::IRCache<sT> cache{};
+        if (source == 2)
+            cache.SetDirectory(directory);
+        // Computes the spectra, and writes the files when source is 2.
+        Penny::NonUniformConvolution<sT> first{ numChannels, 128, 8192 };
+        first.SetIRCache(&cache);
+        first.SetImpulseResponse(irView);
+        first.Prepare(PennyBench::sampleRate, blockSize);
+
+        for (auto _ : state)
+        {
+            // A new process starts with an empty cache, only the files are left.
+            Penny::IRCache<sT> fileCache{};
+            fileCache.SetDirectory(directory);
+
+            Penny::NonUniformConvolution<sT> convolution{ numChannels, 128, 8192 };
+            convolution.SetIRCache(source == 0 ? nullptr : source == 1 ? &cache : &fileCache);
+            convolution.SetImpulseResponse(irView);
+            convolution.Prepare(PennyBench::sampleRate, blockSize);
+            benchmark::DoNotOptimize(convolution.GetStagesNumber());
+        }
+        if (source == 2)
+            directory.deleteRecursively();
+    }
+
+    void PrepareArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int irLength : { PennyBench::sampleRate / 4, PennyBench::sampleRate * 2, PennyBench::sampleRate * 8 })
+            for (int source : { 0, 1, 2 })
+                benchmark->Args({ irLength, source });
+        benchmark->ArgNames({ "ir", "source" });
+        benchmark->Unit(benchmark::kMicrosecond);
+    }
+
+    /**
+        The same IR lengths for the direct, uniform and non-uniform convolutions, so they compare side by side:
+        from the short IRs where direct form wins, through the crossover, to the long reverb IRs.
+        The blocks stop at 512, a direct form pass over 4096 samples of the longest IR takes seconds.
+    */
+    void ConvolutionArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int blockSize : { 64, 512 })
+            for (int irLength : { 16, 64, 256, 1024, 4096, PennyBench::sampleRate / 4, PennyBench::sampleRate * 2 })
+                benchmark->Args({ blockSize, 2, irLength });
+        benchmark->ArgNames({ "block", "channels", "ir" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Convolve, float)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_Convolve, double)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_FFTConvolution, float)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_FFTConvolution, double)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_NonUniformConvolution, float)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_NonUniformConvolution, double)->Apply(ConvolutionArgs);
+BENCHMARK_TEMPLATE(BM_NonUniformConvolutionPrepare, float)->Apply(PrepareArgs);
+BENCHMARK_TEMPLATE(BM_NonUniformConvolutionPrepare, double)->Apply(PrepareArgs);
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    The whole DeepReverb graph, as run by processBlock, in single and double precision, at the host rate
+    and resampled to 48kHz, and idle on a silent input once the tail has decayed.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+#include "DeepReverb.h"
+
+namespace
+{
+    /** Args are (block, subBlock), the host block size against the graph sub-block size (0 for the whole block). */
+    template<typename sT>
+    void BM_DeepReverb(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0), subBlockSize = (int)state.range(1);
+
+        DeepReverb<sT> reverb{};
+        reverb.SetSubBlockSize(subBlockSize);
+        reverb.Prepare(PennyBench::sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> buffer{ DeepReverb<sT>::numChannels, blockSize };
+        Penny::AudioBufferView<sT> view{ buffer };
+
+        for (auto _ : state)
+        {
+            // Fresh input every block, the graph processes in place.
+            state.PauseTiming();
+            PennyBench::FillNoise(buffer);
+            state.ResumeTiming();
+
+            reverb.Process(view);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, DeepReverb<sT>::numChannels, blockSize);
+    }
+
+    void SubBlockArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int blockSize : { 64, 512, 2048, 8192 })
+            for (int subBlockSize : { 0, 32, 64, 128, 256, 512, 1024 })
+                if (subBlockSize < blockSize)
+                    benchmark->Args({ blockSize, subBlockSize });
+        benchmark->ArgNames({ "block", "subBlock" });
+    }
+
+    /** Args are (hostRate, internalRate), 512 samples blocks at the host rate, internalRate 0 runs the graph at the host rate. */
+    template<typename sT>
+    void BM_DeepReverbHostRate(benchmark::State& state)
+    {
+        int hostRate = (int)state.range(0), internalRate = (int)state.range(1);
+        constexpr int blockSize = 512;
+
+        DeepReverb<sT> reverb{};
+        reverb.SetInternalSampleRate(internalRate);
+        reverb.Prepare(hostRate, blockSize);
+
+        juce::AudioBuffer<sT> buffer{ DeepReverb<sT>::numChannels, blockSize };
+        Penny::AudioBufferView<sT> view{ buffer };
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            PennyBench::FillNoise(buffer);
+            state.ResumeTiming();
+
+            reverb.Process(view);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, DeepReverb<sT>::numChannels, blockSize);
+    }
+
+    /** Arg is block, a burst of noise then silence until the graph is idle, only the idle blocks are timed. */
+    template<typename sT>
+    void BM_DeepReverbIdle(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0);
+
+        DeepReverb<sT> reverb{};
+        reverb.Prepare(PennyBench::sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> buffer{ DeepReverb<sT>::numChannels, blockSize };
+        Penny::AudioBufferView<sT> view{ buffer };
+
+        PennyBench::FillNoise(buffer);
+        reverb.Process(view);
+        while (!reverb.IsIdle())
+        {
+            buffer.clear();
+            reverb.Process(view);
+        }
+
+        for (auto _ : state)
+        {
+            reverb.Process(view);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, DeepReverb<sT>::numChannels, blockSize);
+    }
+
+    void HostRateArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int hostRate : { 48000, 96000, 192000 })
+            for (int internalRate : { 0, 48000 })
+                if (internalRate != hostRate)
+                    benchmark->Args({ hostRate, internalRate });
+        benchmark->ArgNames({ "host", "internal" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_DeepReverb, float)->Apply(SubBlockArgs);
+BENCHMARK_TEMPLATE(BM_DeepReverb, double)->Apply(SubBlockArgs);
+BENCHMARK_TEMPLATE(BM_DeepReverbHostRate, float)->Apply(HostRateArgs);
+BENCHMARK_TEMPLATE(BM_DeepReverbIdle, float)->Arg(512)->ArgName("block");
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    DelayLine push/pop across delay lengths, ring layouts and wrap positions.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /**
+        Push a block then pop it delay samples back, args are (block, channels, delay, layout, phase).
+        phase samples are pushed first, so the blocks cross the end of the ring at another position.
+    */
+    template<typename sT>
+    void BM_DelayLinePushPop(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1), delay = (int)state.range(2);
+        auto layout = (Penny::DelayLineLayout)state.range(3);
+        int phase = (int)state.range(4);
+
+        Penny::DelayLine<sT> delayLine{ numChannels, 44100 };
+        delayLine.SetLayout(layout);
+        delayLine.Prepare(PennyBench::sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> input{ numChannels, blockSize }, output{ numChannels, blockSize };
+        PennyBench::FillNoise(input);
+        Penny::AudioBufferView<sT> inputView{ input }, outputView{ output };
+        if (phase > 0)
+        {
+            Penny::AudioBufferView<sT> phaseView{ input, 0, juce::jmin(phase, blockSize) };
+            delayLine.PushSamples(phaseView);
+        }
+
+        for (auto _ : state)
+        {
+            delayLine.PushSamples(inputView);
+            delayLine.PopSamples(outputView, delay);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    /** Pop a block at a fractional, per sample modulated delay, args are (block, channels, interpolation). */
+    template<typename sT>
+    void BM_DelayLineModulatedPop(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1);
+        auto interpolation = (Penny::DelayInterpolation)state.range(2);
+
+        Penny::DelayLine<sT> delayLine{ numChannels, 44100 };
+        delayLine.SetLayout(Penny::DelayLineLayout::Mirrored);
+        delayLine.Prepare(PennyBench::sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> input{ numChannels, blockSize }, output{ numChannels, blockSize }, delays{ 1, blockSize };
+        PennyBench::FillNoise(input);
+        for (int i = 0; i < blockSize; i++)
+            delays.setSample(0, i, (sT)(2000 + 50 * std::sin(0.01 * i)));
+        Penny::AudioBufferView<sT> inputView{ input }, outputView{ output };
+
+        for (auto _ : state)
+        {
+            delayLine.PushSamples(inputView);
+            delayLine.PopSamples(outputView, delays.getReadPointer(0), interpolation);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    void PushPopArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int blockSize : { 64, 512, 4096 })
+            for (int delay : { 64, 4096, 44100 - 4096 })
+                for (int layout = (int)Penny::DelayLineLayout::Compact; layout <= (int)Penny::DelayLineLayout::Mirrored; layout++)
+                    for (int phase : { 0, 37 })
+                        benchmark->Args({ blockSize, 2, juce::jmax(delay, blockSize), layout, phase });
+        benchmark->ArgNames({ "block", "channels", "delay", "layout", "phase" });
+    }
+
+    void ModulatedArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int blockSize : { 64, 512, 4096 })
+            for (int interpolation = (int)Penny::DelayInterpolation::None; interpolation <= (int)Penny::DelayInterpolation::Thiran; interpolation++)
+                benchmark->Args({ blockSize, 2, interpolation });
+        benchmark->ArgNames({ "block", "channels", "interpolation" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_DelayLinePushPop, float)->Apply(PushPopArgs);
+BENCHMARK_TEMPLATE(BM_DelayLinePushPop, double)->Apply(PushPopArgs);
+BENCHMARK_TEMPLATE(BM_DelayLineModulatedPop, float)->Apply(ModulatedArgs);
+BENCHMARK_TEMPLATE(BM_DelayLineModulatedPop, double)->Apply(ModulatedArgs);
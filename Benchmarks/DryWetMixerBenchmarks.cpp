@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    DryWetMixer, with a fixed mix and with the mix ramping every block.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /** Args are (block, channels, ramping). */
+    template<typename sT>
+    void BM_DryWetMixer(benchmark::State& state)
+    {
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1);
+        bool ramping = state.range(2) != 0;
+
+        Penny::DryWetMixer<sT> mixer{ numChannels, 44100 };
+        mixer.Prepare(PennyBench::sampleRate, blockSize);
+        mixer.Reset();
+
+        juce::AudioBuffer<sT> dry{ numChannels, blockSize }, wet{ numChannels, blockSize };
+        PennyBench::FillNoise(dry, 1);
+        PennyBench::FillNoise(wet, 2);
+        Penny::AudioBufferView<sT> dryView{ dry }, wetView{ wet };
+
+        int block = 0;
+        for (auto _ : state)
+        {
+            if (ramping)
+                mixer.SetMixingRatio((block++ & 1) != 0 ? 0.25f : 0.75f);
+            mixer.PushDrySamples(dryView);
+            mixer.DryWetMixing(wetView, 0);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    void MixerArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int numChannels : { 1, 2, 8 })
+            for (int blockSize = 32; blockSize <= 4096; blockSize *= 4)
+                for (int ramping : { 0, 1 })
+                    benchmark->Args({ blockSize, numChannels, ramping });
+        benchmark->ArgNames({ "block", "channels", "ramping" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_DryWetMixer, float)->Apply(MixerArgs);
+BENCHMARK_TEMPLATE(BM_DryWetMixer, double)->Apply(MixerArgs);
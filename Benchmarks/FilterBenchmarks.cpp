@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    CombFilter and AllPassFilter, with a fixed delay and with a delay changed every block, over every
+    delay line layout, and a decaying tail with each denormal protection.
+
+  ==============================================================================
+*/
+
+#include <limits>
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /** Args are (block, channels, delay, moving, layout), a moving delay is set again every block and glides. */
+    template<typename Filter>
+    void RunFilter(benchmark::State& state)
+    {
+        using sT = typename Filter::SampleType;
+        int blockSize = (int)state.range(0), numChannels = (int)state.range(1), delay = (int)state.range(2);
+        bool moving = state.range(3) != 0;
+        auto layout = (Penny::DelayLineLayout)state.range(4);
+
+        Filter filter{ numChannels, 44100 };
+        filter.SetLayout(layout);
+        filter.SetDelay((float)delay);
+        filter.SetGain(0.7f);
+        filter.Prepare(PennyBench::sampleRate, blockSize);
+        filter.Reset();
+
+        juce::AudioBuffer<sT> buffer{ numChannels, blockSize };
+        PennyBench::FillNoise(buffer);
+        Penny::AudioBufferView<sT> view{ buffer };
+        Penny::ProcessContext<sT> ctx{ view };
+
+        int block = 0;
+        for (auto _ : state)
+        {
+            if (moving)
+                filter.SetDelay((float)delay + ((block++ & 1) != 0 ? 10.5f : 0.0f));
+            filter.Process(ctx);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    template<typename sT>
+    void BM_CombFilter(benchmark::State& state)
+    {
+        RunFilter<Penny::CombFilter<sT>>(state);
+    }
+    template<typename sT>
+    void BM_AllPassFilter(benchmark::State& state)
+    {
+        RunFilter<Penny::AllPassFilter<sT>>(state);
+    }
+
+    /**
+        Args are (protection, denormal), silent blocks through the tail of a comb filter at a level of -60dB,
+        or under the smallest normal number once denormal is 1. Nothing here sets the CPU mode, the time per block
+        should not depend on denormal unless protection is None.
+    */
+    template<typename sT>
+    void BM_CombFilterDecay(benchmark::State& state)
+    {
+        auto protection = (Penny::DenormalProtection)state.range(0);
+        bool denormal = state.range(1) != 0;
+        constexpr int blockSize = 256, numChannels = 2, delay = 1617, blocksPerTail = 1000;
+
+        Penny::CombFilter<sT> filter{ numChannels, 44100 };
+        filter.SetLayout(Penny::DelayLineLayout::Mirrored);
+        filter.SetDelay((float)delay);
+        filter.SetGain(0.999f);
+        filter.SetDenormalProtection(protection);
+        filter.Prepare(PennyBench::sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> tail{ numChannels, blockSize };
+        PennyBench::FillNoise(tail);
+        tail.applyGain(denormal ? std::numeric_limits<sT>::min() * (sT)0.01 : (sT)1e-3);
+        juce::AudioBuffer<sT> buffer{ numChannels, blockSize };
+        Penny::AudioBufferView<sT> view{ buffer };
+        Penny::ProcessContext<sT> ctx{ view };
+
+        // Fill the whole delay line with the tail, then let it decay for blocksPerTail blocks.
+        auto startTail = [&]
+        {
+            filter.Reset();
+            for (int i = 0; i <= delay / blockSize; i++)
+            {
+                buffer.makeCopyOf(tail, true);
+                filter.Process(ctx);
+            }
+        };
+        startTail();
+
+        int block = 0;
+        for (auto _ : state)
+        {
+            if (++block == blocksPerTail)
+            {
+                state.PauseTiming();
+                startTail();
+                block = 0;
+                state.ResumeTiming();
+            }
+            buffer.clear();
+            filter.Process(ctx);
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    void DecayArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (auto protection : { Penny::DenormalProtection::None, Penny::DenormalProtection::FlushToZero, Penny::DenormalProtection::NoiseFloor })
+            for (int denormal : { 0, 1 })
+                benchmark->Args({ (int)protection, denormal });
+        benchmark->ArgNames({ "protection", "denormal" });
+    }
+
+    void FilterArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int numChannels : { 1, 2 })
+            for (int blockSize : { 32, 256, 2048 })
+                for (int delay : { 17, 1617, 6430 })
+                    for (int moving : { 0, 1 })
+                        for (int layout = (int)Penny::DelayLineLayout::Compact; layout <= (int)Penny::DelayLineLayout::Mirrored; layout++)
+                            benchmark->Args({ blockSize, numChannels, delay, moving, layout });
+        benchmark->ArgNames({ "block", "channels", "delay", "moving", "layout" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_CombFilter, float)->Apply(FilterArgs);
+BENCHMARK_TEMPLATE(BM_CombFilter, double)->Apply(FilterArgs);
+BENCHMARK_TEMPLATE(BM_AllPassFilter, float)->Apply(FilterArgs);
+BENCHMARK_TEMPLATE(BM_AllPassFilter, double)->Apply(FilterArgs);
+BENCHMARK_TEMPLATE(BM_CombFilterDecay, float)->Apply(DecayArgs);
+BENCHMARK_TEMPLATE(BM_CombFilterDecay, double)->Apply(DecayArgs);
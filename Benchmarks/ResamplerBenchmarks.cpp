@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    The polyphase Resampler, between the usual host rates and the 48kHz the graph can run at.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkUtilities.h"
+
+namespace
+{
+    /** Args are (inputRate, outputRate, block), block is in input samples. */
+    template<typename sT>
+    void BM_Resampler(benchmark::State& state)
+    {
+        int inputRate = (int)state.range(0), outputRate = (int)state.range(1), blockSize = (int)state.range(2);
+        constexpr int numChannels = 2;
+
+        Penny::Resampler<sT> resampler{ numChannels };
+        resampler.SetOutputSampleRate(outputRate);
+        resampler.Prepare(inputRate, blockSize);
+
+        juce::AudioBuffer<sT> input{ numChannels, blockSize };
+        juce::AudioBuffer<sT> output{ numChannels, resampler.GetMaxOutputSamples(blockSize) };
+        PennyBench::FillNoise(input);
+        Penny::AudioBufferView<sT> inputView{ input };
+        Penny::AudioBufferView<sT> outputView{ output };
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(resampler.Process(inputView, outputView));
+            benchmark::ClobberMemory();
+        }
+        PennyBench::SetSamplesProcessed(state, numChannels, blockSize);
+    }
+
+    void RateArgs(benchmark::internal::Benchmark* benchmark)
+    {
+        for (int hostRate : { 44100, 88200, 96000, 192000 })
+        {
+            benchmark->Args({ hostRate, 48000, 512 });
+            benchmark->Args({ 48000, hostRate, 512 * 48000 / hostRate });
+        }
+        benchmark->ArgNames({ "in", "out", "block" });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Resampler, float)->Apply(RateArgs);
+BENCHMARK_TEMPLATE(BM_Resampler, double)->Apply(RateArgs);
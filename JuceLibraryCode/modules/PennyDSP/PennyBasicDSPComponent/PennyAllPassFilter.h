@@ -3,6 +3,8 @@
 #include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
 #include <PennyDSP/PennyBasicDSPComponent/PennyCombFilter.h>
 #include <PennyDSP/PennyBasicDSPComponent/PennyProcessContext.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennySmoothedParameter.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
 
 namespace Penny {
 	template<typename sT>
@@ -15,61 +17,102 @@ namespace Penny {
 		AllPassFilter(int numChannels, int maxDelayInSamples) :
 			numChannels{ numChannels }, maxDelayInSamples{ maxDelayInSamples }, combFilter{ numChannels, maxDelayInSamples } {}
 
-		void SetDelay(int delayInSamples) {
-			jassert(delayInSamples <= maxDelayInSamples);
+		/** Set channels number, it takes effect at the next Prepare. */
+		void SetChannelsNumber(int numChannels) {
+			this->numChannels = numChannels;
+			combFilter.SetChannelsNumber(numChannels);
+		}
+		int GetChannelsNumber() {
+			return numChannels;
+		}
+		/** Set max delay, it takes effect at the next Prepare. */
+		void SetMaxDelay(int maxDelayInSamples) {
+			this->maxDelayInSamples = maxDelayInSamples;
+			combFilter.SetMaxDelay(maxDelayInSamples);
+		}
+		int GetMaxDelay() {
+			return maxDelayInSamples;
+		}
+
+		/** Set the delay, it can be fractional. Changes glide over the delay ramp length. */
+		void SetDelay(float delayInSamples) {
+			jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
 			this->delayInSamples = delayInSamples;
 			combFilter.SetDelay(delayInSamples);
 		}
+		void SetDelayRampLength(double rampLengthInSeconds) {
+			combFilter.SetDelayRampLength(rampLengthInSeconds);
+		}
+		void SetLayout(DelayLineLayout layout) {
+			combFilter.SetLayout(layout);
+		}
+		void SetInterpolation(DelayInterpolation interpolation) {
+			combFilter.SetInterpolation(interpolation);
+		}
+		/** Set the feedback gain, smoothed over the gain ramp length. */
 		void SetGain(float feedbackGain) {
 			jassert(feedbackGain <= 1.0f && feedbackGain >= -1.0f);
 			this->feedbackGain = feedbackGain;
 			combFilter.SetGain(feedbackGain);
+			outputGain.SetTargetValue(-feedbackGain * (1 - feedbackGain * feedbackGain));
+		}
+		void SetGainRampLength(double rampLengthInSeconds) {
+			combFilter.SetGainRampLength(rampLengthInSeconds);
+			outputGain.SetRampLength(rampLengthInSeconds);
+		}
+		/** Set how the feedback is kept from decaying through denormals, FlushToZero by default. */
+		void SetDenormalProtection(DenormalProtection protection) {
+			combFilter.SetDenormalProtection(protection);
+		}
+
+		/** Samples for the output to decay by decayInDecibels, 0 at a gain of 0 or +-1 where the delayed signal is not mixed in. */
+		int GetTailLengthInSamples(double decayInDecibels = 60.0) {
+			if (IsDelayedSignalMuted())
+				return 0;
+			return combFilter.GetTailLengthInSamples(decayInDecibels);
+		}
+		/** The largest absolute sample of the delay line the output can still read, 0 if it is not mixed in. */
+		sT GetStatePeak() {
+			if (IsDelayedSignalMuted())
+				return sT{};
+			return combFilter.GetStatePeak();
 		}
 
 		void Prepare(int sampleRate, int samplesPerBlock) {
-			audioBuffer.setSize(numChannels, samplesPerBlock);
-			audioBuffer.clear();
-			combFilter.Prepare(sampleRate, samplesPerBlock);
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the delay line and the scratch buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			combFilter.Prepare(sampleRate, samplesPerBlock, arena);
+			outputGain.Prepare(sampleRate, samplesPerBlock, arena);
 			isReady = true;
 		}
 		void Process(ProcessContext<sT>& ctx) {
 			if (!isReady)
 				return;
 
-			AudioBufferView<sT> audioBufferView{ audioBuffer };
-			AudioBufferView<sT> inputView = ctx.GetInput();
-			AudioBufferView<sT> outputView = ctx.GetOutput();
-
-			for (int i = 0; i < inputView.GetNumChannels(); i++) {
-				audioBufferView.CopyFrom(i, 0, inputView, i, 0, audioBufferView.GetNumSamples());
-			}
-
-			ProcessContext<sT> combCtx{ inputView };
-			combFilter.Process(combCtx);
-
-			inputView *= 1 - feedbackGain * feedbackGain;
-
-			for (int i = 0; i < inputView.GetNumChannels(); i++) {
-				outputView.CopyFrom(i, 0, inputView, i, 0, outputView.GetNumSamples());
-			}
-
-			outputView *= -feedbackGain;
-			outputView += audioBufferView;
+			// output = input + delayed * outputGain, mixed by the comb filter straight from its delay line.
+			combFilter.Process(ctx, outputGain);
 		}
 		void Reset() {
 			if (!isReady)
 				return;
 
 			combFilter.Reset();
-			audioBuffer.clear();
+			outputGain.Reset();
+		}
+	private:
+		bool IsDelayedSignalMuted() {
+			return outputGain.GetTargetValue() == 0 && !outputGain.IsSmoothing();
 		}
 	private:
 		bool isReady = false;
 		int numChannels = 1;
 		int maxDelayInSamples = 44110;
-		int delayInSamples = 0;
+		float delayInSamples = 0;
 		float feedbackGain = 0.5f;
+		SmoothedParameter<sT> outputGain{ (sT)(-0.5 * (1 - 0.5 * 0.5)) };
 		CombFilter<sT> combFilter{};
-		juce::AudioBuffer<sT> audioBuffer{};
+		Arena ownArena{};
 	};
 }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennyCombFilterBank.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+
+namespace Penny {
+	/** Bank of parallel all-pass filters, one per lane, the interleaved counterpart of AllPassFilter. */
+	template<typename sT>
+	class AllPassFilterBank : public BaseDSP<sT> {
+	public:
+		using SampleType = sT;
+	public:
+		AllPassFilterBank() : AllPassFilterBank(1) {}
+		AllPassFilterBank(int numLanes) : AllPassFilterBank(numLanes, 44110) {}
+		AllPassFilterBank(int numLanes, int maxDelayInSamples) :
+			numLanes{ numLanes }, outputGains(numLanes, (sT)(-0.5 * (1 - 0.5 * 0.5))), combFilterBank{ numLanes, maxDelayInSamples } {}
+
+		int GetLanesNumber() {
+			return numLanes;
+		}
+
+		/** Set the delay of a lane, at least 1 sample. */
+		void SetDelay(int lane, int delayInSamples) {
+			combFilterBank.SetDelay(lane, delayInSamples);
+		}
+		/** Set the feedback gain of a lane. */
+		void SetGain(int lane, float feedbackGain) {
+			combFilterBank.SetGain(lane, feedbackGain);
+			outputGains[lane] = -feedbackGain * (1 - feedbackGain * feedbackGain);
+			if (isReady)
+				combFilterBank.FillLanePattern(outputPattern.getWritePointer(0), outputGains.data());
+		}
+		/** Set how the feedback is kept from decaying through denormals, FlushToZero by default. */
+		void SetDenormalProtection(DenormalProtection protection) {
+			combFilterBank.SetDenormalProtection(protection);
+		}
+
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the delay lines and the scratch buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			combFilterBank.Prepare(sampleRate, samplesPerBlock, arena);
+			interleaved.SetSize(numLanes, samplesPerBlock, arena);
+			arena.AllocateBuffer(outputPattern, 1, numLanes * samplesPerBlock);
+			combFilterBank.FillLanePattern(outputPattern.getWritePointer(0), outputGains.data());
+			isReady = true;
+		}
+
+		/** Process one channel per lane. */
+		void Process(ProcessContext<sT>& ctx) {
+			if (!isReady)
+				return;
+
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			jassert(output.GetNumChannels() >= numLanes);
+			interleaved.CopyFrom(ctx.GetInput());
+			ProcessInterleaved(interleaved.GetData(), interleaved.GetData(), output.GetNumSamples());
+			interleaved.CopyTo(output);
+		}
+		/** Process numSamples interleaved frames, input can be output. */
+		void ProcessInterleaved(const sT* input, sT* output, int numSamples) {
+			// output = input + delayed * outputGain, mixed by the comb filter bank.
+			combFilterBank.ProcessInterleaved(input, output, numSamples, outputPattern.getReadPointer(0));
+		}
+
+		void Reset() {
+			combFilterBank.Reset();
+		}
+	private:
+		bool isReady = false;
+		int numLanes = 1;
+		std::vector<sT> outputGains;
+		CombFilterBank<sT> combFilterBank;
+		InterleavedBuffer<sT> interleaved{};
+		juce::AudioBuffer<sT> outputPattern{};
+		Arena ownArena{};
+	};
+}
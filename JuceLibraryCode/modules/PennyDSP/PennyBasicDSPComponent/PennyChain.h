@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <PennyDSP/PennyBasicDSPComponent/PennyProcessContext.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+#include <PennyDSP/PennyThreading/PennyProfiler.h>
+
+namespace Penny {
+	namespace Chain_Impl {
+		template<typename...> struct MakeVoid { using type = void; };
+		template<typename... T> using VoidType = typename MakeVoid<T...>::type;
+
+		/** A stage is element wise if it declares isElementwise and has ProcessSample(sample, channel). */
+		template<typename Stage, typename = void>
+		struct IsElementwise : std::false_type {};
+		template<typename Stage>
+		struct IsElementwise<Stage, typename std::enable_if<Stage::isElementwise>::type> : std::true_type {};
+
+		template<typename Stage, typename = void>
+		struct HasArenaPrepare : std::false_type {};
+		template<typename Stage>
+		struct HasArenaPrepare<Stage, VoidType<decltype(std::declval<Stage&>().Prepare(0, 0, std::declval<Arena&>()))>> : std::true_type {};
+
+		template<typename Stage, typename = void>
+		struct HasLatency : std::false_type {};
+		template<typename Stage>
+		struct HasLatency<Stage, VoidType<decltype(std::declval<Stage&>().GetLatencyInSamples())>> : std::true_type {};
+
+		template<typename Stage, typename = void>
+		struct HasTailLength : std::false_type {};
+		template<typename Stage>
+		struct HasTailLength<Stage, VoidType<decltype(std::declval<Stage&>().GetTailLengthInSamples())>> : std::true_type {};
+
+		template<typename Stage>
+		void Prepare(Stage& stage, int sampleRate, int samplesPerBlock, Arena& arena, std::true_type) { stage.Prepare(sampleRate, samplesPerBlock, arena); }
+		template<typename Stage>
+		void Prepare(Stage& stage, int sampleRate, int samplesPerBlock, Arena&, std::false_type) { stage.Prepare(sampleRate, samplesPerBlock); }
+
+		template<typename Stage>
+		int GetLatency(Stage& stage, std::true_type) { return stage.GetLatencyInSamples(); }
+		template<typename Stage>
+		int GetLatency(Stage&, std::false_type) { return 0; }
+		template<typename Stage>
+		int GetTailLength(Stage& stage, std::true_type) { return stage.GetTailLengthInSamples(); }
+		template<typename Stage>
+		int GetTailLength(Stage&, std::false_type) { return 0; }
+
+		/** Index of the first stage from I that is not element wise, or the number of stages. */
+		template<typename StageTuple, size_t I, bool = (I < std::tuple_size<StageTuple>::value)>
+		struct ElementwiseRunEnd { static constexpr size_t value = I; };
+		template<typename StageTuple, size_t I>
+		struct ElementwiseRunEnd<StageTuple, I, true> {
+			static constexpr size_t value = IsElementwise<typename std::tuple_element<I, StageTuple>::type>::value ?
+				ElementwiseRunEnd<StageTuple, I + 1>::value : I;
+		};
+	}
+
+	/**
+	 * Stages processed one after the other, composed at compile time so every call is resolved statically.
+	 * Consecutive element wise stages (see Gain) are fused in a single pass over the block.
+	 * The chain can also cut the block in sub-blocks that go through every stage in turn, so the data
+	 * stays in the L1 cache with large host blocks. The stages are configured through Get<I>().
+	 */
+	template<typename... Stages>
+	class Chain {
+		static_assert(sizeof...(Stages) > 0, "A chain needs at least one stage.");
+		using StageTuple = std::tuple<Stages...>;
+	public:
+		using SampleType = typename std::tuple_element<0, StageTuple>::type::SampleType;
+		static constexpr size_t numStages = sizeof...(Stages);
+		template<size_t I>
+		using StageType = typename std::tuple_element<I, StageTuple>::type;
+		/** The stages run on the whole block. */
+		static constexpr int wholeBlock = 0;
+	public:
+		Chain() {}
+
+		template<size_t I>
+		StageType<I>& Get() noexcept { return std::get<I>(stages); }
+		template<size_t I>
+		const StageType<I>& Get() const noexcept { return std::get<I>(stages); }
+
+		/** Set the length of the sub-blocks the stages process, or wholeBlock. It takes effect at the next Prepare. */
+		void SetSubBlockSize(int subBlockSize) {
+			jassert(subBlockSize >= 0);
+			this->subBlockSize = subBlockSize;
+		}
+		int GetSubBlockSize() {
+			return subBlockSize;
+		}
+		/** Lap profiler after every stage, stage I is charged to firstStage + I and a fused run to its first stage. */
+		void SetProfiler(Profiler* profiler, int firstStage) {
+			this->profiler = profiler;
+			firstProfilerStage = firstStage;
+		}
+
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the stages that support it allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			// The stages only ever see sub-blocks, their scratch buffers are sized for them.
+			int stageBlockSize = subBlockSize == wholeBlock ? samplesPerBlock : juce::jmin(subBlockSize, samplesPerBlock);
+			PrepareFrom<0>(sampleRate, stageBlockSize, arena, IsEnd<0>{});
+		}
+
+		void Process(ProcessContext<SampleType>& ctx) {
+			ctx.ForEachSubBlock(subBlockSize, [this](ProcessContext<SampleType>& subCtx) { ProcessFrom<0>(subCtx, IsEnd<0>{}); });
+		}
+
+		void Reset() {
+			ResetFrom<0>(IsEnd<0>{});
+		}
+
+		/** Sum of the latencies of the stages that report one. */
+		int GetLatencyInSamples() {
+			return LatencyFrom<0>(IsEnd<0>{});
+		}
+		/** Sum of the tail lengths of the stages that report one, std::numeric_limits<int>::max() if one is infinite. */
+		int GetTailLengthInSamples() {
+			return TailLengthFrom<0>(IsEnd<0>{});
+		}
+
+		/** Call f on every stage in order, f must take each stage type (a generic lambda for different ones). */
+		template<typename F>
+		void ForEach(F&& f) {
+			ForEachFrom<0>(f, IsEnd<0>{});
+		}
+	private:
+		template<size_t I>
+		using IsEnd = std::integral_constant<bool, I == numStages>;
+
+		template<size_t I>
+		void PrepareFrom(int, int, Arena&, std::true_type) {}
+		template<size_t I>
+		void PrepareFrom(int sampleRate, int samplesPerBlock, Arena& arena, std::false_type) {
+			Chain_Impl::Prepare(std::get<I>(stages), sampleRate, samplesPerBlock, arena, Chain_Impl::HasArenaPrepare<StageType<I>>{});
+			PrepareFrom<I + 1>(sampleRate, samplesPerBlock, arena, IsEnd<I + 1>{});
+		}
+
+		template<size_t I>
+		void ResetFrom(std::true_type) {}
+		template<size_t I>
+		void ResetFrom(std::false_type) {
+			std::get<I>(stages).Reset();
+			ResetFrom<I + 1>(IsEnd<I + 1>{});
+		}
+
+		template<size_t I>
+		int LatencyFrom(std::true_type) { return 0; }
+		template<size_t I>
+		int LatencyFrom(std::false_type) {
+			return Chain_Impl::GetLatency(std::get<I>(stages), Chain_Impl::HasLatency<StageType<I>>{}) + LatencyFrom<I + 1>(IsEnd<I + 1>{});
+		}
+		template<size_t I>
+		int TailLengthFrom(std::true_type) { return 0; }
+		template<size_t I>
+		int TailLengthFrom(std::false_type) {
+			long long tailLength = (long long)Chain_Impl::GetTailLength(std::get<I>(stages), Chain_Impl::HasTailLength<StageType<I>>{}) + TailLengthFrom<I + 1>(IsEnd<I + 1>{});
+			return (int)juce::jmin(tailLength, (long long)std::numeric_limits<int>::max());
+		}
+
+		template<size_t I, typename F>
+		void ForEachFrom(F&, std::true_type) {}
+		template<size_t I, typename F>
+		void ForEachFrom(F& f, std::false_type) {
+			f(std::get<I>(stages));
+			ForEachFrom<I + 1>(f, IsEnd<I + 1>{});
+		}
+
+		/** Process the stages from I, the stages after the first one run in place on the output. */
+		template<size_t I>
+		void ProcessFrom(ProcessContext<SampleType>&, std::true_type) {}
+		template<size_t I>
+		void ProcessFrom(ProcessContext<SampleType>& ctx, std::false_type) {
+			ProcessStage<I>(ctx, Chain_Impl::IsElementwise<StageType<I>>{});
+		}
+
+		template<size_t I>
+		void ProcessStage(ProcessContext<SampleType>& ctx, std::false_type) {
+			std::get<I>(stages).Process(ctx);
+			PENNY_PROFILE_LAP(profiler, firstProfilerStage + (int)I);
+			ProcessContext<SampleType> next{ ctx.GetOutput() };
+			ProcessFrom<I + 1>(next, IsEnd<I + 1>{});
+		}
+		/** Run the element wise stages from I to the next other stage in a single pass. */
+		template<size_t I>
+		void ProcessStage(ProcessContext<SampleType>& ctx, std::true_type) {
+			constexpr size_t end = Chain_Impl::ElementwiseRunEnd<StageTuple, I>::value;
+			const AudioBufferView<SampleType>& input = ctx.GetInput();
+			AudioBufferView<SampleType>& output = ctx.GetOutput();
+			for (int channel = 0; channel < output.GetNumChannels(); channel++) {
+				const SampleType* in = input.GetConstChannelPtr(channel);
+				SampleType* out = output.GetChannelPtr(channel);
+				for (int i = 0; i < output.GetNumSamples(); i++)
+					out[i] = ProcessSample<I, end>(in[i], channel, std::integral_constant<bool, I == end>{});
+			}
+			PENNY_PROFILE_LAP(profiler, firstProfilerStage + (int)I);
+			ProcessContext<SampleType> next{ output };
+			ProcessFrom<end>(next, IsEnd<end>{});
+		}
+
+		template<size_t I, size_t End>
+		inline SampleType ProcessSample(SampleType sample, int, std::true_type) { return sample; }
+		template<size_t I, size_t End>
+		inline SampleType ProcessSample(SampleType sample, int channel, std::false_type) {
+			return ProcessSample<I + 1, End>(std::get<I>(stages).ProcessSample(sample, channel), channel, std::integral_constant<bool, I + 1 == End>{});
+		}
+	private:
+		int subBlockSize = wholeBlock;
+		StageTuple stages;
+		Arena ownArena{};
+		Profiler* profiler = nullptr;
+		int firstProfilerStage = 0;
+	};
+}
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <cmath>
+#include <limits>
+#include <utility>
+
 #include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
 #include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+#include <PennyDSP/PennySIMD/PennyDenormals.h>
 #include <PennyDSP/PennyBasicDSPComponent/PennyDelayLine.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennySmoothedParameter.h>
 
 namespace Penny {
 	template<typename sT>
@@ -15,66 +22,244 @@ namespace Penny {
 		CombFilter(int numChannels, int maxDelayInSamples) : 
 			numChannels{ numChannels }, maxDelayInSamples{ maxDelayInSamples }, delayLine{numChannels, maxDelayInSamples} {}
 
-		void SetDelay(int delayInSamples) {
-			jassert(delayInSamples <= maxDelayInSamples);
-			this->delayInSamples = delayInSamples;
+		/** Set channels number, it takes effect at the next Prepare. */
+		void SetChannelsNumber(int numChannels) {
+			this->numChannels = numChannels;
+			delayLine.SetChannelsNumber(numChannels);
+		}
+		int GetChannelsNumber() {
+			return numChannels;
+		}
+		/** Set max delay, it takes effect at the next Prepare. */
+		void SetMaxDelay(int maxDelayInSamples) {
+			this->maxDelayInSamples = maxDelayInSamples;
+			delayLine.SetMaxDelay(maxDelayInSamples);
+		}
+		int GetMaxDelay() {
+			return maxDelayInSamples;
+		}
+
+		/** Set the delay, it can be fractional. Changes glide over the delay ramp length. */
+		void SetDelay(float delayInSamples) {
+			jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
+			delay.SetTargetValue(delayInSamples);
+		}
+		void SetDelayRampLength(double rampLengthInSeconds) {
+			delay.SetRampLength(rampLengthInSeconds);
+		}
+		/** Set the ring buffer layout of the delay line, will reset the filter. */
+		void SetLayout(DelayLineLayout layout) {
+			delayLine.SetLayout(layout);
 		}
+		/** Set the interpolation of the delay line, gliding delays use at least linear interpolation. */
+		void SetInterpolation(DelayInterpolation interpolation) {
+			this->interpolation = interpolation;
+		}
+		/** Set the feedback gain, smoothed over the gain ramp length. */
 		void SetGain(float feedbackGain) {
 			jassert(feedbackGain <= 1.0f && feedbackGain >= -1.0f);
-			this->feedbackGain = feedbackGain;
+			this->feedbackGain.SetTargetValue(feedbackGain);
+		}
+		void SetGainRampLength(double rampLengthInSeconds) {
+			feedbackGain.SetRampLength(rampLengthInSeconds);
+		}
+		/** Set how the feedback is kept from decaying through denormals, FlushToZero by default. */
+		void SetDenormalProtection(DenormalProtection protection) {
+			denormalProtection = protection;
+		}
+
+		/** Samples for the feedback to decay by decayInDecibels, std::numeric_limits<int>::max() if it never does. */
+		int GetTailLengthInSamples(double decayInDecibels = 60.0) {
+			return ComputeTailLength(feedbackGain.GetTargetValue(), delay.GetTargetValue(), decayInDecibels);
+		}
+		/** Samples for a loop of delayInSamples samples and gain feedback to decay by decayInDecibels. */
+		static int ComputeTailLength(double gain, double delayInSamples, double decayInDecibels) {
+			gain = std::abs(gain);
+			delayInSamples = std::ceil(delayInSamples);
+			if (gain >= 1)
+				return std::numeric_limits<int>::max();
+			double repeats = gain > 0 ? -(decayInDecibels / 20.0) / std::log10(gain) : 0.0;
+			return (int)juce::jmin(delayInSamples * (repeats + 1), (double)std::numeric_limits<int>::max());
+		}
+		/** The largest absolute sample the feedback can still read, below the silence threshold once the filter has decayed. */
+		sT GetStatePeak() {
+			if (!isReady)
+				return sT{};
+			// A gliding delay can read anywhere up to the max delay, the interpolators read 2 samples past the delay.
+			int readLength = delay.IsSmoothing() ? maxDelayInSamples : (int)std::ceil(delay.GetTargetValue());
+			return delayLine.GetPeak(readLength + 3);
 		}
 
 		void Prepare(int sampleRate, int samplesPerBlock) {
-			feedbackBuffer.setSize(numChannels, samplesPerBlock);
-			feedbackBuffer.clear();
-			delayLine.Prepare(sampleRate, samplesPerBlock);
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		};
+		/** Same as Prepare, with the delay line and the scratch buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			arena.AllocateBuffer(feedbackBuffer, numChannels, samplesPerBlock);
+			arena.AllocateBuffer(delayScratch, 1, samplesPerBlock);
+			feedbackGain.Prepare(sampleRate, samplesPerBlock, arena);
+			delay.Prepare(sampleRate, samplesPerBlock, arena);
+			delayLine.Prepare(sampleRate, samplesPerBlock, arena);
 			isReady = true;
 		};
 		void Process(ProcessContext<sT>& ctx) {
+			ProcessBlock(ctx, nullptr);
+		};
+		/**
+		 * Process and mix the input back in, output = input + delayed * wetGain.
+		 * The input can be the output, it is read before being overwritten so no copy of it is needed.
+		 */
+		void Process(ProcessContext<sT>& ctx, SmoothedParameter<sT>& wetGain) {
+			ProcessBlock(ctx, &wetGain);
+		}
+		void Reset() {
 			if (!isReady)
 				return;
 
-			AudioBufferView<sT> feedbackBufferView{ feedbackBuffer };
+			delayLine.Reset();
+			feedbackBuffer.clear();
+			feedbackGain.Reset();
+			delay.Reset();
+		};
+	private:
+		void ProcessBlock(ProcessContext<sT>& ctx, SmoothedParameter<sT>* wetGain) {
+			if (!isReady)
+				return;
 
-			delayLine.PopSamples(feedbackBufferView, delayInSamples);
-			
-			feedbackBufferView *= feedbackGain;
-			feedbackBufferView += ctx.GetInput();
+			ScopedFlushDenormals flushDenormals{ denormalProtection == DenormalProtection::FlushToZero };
+			AudioBufferView<sT> input = ctx.GetInput();
+			int numSamples = input.GetNumSamples();
+			jassert(ctx.GetOutput().GetNumSamples() == numSamples);
+			jassert(numSamples <= feedbackBuffer.getNumSamples());
+			const sT* gainRamp = feedbackGain.IsSmoothing() ? feedbackGain.GetNextRamp(numSamples) : nullptr;
+			const sT* delays = delay.IsSmoothing() ? delay.GetNextRamp(numSamples) : nullptr;
 
-			delayLine.PushSamples(feedbackBufferView);
-			if (lastDelayInSamples == delayInSamples) {
-				delayLine.PopSamples(ctx.GetOutput(), delayInSamples);
+			// The feedback of a sample is read delay samples back, a sub-block longer than the delay would read
+			// its own samples before they are written. Long delays take the whole block at once.
+			sT minDelay = delays != nullptr ? juce::jmin(delays[0], delays[numSamples - 1]) : delay.GetTargetValue();
+			int subBlockLength = GetMaxSubBlockLength(minDelay);
+
+			if (delays == nullptr && interpolation == DelayInterpolation::None) {
+				// Whole sample delay, the feedback is computed straight in the delay line and the output read from it.
+				int delayInSamples = (int)delay.GetTargetValue();
+				for (int offset = 0; offset < numSamples; offset += subBlockLength) {
+					int length = juce::jmin(subBlockLength, numSamples - offset);
+					WriteFeedback(input.GetSubView(offset, length), gainRamp == nullptr ? nullptr : gainRamp + offset, juce::jmax(delayInSamples - length, 0));
+				}
+				MixOutput(ctx, delayLine.GetReadSpan(delayInSamples, numSamples), wetGain);
 			}
 			else {
-				delayLine.PopSamples(feedbackBufferView, lastDelayInSamples);
-				delayLine.PopSamples(ctx.GetOutput(), delayInSamples);
-				int outputNumSamples = ctx.GetOutput().GetNumSamples();
-				for (int channel = 0; channel < ctx.GetOutput().GetNumChannels(); channel++) {
-					for (int i = 0; i < outputNumSamples; i++) {
-						float nratio = (float)i / outputNumSamples;
-						float lratio = 1 - nratio;
-						float nsample = ctx.GetOutput().GetSample(channel, i);
-						ctx.GetOutput().SetSample(channel, i, (nsample * nratio) + (feedbackBufferView.GetSample(channel, i) * lratio));
-					}
+				AudioBufferView<sT> feedbackBufferView{ feedbackBuffer, 0, numSamples };
+
+				for (int offset = 0; offset < numSamples; offset += subBlockLength) {
+					int length = juce::jmin(subBlockLength, numSamples - offset);
+					AudioBufferView<sT> feedbackView = feedbackBufferView.GetSubView(offset, length);
+					// Read before the sub-block is pushed, so length samples less late.
+					PopDelayedSamples(feedbackView, delays == nullptr ? nullptr : delays + offset, (sT)length, 0);
+					ApplyFeedback(feedbackView, input.GetSubView(offset, length), gainRamp == nullptr ? nullptr : gainRamp + offset);
+					delayLine.PushSamples(feedbackView);
 				}
-				lastDelayInSamples = delayInSamples;
+
+				PopDelayedSamples(feedbackBufferView, delays, 0, 1);
+				MixOutput(ctx, DelayLineSpan<sT>{ feedbackBufferView }, wetGain);
 			}
-		};
-		void Reset() {
-			if (!isReady)
+			noiseFloor = -noiseFloor;
+		}
+
+		/**
+		 * Longest sub-block whose feedback reads are all written, for a delay of at least minDelay.
+		 * Lagrange3 and Thiran keep the margin they need to read the same fraction, delays under a sample loop after one sample.
+		 */
+		int GetMaxSubBlockLength(sT minDelay) const noexcept {
+			int length = (int)minDelay;
+			if (interpolation == DelayInterpolation::Lagrange3 && length > 1)
+				length -= 1;
+			else if (interpolation == DelayInterpolation::Thiran && length > 1)
+				length = (int)std::floor(minDelay - (sT)0.5);
+			return juce::jmax(1, length);
+		}
+
+		/** Write input + delayed * gain for the next input samples straight in the delay line, delayed being read delayInSamples late. */
+		void WriteFeedback(AudioBufferView<sT> input, const sT* gainRamp, int delayInSamples) {
+			int numSamples = input.GetNumSamples();
+			DelayLineSpan<sT> delayedSpan = delayLine.GetReadSpan(delayInSamples, numSamples);
+			DelayLineSpan<sT> feedbackSpan = delayLine.GetWriteSpan(numSamples);
+
+			// Cut the block where one of the spans wraps.
+			int splits[4] = { 0, delayedSpan.GetSplit(), feedbackSpan.GetSplit(), numSamples };
+			if (splits[1] > splits[2])
+				std::swap(splits[1], splits[2]);
+			for (int i = 0; i < 3; i++) {
+				int length = splits[i + 1] - splits[i];
+				if (length == 0)
+					continue;
+				AudioBufferView<sT> feedbackView = feedbackSpan.GetView(splits[i], length);
+				feedbackView.CopyFrom(delayedSpan.GetView(splits[i], length));
+				ApplyFeedback(feedbackView, input.GetSubView(splits[i], length), gainRamp == nullptr ? nullptr : gainRamp + splits[i]);
+			}
+			delayLine.CommitWrite(numSamples);
+		}
+
+		/** feedback = input + feedback * gain, plus the noise floor if it protects the loop. */
+		void ApplyFeedback(AudioBufferView<sT>& feedback, const AudioBufferView<sT>& input, const sT* gainRamp) {
+			if (gainRamp != nullptr)
+				feedback.MulRampAdd(input, gainRamp);
+			else
+				feedback.LinearCombination(input, 1, feedbackGain.GetTargetValue());
+			if (denormalProtection == DenormalProtection::NoiseFloor)
+				feedback += noiseFloor;
+		}
+
+		/** output = delayed, or input + delayed * wetGain. */
+		void MixOutput(ProcessContext<sT>& ctx, DelayLineSpan<sT> delayed, SmoothedParameter<sT>* wetGain) {
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			int numSamples = output.GetNumSamples();
+			int split = delayed.GetSplit();
+
+			if (wetGain == nullptr) {
+				output.GetSubView(0, split).CopyFrom(delayed.first);
+				output.GetSubView(split, numSamples - split).CopyFrom(delayed.second);
 				return;
+			}
 
-			delayLine.Reset();
-			feedbackBuffer.clear();
-		};
+			if (!ctx.IsInout())
+				output.CopyFrom(ctx.GetInput());
+
+			if (wetGain->IsSmoothing()) {
+				const sT* wetRamp = wetGain->GetNextRamp(numSamples);
+				output.GetSubView(0, split).MulAddRamp(delayed.first, wetRamp);
+				output.GetSubView(split, numSamples - split).MulAddRamp(delayed.second, wetRamp + split);
+			}
+			else {
+				output.GetSubView(0, split).MulAdd(delayed.first, wetGain->GetTargetValue());
+				output.GetSubView(split, numSamples - split).MulAdd(delayed.second, wetGain->GetTargetValue());
+			}
+		}
+
+		/** Read lag samples before the current delay, or the per sample delays while gliding. Each read position has its own tap. */
+		void PopDelayedSamples(AudioBufferView<sT>& dst, const sT* delays, sT lag, int tap) {
+			if (delays != nullptr) {
+				sT* laggedDelays = delayScratch.getWritePointer(0);
+				for (int i = 0; i < dst.GetNumSamples(); i++)
+					laggedDelays[i] = juce::jmax(delays[i] - lag, (sT)0);
+				delayLine.PopSamples(dst, laggedDelays, interpolation == DelayInterpolation::None ? DelayInterpolation::Linear : interpolation, tap);
+			}
+			else {
+				delayLine.PopSamples(dst, juce::jmax(delay.GetTargetValue() - lag, (sT)0), interpolation, tap);
+			}
+		}
 	private:
 		bool isReady = false;
 		int numChannels = 1;
 		int maxDelayInSamples = 44110;
-		int lastDelayInSamples = 0;
-		int delayInSamples = 0;
-		float feedbackGain = 0.5f;
+		DelayInterpolation interpolation = DelayInterpolation::None;
+		DenormalProtection denormalProtection = DenormalProtection::FlushToZero;
+		sT noiseFloor = (sT)denormalNoiseFloor;
+		SmoothedParameter<sT> delay{ (sT)0 };
+		SmoothedParameter<sT> feedbackGain{ (sT)0.5 };
 		DelayLine<sT> delayLine{};
 		juce::AudioBuffer<sT> feedbackBuffer{};
+		juce::AudioBuffer<sT> delayScratch{};
+		Arena ownArena{};
 	};
 }
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyInterleavedBuffer.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+#include <PennyDSP/PennySIMD/PennyDenormals.h>
+
+namespace Penny {
+	/**
+	 * Bank of parallel feedback comb filters, one per lane, each with its own whole sample delay and gain.
+	 * The lanes share an interleaved ring buffer, the delayed frames are read with one gather per sub-block
+	 * and the feedback of every lane computed with the same vector instructions, so 4 or 8 lanes cost about as much as 1.
+	 * Process takes one channel per lane, ProcessInterleaved works on interleaved data directly.
+	 */
+	template<typename sT>
+	class CombFilterBank : public BaseDSP<sT> {
+	public:
+		using SampleType = sT;
+	public:
+		CombFilterBank() : CombFilterBank(1) {}
+		CombFilterBank(int numLanes) : CombFilterBank(numLanes, 44110) {}
+		CombFilterBank(int numLanes, int maxDelayInSamples) :
+			numLanes{ numLanes }, maxDelayInSamples{ maxDelayInSamples }, delays(numLanes, 1), gains(numLanes, (sT)0.5) {}
+
+		int GetLanesNumber() {
+			return numLanes;
+		}
+
+		/** Set the delay of a lane, at least 1 sample. */
+		void SetDelay(int lane, int delayInSamples) {
+			jassert(lane >= 0 && lane < numLanes);
+			jassert(delayInSamples >= 1 && delayInSamples <= maxDelayInSamples);
+			delays[lane] = delayInSamples;
+		}
+		int GetDelay(int lane) {
+			return delays[lane];
+		}
+		/** Set the feedback gain of a lane. */
+		void SetGain(int lane, float feedbackGain) {
+			jassert(lane >= 0 && lane < numLanes);
+			jassert(feedbackGain <= 1.0f && feedbackGain >= -1.0f);
+			gains[lane] = feedbackGain;
+			if (isReady)
+				FillLanePattern(lanePatterns.getWritePointer(1), gains.data());
+		}
+		float GetGain(int lane) {
+			return gains[lane];
+		}
+		/** Set how the feedback is kept from decaying through denormals, FlushToZero by default. */
+		void SetDenormalProtection(DenormalProtection protection) {
+			denormalProtection = protection;
+		}
+
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the ring buffer and the scratch buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			this->samplesPerBlock = samplesPerBlock;
+			// A sub-block never reads frames older than the max delay, nor the frames it writes.
+			capacity = maxDelayInSamples + samplesPerBlock;
+			ring.SetSize(numLanes, capacity, arena);
+			interleaved.SetSize(numLanes, samplesPerBlock, arena);
+			delayed.SetSize(numLanes, samplesPerBlock, arena);
+			indices = arena.Allocate<int32_t>((size_t)numLanes * samplesPerBlock);
+			// Per value ones and feedback gains, the lane values repeated on every frame.
+			arena.AllocateBuffer(lanePatterns, 2, numLanes * samplesPerBlock);
+			std::fill(lanePatterns.getWritePointer(0), lanePatterns.getWritePointer(0) + numLanes * samplesPerBlock, (sT)1);
+			FillLanePattern(lanePatterns.getWritePointer(1), gains.data());
+			isReady = true;
+			Reset();
+		}
+
+		/** Process one channel per lane. */
+		void Process(ProcessContext<sT>& ctx) {
+			if (!isReady)
+				return;
+
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			jassert(output.GetNumChannels() >= numLanes);
+			interleaved.CopyFrom(ctx.GetInput());
+			ProcessInterleaved(interleaved.GetData(), interleaved.GetData(), output.GetNumSamples());
+			interleaved.CopyTo(output);
+		}
+		/**
+		 * Process numSamples interleaved frames, input can be output.
+		 * output = delayed, or input + delayed * wetPattern when a per value wet gain pattern is given.
+		 */
+		void ProcessInterleaved(const sT* input, sT* output, int numSamples, const sT* wetPattern = nullptr) {
+			jassert(isReady);
+			jassert(numSamples <= samplesPerBlock);
+
+			ScopedFlushDenormals flushDenormals{ denormalProtection == DenormalProtection::FlushToZero };
+			// The feedback of a frame is read delay frames back, a sub-block can't be longer than the shortest delay.
+			int subBlockLength = *std::min_element(delays.begin(), delays.end());
+			for (int offset = 0; offset < numSamples; offset += subBlockLength) {
+				int length = juce::jmin(subBlockLength, numSamples - offset);
+				int numValues = length * numLanes;
+				const sT* in = input + offset * numLanes;
+				sT* out = output + offset * numLanes;
+
+				GatherDelayed(length);
+				WriteFeedback(in, length);
+
+				if (wetPattern == nullptr) {
+					memcpy(out, delayed.GetData(), sizeof(sT) * numValues);
+				}
+				else {
+					if (out != in)
+						memcpy(out, in, sizeof(sT) * numValues);
+					AudioBufferView_Impl<sT>::MulAddRamp(out, delayed.GetData(), wetPattern, numValues);
+				}
+			}
+			noiseFloor = -noiseFloor;
+		}
+
+		void Reset() {
+			if (!isReady)
+				return;
+
+			ring.Clear();
+			position = 0;
+		}
+
+		/** Fill a per value pattern of samplesPerBlock frames from one value per lane. */
+		void FillLanePattern(sT* pattern, const sT* laneValues) const {
+			for (int i = 0; i < samplesPerBlock; i++)
+				for (int k = 0; k < numLanes; k++)
+					pattern[i * numLanes + k] = laneValues[k];
+		}
+	private:
+		/** Read the length frames delayed by the delay of each lane in the delayed buffer. */
+		void GatherDelayed(int length) {
+			for (int k = 0; k < numLanes; k++) {
+				int frame = position - delays[k];
+				if (frame < 0)
+					frame += capacity;
+				for (int i = 0; i < length; i++) {
+					indices[i * numLanes + k] = frame * numLanes + k;
+					if (++frame == capacity)
+						frame = 0;
+				}
+			}
+
+			int numValues = length * numLanes;
+			sT* delayedData = delayed.GetData();
+			std::fill(delayedData, delayedData + numValues, sT{});
+			AudioBufferView_Impl<sT>::GatherMulAdd(delayedData, ring.GetData(), indices, lanePatterns.getReadPointer(0), numValues);
+		}
+		/** ring = input + delayed * gain for the next length frames, plus the noise floor if it protects the loops. */
+		void WriteFeedback(const sT* input, int length) {
+			int firstPart = juce::jmin(length, capacity - position);
+			const sT* gainPattern = lanePatterns.getReadPointer(1);
+			const sT* delayedData = delayed.GetData();
+
+			sT* first = ring.GetFrame(position);
+			memcpy(first, input, sizeof(sT) * firstPart * numLanes);
+			AudioBufferView_Impl<sT>::MulAddRamp(first, delayedData, gainPattern, firstPart * numLanes);
+			if (denormalProtection == DenormalProtection::NoiseFloor)
+				AudioBufferView_Impl<sT>::AddScalar(first, noiseFloor, firstPart * numLanes);
+			if (firstPart < length) {
+				int offset = firstPart * numLanes;
+				sT* second = ring.GetFrame(0);
+				memcpy(second, input + offset, sizeof(sT) * (length - firstPart) * numLanes);
+				AudioBufferView_Impl<sT>::MulAddRamp(second, delayedData + offset, gainPattern + offset, (length - firstPart) * numLanes);
+				if (denormalProtection == DenormalProtection::NoiseFloor)
+					AudioBufferView_Impl<sT>::AddScalar(second, noiseFloor, (length - firstPart) * numLanes);
+			}
+
+			position += length;
+			if (position >= capacity)
+				position -= capacity;
+		}
+	private:
+		bool isReady = false;
+		int numLanes = 1;
+		int maxDelayInSamples = 44110;
+		int samplesPerBlock = 0;
+		int capacity = 0;
+		int position = 0;
+		DenormalProtection denormalProtection = DenormalProtection::FlushToZero;
+		sT noiseFloor = (sT)denormalNoiseFloor;
+		std::vector<int> delays;
+		std::vector<sT> gains;
+		InterleavedBuffer<sT> ring{};
+		InterleavedBuffer<sT> interleaved{};
+		InterleavedBuffer<sT> delayed{};
+		int32_t* indices = nullptr;
+		juce::AudioBuffer<sT> lanePatterns{};
+		Arena ownArena{};
+	};
+}
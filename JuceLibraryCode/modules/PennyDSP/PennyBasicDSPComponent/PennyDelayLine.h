@@ -1,13 +1,66 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
 
 namespace Penny {
+	/** How a delay line reads between two samples. */
+	enum class DelayInterpolation {
+		/** Whole sample delay, the fractional part is dropped. */
+		None,
+		/** Linear interpolation between the 2 nearest samples. */
+		Linear,
+		/** Third order Lagrange interpolation over the 4 nearest samples. */
+		Lagrange3,
+		/** First order Thiran allpass, flat magnitude but recursive, for delays moving slowly. */
+		Thiran
+	};
+
+	/** How a delay line stores its ring buffer. */
+	enum class DelayLineLayout {
+		/** Exactly the samples needed, wrapping is a modulo and block copies are split at the end of the ring. */
+		Compact,
+		/** Capacity rounded up to a power of 2, wrapping is a mask. */
+		PowerOfTwo,
+		/** PowerOfTwo with the start of the ring mirrored after its end, every block read is contiguous. */
+		Mirrored
+	};
+
+	/**
+	 * Block of samples pointing straight in the ring of a delay line.
+	 * A block crossing the end of the ring is split in two views, second is then the part wrapped to the start.
+	 */
+	template<typename sT>
+	struct DelayLineSpan {
+	public:
+		DelayLineSpan(const AudioBufferView<sT>& first, const AudioBufferView<sT>& second) noexcept : first{ first }, second{ second } {}
+		/** Span of a single contiguous view. */
+		explicit DelayLineSpan(AudioBufferView<sT> view) noexcept : first{ view }, second{ view.GetSubView(view.GetNumSamples(), 0) } {}
+
+		inline int GetNumSamples() const noexcept { return first.GetNumSamples() + second.GetNumSamples(); }
+		/** Index of the first sample of the second view. */
+		inline int GetSplit() const noexcept { return first.GetNumSamples(); }
+		/** View of length samples from start, they must not cross the split. */
+		inline AudioBufferView<sT> GetView(int start, int length) {
+			jassert(start >= GetSplit() || start + length <= GetSplit());
+			return start < GetSplit() ? first.GetSubView(start, length) : second.GetSubView(start - GetSplit(), length);
+		}
+	public:
+		AudioBufferView<sT> first;
+		AudioBufferView<sT> second;
+	};
+
 	template<typename sT>
 	class DelayLine : public BaseDSP<sT> {
 	public:
 		using SampleType = sT;
+		/** Number of independent reads that can use Thiran interpolation, each one keeps its own filter state. */
+		static constexpr int maxThiranTaps = 4;
 	public:
 		/** Construct a delayline with 1 channel and 44110 max delayed samples */
 		DelayLine() {}
@@ -16,7 +69,7 @@ namespace Penny {
 		/** Construct a delayline with specified number of channels and max delayed samples */
 		DelayLine(int numChannels, int maxDelayInSamples) : numChannels{ numChannels }, maxDelayInSamples{ maxDelayInSamples } {}
 
-		/** Set channels number, will reset the delay line. */
+		/** Set channels number, will reset the delay line. It only allocates if the line grows past what Prepare reserved. */
 		void SetChannelsNumber(int numChannels) {
 			this->numChannels = numChannels;
 			Reset();
@@ -25,7 +78,7 @@ namespace Penny {
 			return numChannels;
 		}
 
-		/** Set max delay, will reset the delay line. */
+		/** Set max delay, will reset the delay line. It only allocates if the line grows past what Prepare reserved. */
 		void SetMaxDelay(int maxDelayInSamples) {
 			this->maxDelayInSamples = maxDelayInSamples;
 			Reset();
@@ -34,60 +87,255 @@ namespace Penny {
 			return maxDelayInSamples;
 		}
 
-		/** Set current delay used for processing */
-		void SetDelay(int delayInSamples) {
-			jassert(delayInSamples <= maxDelayInSamples);
+		/** Set the ring buffer layout, will reset the delay line. PowerOfTwo and Mirrored use up to twice the memory. */
+		void SetLayout(DelayLineLayout layout) {
+			this->layout = layout;
+			Reset();
+		}
+		DelayLineLayout GetLayout() {
+			return layout;
+		}
+
+		/** Set current delay used for processing, it can be fractional. */
+		void SetDelay(sT delayInSamples) {
+			jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
 			this->delayInSamples = delayInSamples;
 		}
-		int GetDelay() {
+		sT GetDelay() {
 			return delayInSamples;
 		}
 
+		/** Latency of Process, the current delay. */
+		int GetLatencyInSamples() {
+			return (int)std::ceil(delayInSamples);
+		}
+		int GetTailLengthInSamples() {
+			return (int)std::ceil(delayInSamples);
+		}
+
+		/** Set the interpolation used for processing. */
+		void SetInterpolation(DelayInterpolation interpolation) {
+			this->interpolation = interpolation;
+		}
+		DelayInterpolation GetInterpolation() {
+			return interpolation;
+		}
+
+		/**
+		 * Get the ring samples the next numSamples pushed samples go to, to compute them in place.
+		 * CommitWrite must be called once they are written.
+		 */
+		DelayLineSpan<sT> GetWriteSpan(int numSamples) {
+			jassert(isReady);
+			jassert(numSamples <= samplesPerBlock);
+			return GetSpan(delayBufferPosition, numSamples);
+		}
+		/** Make the numSamples samples written in the span of GetWriteSpan part of the delay line. */
+		void CommitWrite(int numSamples) {
+			jassert(isReady);
+			int end = delayBufferPosition + numSamples;
+			if (layout == DelayLineLayout::Mirrored) {
+				// The block was written in one go, keep the guard region and the start of the ring identical.
+				for (int i = 0; i < numChannels; i++) {
+					sT* ring = delayBuffer.getWritePointer(i);
+					if (end > capacity)
+						memcpy(ring, ring + capacity, sizeof(sT) * (end - capacity));
+					if (delayBufferPosition < guardSize)
+						memcpy(ring + capacity + delayBufferPosition, ring + delayBufferPosition, sizeof(sT) * (juce::jmin(end, guardSize) - delayBufferPosition));
+				}
+			}
+			delayBufferPosition = Wrap(end);
+		}
+		/**
+		 * Get the ring samples a numSamples block delayed by delayInSamples would be popped from, without copying them.
+		 * The span is valid until the next write.
+		 */
+		DelayLineSpan<sT> GetReadSpan(int delayInSamples, int numSamples) {
+			jassert(isReady);
+			jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
+			jassert(numSamples <= samplesPerBlock);
+			return GetSpan(GetReadPosition(delayInSamples, numSamples), numSamples);
+		}
+
+		/** The largest absolute sample among the last numSamples pushed ones, at most the whole ring. */
+		sT GetPeak(int numSamples) {
+			jassert(isReady);
+			numSamples = juce::jmin(numSamples, capacity);
+			int start = Wrap(delayBufferPosition + capacity - numSamples);
+			int firstPart = juce::jmin(numSamples, capacity - start);
+			AudioBufferView<sT> first{ delayBuffer, start, firstPart };
+			AudioBufferView<sT> second{ delayBuffer, 0, numSamples - firstPart };
+			return std::max(first.GetPeak(), second.GetPeak());
+		}
+
 		/** Push samples in the delay line. */
 		void PushSamples(const AudioBufferView<sT>& src) {
 			jassert(isReady);
 			jassert(src.GetNumChannels() >= numChannels);
 			jassert(src.GetNumSamples() <= samplesPerBlock);
 
+			DelayLineSpan<sT> span = GetWriteSpan(src.GetNumSamples());
+			int split = span.GetSplit();
 			for (int i = 0; i < numChannels; i++) {
-				const SampleType* data = src.GetConstChannelPtr(i);
-				if (delayBufferPosition + src.GetNumSamples() < delayBuffer.getNumSamples()) {
-					delayBuffer.copyFrom(i, delayBufferPosition, data, src.GetNumSamples());
-				}
-				else {
-					delayBuffer.copyFrom(i, delayBufferPosition, data, delayBuffer.getNumSamples() - delayBufferPosition);
-					delayBuffer.copyFrom(i, 0, data + (delayBuffer.getNumSamples() - delayBufferPosition), 
-						src.GetNumSamples() - (delayBuffer.getNumSamples() - delayBufferPosition));
-				}
+				span.first.CopyFrom(i, 0, src, i, 0, split);
+				span.second.CopyFrom(i, 0, src, i, split, src.GetNumSamples() - split);
 			}
-
-			delayBufferPosition = (delayBufferPosition + src.GetNumSamples()) % delayBuffer.getNumSamples();
+			CommitWrite(src.GetNumSamples());
 		}
 		/** Pop samples from the delay line. */
 		void PopSamples(AudioBufferView<sT>& dst, int delayInSamples) {
 			jassert(isReady);
-			jassert(delayInSamples <= maxDelayInSamples);
+			jassert(delayBuffer.getNumChannels() >= dst.GetNumChannels());
+
+			DelayLineSpan<sT> span = GetReadSpan(delayInSamples, dst.GetNumSamples());
+			int split = span.GetSplit();
+			for (int i = 0; i < dst.GetNumChannels(); i++) {
+				dst.CopyFrom(i, 0, span.first, i, 0, split);
+				dst.CopyFrom(i, split, span.second, i, 0, dst.GetNumSamples() - split);
+			}
+		}
+		/**
+		 * Pop samples from the delay line with a fractional delay.
+		 * Linear and Lagrange3 are weighted sums of whole sample reads, done with the vectorized kernels.
+		 *
+		 * \param thiranTap : filter state used by Thiran interpolation, every read position of the delay line needs its own.
+		 */
+		void PopSamples(AudioBufferView<sT>& dst, sT delayInSamples, DelayInterpolation interpolation, int thiranTap = 0) {
+			jassert(isReady);
+			jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
 			jassert(dst.GetNumSamples() <= samplesPerBlock);
 			jassert(delayBuffer.getNumChannels() >= dst.GetNumChannels());
 
-			int bufferDelayedPosition = (delayBufferPosition + delayBuffer.getNumSamples() - delayInSamples - dst.GetNumSamples()) % delayBuffer.getNumSamples();
+			switch (interpolation) {
+			case DelayInterpolation::Linear: {
+				int delay = (int)delayInSamples;
+				sT fraction = delayInSamples - delay;
+				PopSamples(dst, delay);
+				if (fraction > 0) {
+					dst *= 1 - fraction;
+					AccumulateSamples(dst, delay + 1, fraction);
+				}
+				break;
+			}
+			case DelayInterpolation::Lagrange3: {
+				sT coefficients[4];
+				int delay = GetLagrangeCoefficients(delayInSamples, coefficients);
+				PopSamples(dst, delay);
+				dst *= coefficients[0];
+				for (int k = 1; k < 4; k++)
+					AccumulateSamples(dst, delay + k, coefficients[k]);
+				break;
+			}
+			case DelayInterpolation::Thiran: {
+				jassert(thiranTap >= 0 && thiranTap < maxThiranTaps);
+				int delay;
+				sT coefficient = GetThiranCoefficient(delayInSamples, delay);
+				int startPosition = GetReadPosition(delay, dst.GetNumSamples());
+				for (int channel = 0; channel < dst.GetNumChannels(); channel++) {
+					const sT* data = delayBuffer.getReadPointer(channel);
+					sT* output = dst.GetChannelPtr(channel);
+					sT& state = thiranStates[thiranTap * numChannels + channel];
+					int position = startPosition;
+					int previous = position == 0 ? capacity - 1 : position - 1;
+					for (int i = 0; i < dst.GetNumSamples(); i++) {
+						state = coefficient * (data[position] - state) + data[previous];
+						output[i] = state;
+						previous = position;
+						if (++position == capacity)
+							position = 0;
+					}
+				}
+				break;
+			}
+			default:
+				PopSamples(dst, (int)delayInSamples);
+				break;
+			}
+		}
+		/**
+		 * Pop samples from the delay line with a different delay for each sample, for modulated delays.
+		 * The read positions and weights are computed once per sample and shared by every channel,
+		 * each channel is then a gather and multiply add per tap.
+		 *
+		 * \param delaysInSamples : one delay per sample of dst.
+		 * \param thiranTap : filter state used by Thiran interpolation, every read position of the delay line needs its own.
+		 */
+		void PopSamples(AudioBufferView<sT>& dst, const sT* delaysInSamples, DelayInterpolation interpolation, int thiranTap = 0) {
+			jassert(isReady);
+			jassert(dst.GetNumSamples() <= samplesPerBlock);
+			jassert(delayBuffer.getNumChannels() >= dst.GetNumChannels());
 
-			for (int i = 0; i < dst.GetNumChannels(); i++) {
-				const SampleType* data = delayBuffer.getReadPointer(i);
-				if (bufferDelayedPosition + dst.GetNumSamples() < delayBuffer.getNumSamples()) {
-					dst.CopyFrom(i, 0, data + bufferDelayedPosition, dst.GetNumSamples());
+			int numSamples = dst.GetNumSamples();
+			// Position of the sample written numSamples samples ago, may be one capacity too far.
+			int startPosition = delayBufferPosition + capacity - numSamples;
+
+			int numTaps = 1;
+			for (int i = 0; i < numSamples; i++) {
+				sT delayInSamples = delaysInSamples[i];
+				jassert(delayInSamples >= 0 && delayInSamples <= maxDelayInSamples);
+
+				sT coefficients[4] = { 1, 0, 0, 0 };
+				int delay;
+				switch (interpolation) {
+				case DelayInterpolation::Linear:
+					numTaps = 2;
+					delay = (int)delayInSamples;
+					coefficients[1] = delayInSamples - delay;
+					coefficients[0] = 1 - coefficients[1];
+					break;
+				case DelayInterpolation::Lagrange3:
+					numTaps = 4;
+					delay = GetLagrangeCoefficients(delayInSamples, coefficients);
+					break;
+				case DelayInterpolation::Thiran:
+					coefficients[0] = GetThiranCoefficient(delayInSamples, delay);
+					break;
+				default:
+					delay = (int)delayInSamples;
+					break;
 				}
-				else {
-					dst.CopyFrom(i, 0, data + bufferDelayedPosition, delayBuffer.getNumSamples() - bufferDelayedPosition);
-					dst.CopyFrom(i, delayBuffer.getNumSamples() - bufferDelayedPosition, data, 
-						dst.GetNumSamples() - (delayBuffer.getNumSamples() - bufferDelayedPosition));
+
+				for (int k = 0; k < numTaps; k++) {
+					int position = startPosition + i - delay - k;
+					tapIndices[k * samplesPerBlock + i] = position >= capacity ? position - capacity : position;
+					tapGains.setSample(k, i, coefficients[k]);
 				}
 			}
+
+			for (int channel = 0; channel < dst.GetNumChannels(); channel++) {
+				const sT* data = delayBuffer.getReadPointer(channel);
+				sT* output = dst.GetChannelPtr(channel);
+
+				if (interpolation == DelayInterpolation::Thiran) {
+					jassert(thiranTap >= 0 && thiranTap < maxThiranTaps);
+					const sT* thiranCoefficients = tapGains.getReadPointer(0);
+					sT& state = thiranStates[thiranTap * numChannels + channel];
+					for (int i = 0; i < numSamples; i++) {
+						int position = tapIndices[i];
+						int previous = position == 0 ? capacity - 1 : position - 1;
+						state = thiranCoefficients[i] * (data[position] - state) + data[previous];
+						output[i] = state;
+					}
+					continue;
+				}
+
+				std::fill(output, output + numSamples, sT{});
+				for (int k = 0; k < numTaps; k++)
+					AudioBufferView_Impl<sT>::GatherMulAdd(output, data, tapIndices + k * samplesPerBlock, tapGains.getReadPointer(k), numSamples);
+			}
 		}
 
 		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the ring buffer and the scratch buffers allocated from arena, which must outlive the delay line. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
 			this->sampleRate = sampleRate;
 			this->samplesPerBlock = samplesPerBlock;
+			this->arena = &arena;
+			arena.AllocateBuffer(tapGains, 4, samplesPerBlock);
+			tapIndices = arena.Allocate<int32_t>((size_t)4 * samplesPerBlock);
+			reservedChannels = reservedSamples = 0;
 			isReady = true;
 			Reset();
 		}
@@ -96,16 +344,74 @@ namespace Penny {
 		void Process(ProcessContext<sT>& ctx) {
 			jassert(isReady);
 			PushSamples(ctx.GetInput());
-			PopSamples(ctx.GetOutput(), delayInSamples);
+			PopSamples(ctx.GetOutput(), delayInSamples, interpolation);
 		}
 
 		void Reset() {
 			if (!isReady)
 				return;
 
-			delayBuffer.setSize(numChannels, maxDelayInSamples + samplesPerBlock);
+			// The interpolators read up to 2 samples past the max delay, and the block written
+			// never overlaps the oldest block read so the write span can be computed from a read span.
+			capacity = maxDelayInSamples + samplesPerBlock * 2 + 2;
+			if (layout != DelayLineLayout::Compact)
+				capacity = juce::nextPowerOfTwo(capacity);
+			guardSize = layout == DelayLineLayout::Mirrored ? samplesPerBlock : 0;
+
+			// The ring is only allocated again if it grows, so a reset on the audio thread never allocates.
+			if (numChannels > reservedChannels || capacity + guardSize > reservedSamples) {
+				reservedChannels = juce::jmax(numChannels, reservedChannels);
+				reservedSamples = juce::jmax(capacity + guardSize, reservedSamples);
+				ringChannels = arena->AllocateChannels<sT>(reservedChannels, reservedSamples);
+				thiranStates = arena->Allocate<sT>((size_t)maxThiranTaps * reservedChannels);
+			}
+
+			delayBuffer.setDataToReferTo(ringChannels, numChannels, capacity + guardSize);
 			delayBuffer.clear();
 			delayBufferPosition = 0;
+			std::fill(thiranStates, thiranStates + maxThiranTaps * numChannels, sT{});
+		}
+	private:
+		inline int Wrap(int position) const noexcept {
+			return layout == DelayLineLayout::Compact ? position % capacity : position & (capacity - 1);
+		}
+		DelayLineSpan<sT> GetSpan(int position, int numSamples) {
+			int firstPart = layout == DelayLineLayout::Mirrored ? numSamples : juce::jmin(numSamples, capacity - position);
+			return DelayLineSpan<sT>{ AudioBufferView<sT>{ delayBuffer, position, firstPart }, AudioBufferView<sT>{ delayBuffer, 0, numSamples - firstPart } };
+		}
+		/** Position of the first sample of a numSamples block read delayInSamples samples late. */
+		inline int GetReadPosition(int delayInSamples, int numSamples) const noexcept {
+			return Wrap(delayBufferPosition + capacity - delayInSamples - numSamples);
+		}
+
+		/** dst += the samples delayed by delayInSamples, times gain. */
+		void AccumulateSamples(AudioBufferView<sT>& dst, int delayInSamples, sT gain) {
+			// The interpolator taps can be past the max delay, GetReadSpan would reject them.
+			DelayLineSpan<sT> span = GetSpan(GetReadPosition(delayInSamples, dst.GetNumSamples()), dst.GetNumSamples());
+			int split = span.GetSplit();
+			dst.GetSubView(0, split).MulAdd(span.first, gain);
+			dst.GetSubView(split, dst.GetNumSamples() - split).MulAdd(span.second, gain);
+		}
+
+		/** Weights of the 4 samples starting at the returned whole delay. */
+		static int GetLagrangeCoefficients(sT delayInSamples, sT* coefficients) {
+			// Keep the fractional delay in [1, 2) so the read is centered, except for delays under 1 sample.
+			int delay = juce::jmax(0, (int)delayInSamples - 1);
+			sT d = delayInSamples - delay;
+			sT d1 = d - 1, d2 = d - 2, d3 = d - 3;
+			coefficients[0] = -d1 * d2 * d3 / 6;
+			coefficients[1] = d * d2 * d3 / 2;
+			coefficients[2] = -d * d1 * d3 / 2;
+			coefficients[3] = d * d1 * d2 / 6;
+			return delay;
+		}
+		/** Allpass coefficient, delay receives the whole delay the allpass is applied after. */
+		static sT GetThiranCoefficient(sT delayInSamples, int& delay) {
+			// The fractional delay is kept in [0.5, 1.5) where the phase is the most linear,
+			// delays under half a sample are limited so the pole stays away from the unit circle.
+			delay = juce::jmax(0, (int)std::floor(delayInSamples - (sT)0.5));
+			sT fraction = juce::jmax(delayInSamples - delay, (sT)0.1);
+			return (1 - fraction) / (1 + fraction);
 		}
 	private:
 		bool isReady = false;
@@ -113,7 +419,20 @@ namespace Penny {
 		int maxDelayInSamples = 44110;
 		int sampleRate, samplesPerBlock;
 		int delayBufferPosition = 0;
-		int delayInSamples = 0;
+		/** Size of the ring, the buffer also holds guardSize mirrored samples after it. */
+		int capacity = 0;
+		int guardSize = 0;
+		sT delayInSamples = 0;
+		DelayLineLayout layout = DelayLineLayout::Compact;
+		DelayInterpolation interpolation = DelayInterpolation::None;
 		juce::AudioBuffer<sT> delayBuffer{};
+		juce::AudioBuffer<sT> tapGains{};
+		int32_t* tapIndices = nullptr;
+		sT* thiranStates = nullptr;
+		/** Ring region allocated from the arena, delayBuffer refers to the part in use. */
+		sT** ringChannels = nullptr;
+		int reservedChannels = 0, reservedSamples = 0;
+		Arena* arena = nullptr;
+		Arena ownArena{};
 	};
 }
@@ -4,6 +4,8 @@
 
 #include "PennyBaseDSP.h"
 #include "PennyDelayLine.h"
+#include "PennySmoothedParameter.h"
+#include "../PennyContainers/PennyArena.h"
 
 namespace Penny {
 	enum class DryWetMixingType {
@@ -17,12 +19,12 @@ namespace Penny {
 		using SampleType = sT;
 	public:
 		/** Construct a drywet mixer with 1 channel and 44110 max dry latency */
-		DryWetMixer() : dryDelayedBuffer{ numChannels, maxDryLatency }, dryBuffer{ numChannels, maxDryLatency } {}
+		DryWetMixer() : dryDelayedBuffer{ numChannels, maxDryLatency } {}
 		/** Construct a drywet mixer with specified number of channels and 44110 max dry latency */
-		DryWetMixer(int numChannels) : numChannels{ numChannels }, dryDelayedBuffer{ numChannels, maxDryLatency }, dryBuffer{ numChannels, maxDryLatency } {}
+		DryWetMixer(int numChannels) : numChannels{ numChannels }, dryDelayedBuffer{ numChannels, maxDryLatency } {}
 		/** Construct a drywet mixer with specified number of channels and max dry latency */
 		DryWetMixer(int numChannels, int maxDryLatency) : 
-			numChannels{ numChannels }, maxDryLatency{ maxDryLatency }, dryDelayedBuffer{ numChannels, maxDryLatency }, dryBuffer{ numChannels, maxDryLatency } {}
+			numChannels{ numChannels }, maxDryLatency{ maxDryLatency }, dryDelayedBuffer{ numChannels, maxDryLatency } {}
 
 		void SetDryLatency(int dryLatencyInSamples) {
 			jassert(dryLatencyInSamples <= maxDryLatency);
@@ -37,10 +39,15 @@ namespace Penny {
 			CalculateVolume();
 		}
 
+		/** Set the mixing ratio, the volumes are smoothed over the ramp length. */
 		void SetMixingRatio(float mixingRatio) {
 			this->mixingRatio = mixingRatio;
 			CalculateVolume();
 		}
+		void SetRampLength(double rampLengthInSeconds) {
+			dryVolume.SetRampLength(rampLengthInSeconds);
+			wetVolume.SetRampLength(rampLengthInSeconds);
+		}
 
 		void PushDrySamples(const AudioBufferView<sT>& src) {
 			dryDelayedBuffer.PushSamples(src);
@@ -49,18 +56,28 @@ namespace Penny {
 		void DryWetMixing(AudioBufferView<sT>& wet, int dryLatencyInSamples) {
 			AudioBufferView<sT> dryBufferView{ dryBuffer, 0, wet.GetNumSamples() };
 			dryDelayedBuffer.PopSamples(dryBufferView, dryLatencyInSamples);
-			dryBufferView *= dryVolume;
-			wet *= wetVolume;
-			wet += dryBufferView;
+			if (dryVolume.IsSmoothing() || wetVolume.IsSmoothing()) {
+				dryBufferView.MulRamp(dryVolume.GetNextRamp(wet.GetNumSamples()));
+				wet.MulRampAdd(dryBufferView, wetVolume.GetNextRamp(wet.GetNumSamples()));
+			}
+			else {
+				wet.LinearCombination(dryBufferView, dryVolume.GetTargetValue(), wetVolume.GetTargetValue());
+			}
 		}
 
 		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the dry delay line and buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
 			this->sampleRate = sampleRate;
 			this->samplesPerBlock = samplesPerBlock;
 			isReady = true;
 
-			dryDelayedBuffer.Prepare(sampleRate, samplesPerBlock);
-			dryBuffer.setSize(numChannels, samplesPerBlock);
+			dryDelayedBuffer.Prepare(sampleRate, samplesPerBlock, arena);
+			arena.AllocateBuffer(dryBuffer, numChannels, samplesPerBlock);
+			dryVolume.Prepare(sampleRate, samplesPerBlock, arena);
+			wetVolume.Prepare(sampleRate, samplesPerBlock, arena);
 		}
 
 		void Process(ProcessContext<sT>& ctx) {
@@ -74,21 +91,23 @@ namespace Penny {
 				return;
 
 			dryDelayedBuffer.Reset();
+			dryVolume.Reset();
+			wetVolume.Reset();
 		}
 	private:
 		void CalculateVolume() {
 			switch (mixingType) {
 			case DryWetMixingType::Balanced: 
-				dryVolume = 2.0f * juce::jmin(0.5f, 1.0f - mixingRatio);
-				wetVolume = 2.0f * juce::jmin(0.5f, mixingRatio);
+				dryVolume.SetTargetValue(2.0f * juce::jmin(0.5f, 1.0f - mixingRatio));
+				wetVolume.SetTargetValue(2.0f * juce::jmin(0.5f, mixingRatio));
 				break;
 			case DryWetMixingType::Linear:
-				dryVolume = 1.0f - mixingRatio;
-				wetVolume = mixingRatio;
+				dryVolume.SetTargetValue(1.0f - mixingRatio);
+				wetVolume.SetTargetValue(mixingRatio);
 				break;
 			default:
-				dryVolume = 0.5f;
-				wetVolume = 0.5f;
+				dryVolume.SetTargetValue(0.5f);
+				wetVolume.SetTargetValue(0.5f);
 				break;
 			}
 		}
@@ -100,8 +119,9 @@ namespace Penny {
 		int sampleRate, samplesPerBlock;
 		float mixingRatio = 0.5f;
 		DryWetMixingType mixingType = DryWetMixingType::Linear;
-		float dryVolume{ 0.5f }, wetVolume{ 0.5f };
+		SmoothedParameter<sT> dryVolume{ (sT)0.5 }, wetVolume{ (sT)0.5 };
 		DelayLine<sT> dryDelayedBuffer{};
 		juce::AudioBuffer<sT> dryBuffer{};
+		Arena ownArena{};
 	};
 }
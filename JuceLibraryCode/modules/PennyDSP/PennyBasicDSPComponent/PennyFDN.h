@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennyDelayLine.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+#include <PennyDSP/PennyMath/PennyMixingMatrix.h>
+#include <PennyDSP/PennySIMD/PennyDenormals.h>
+
+namespace Penny {
+	/**
+	 * Feedback delay network of N lines mixed by a unitary matrix, HouseholderMatrix or HadamardMatrix.
+	 * Every line goes through its decay gain and an optional one pole damping filter before the matrix.
+	 * Input channel c feeds the lines c, c + numChannels..., output channel c sums the same lines.
+	 *
+	 * The lines are the N channels of a single DelayLine, each one read at its own delay.
+	 * The network is computed a sub-block at a time, no longer than the shortest line, one row per line,
+	 * so the matrix and the gains run on whole rows with the SIMD kernels.
+	 */
+	template<typename sT, int N, typename MixingMatrix = HadamardMatrix>
+	class FDN : public BaseDSP<sT> {
+		static_assert(N >= 2, "A feedback delay network needs at least 2 lines.");
+	public:
+		using SampleType = sT;
+		static constexpr int numLines = N;
+	public:
+		/** Construct a network with 2 channels and 44110 max delayed samples */
+		FDN() : FDN(2) {}
+		/** Construct a network with specified number of channels and 44110 max delayed samples */
+		FDN(int numChannels) : FDN(numChannels, 44110) {}
+		/** Construct a network with specified number of channels and max delayed samples */
+		FDN(int numChannels, int maxDelayInSamples) :
+			numChannels{ numChannels }, maxDelayInSamples{ maxDelayInSamples }, delayLine{ N, maxDelayInSamples } {
+			jassert(numChannels >= 1 && numChannels <= N);
+			// Spread lengths, so an unconfigured network still diffuses.
+			for (int i = 0; i < N; i++)
+				delays[i] = juce::jmin(maxDelayInSamples, 1031 + 337 * i);
+			UpdateGains();
+			UpdateDamping();
+		}
+
+		/** Set the delay of a line in whole samples, at least 1. */
+		void SetDelay(int line, int delayInSamples) {
+			jassert(line >= 0 && line < N);
+			jassert(delayInSamples >= 1 && delayInSamples <= maxDelayInSamples);
+			delays[line] = delayInSamples;
+			UpdateGains();
+		}
+		int GetDelay(int line) {
+			return delays[line];
+		}
+		/** Set the time the network takes to decay by 60dB. */
+		void SetDecayTime(float decayTimeInSeconds) {
+			jassert(decayTimeInSeconds > 0);
+			this->decayTimeInSeconds = decayTimeInSeconds;
+			UpdateGains();
+		}
+		float GetDecayTime() {
+			return decayTimeInSeconds;
+		}
+		/** Set the cutoff of the low pass damping of a line, 0 disables it. */
+		void SetDamping(int line, float cutoffFrequency) {
+			jassert(line >= 0 && line < N);
+			jassert(cutoffFrequency >= 0);
+			dampingFrequencies[line] = cutoffFrequency;
+			UpdateDamping();
+		}
+		/** Set the damping cutoff of every line, 0 disables it. */
+		void SetDamping(float cutoffFrequency) {
+			for (int i = 0; i < N; i++)
+				SetDamping(i, cutoffFrequency);
+		}
+		/** Set the ring buffer layout of the delay lines, will reset the network. */
+		void SetLayout(DelayLineLayout layout) {
+			delayLine.SetLayout(layout);
+		}
+		/** Set how the lines are kept from decaying through denormals, FlushToZero by default. */
+		void SetDenormalProtection(DenormalProtection protection) {
+			denormalProtection = protection;
+		}
+
+		/** Samples for the network to decay by 60dB. */
+		int GetTailLengthInSamples() {
+			return (int)std::ceil(decayTimeInSeconds * sampleRate) + *std::max_element(delays, delays + N);
+		}
+
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the delay lines and the scratch buffers allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			this->sampleRate = sampleRate;
+			this->samplesPerBlock = samplesPerBlock;
+			delayLine.Prepare(sampleRate, samplesPerBlock, arena);
+			arena.AllocateBuffer(lines, N, samplesPerBlock);
+			arena.AllocateBuffer(inputCopy, numChannels, samplesPerBlock);
+			arena.AllocateBuffer(matrixScratch, 1, samplesPerBlock);
+			UpdateGains();
+			UpdateDamping();
+			isReady = true;
+			Reset();
+		}
+
+		void Process(ProcessContext<sT>& ctx) {
+			if (!isReady)
+				return;
+
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			int numSamples = output.GetNumSamples();
+			jassert(numSamples <= samplesPerBlock);
+			jassert(ctx.GetInput().GetNumChannels() >= numChannels && output.GetNumChannels() >= numChannels);
+
+			ScopedFlushDenormals flushDenormals{ denormalProtection == DenormalProtection::FlushToZero };
+			// The output is written per sub-block, the input is kept aside in case they are the same buffer.
+			AudioBufferView<sT> input{ inputCopy, 0, numSamples };
+			input.CopyFrom(ctx.GetInput());
+			for (int i = 0; i < numChannels; i++)
+				std::fill(output.GetChannelPtr(i), output.GetChannelPtr(i) + numSamples, sT{});
+
+			// A line is read delay samples back, a sub-block can't be longer than the shortest line.
+			int subBlockLength = *std::min_element(delays, delays + N);
+			for (int offset = 0; offset < numSamples; offset += subBlockLength)
+				ProcessSubBlock(input, output, offset, juce::jmin(subBlockLength, numSamples - offset));
+			noiseFloor = -noiseFloor;
+		}
+
+		void Reset() {
+			if (!isReady)
+				return;
+
+			delayLine.Reset();
+			std::fill(dampingStates, dampingStates + N, sT{});
+		}
+	private:
+		void ProcessSubBlock(AudioBufferView<sT>& input, AudioBufferView<sT>& output, int offset, int length) {
+			sT* rows[N];
+			for (int i = 0; i < N; i++)
+				rows[i] = lines.getWritePointer(i);
+
+			// Read the lines before the sub-block is written, so length samples less late.
+			for (int i = 0; i < N; i++) {
+				DelayLineSpan<sT> span = delayLine.GetReadSpan(delays[i] - length, length);
+				int split = span.GetSplit();
+				memcpy(rows[i], span.first.GetChannelPtr(i), sizeof(sT) * split);
+				memcpy(rows[i] + split, span.second.GetChannelPtr(i), sizeof(sT) * (length - split));
+			}
+
+			for (int i = 0; i < N; i++)
+				AudioBufferView_Impl<sT>::MulAdd(output.GetChannelPtr(i % numChannels) + offset, rows[i], outputGain, length);
+
+			ApplyDecay(rows, length);
+			MixingMatrix::template Apply<sT, N>(rows, matrixScratch.getWritePointer(0), length);
+
+			DelayLineSpan<sT> span = delayLine.GetWriteSpan(length);
+			int split = span.GetSplit();
+			for (int i = 0; i < N; i++) {
+				AudioBufferView_Impl<sT>::Add(rows[i], input.GetChannelPtr(i % numChannels) + offset, length);
+				if (denormalProtection == DenormalProtection::NoiseFloor)
+					AudioBufferView_Impl<sT>::AddScalar(rows[i], noiseFloor, length);
+				memcpy(span.first.GetChannelPtr(i), rows[i], sizeof(sT) * split);
+				memcpy(span.second.GetChannelPtr(i), rows[i] + split, sizeof(sT) * (length - split));
+			}
+			delayLine.CommitWrite(length);
+		}
+
+		/** rows *= decay gains, through the damping filters of the lines that have one. */
+		void ApplyDecay(sT* const* rows, int length) {
+			for (int i = 0; i < N; i++) {
+				if (dampingCoefficients[i] >= 1) {
+					AudioBufferView_Impl<sT>::MulScalar(rows[i], gains[i], length);
+					continue;
+				}
+
+				sT* row = rows[i];
+				sT state = dampingStates[i], gain = gains[i], coefficient = dampingCoefficients[i];
+				for (int j = 0; j < length; j++) {
+					state += coefficient * (row[j] * gain - state);
+					row[j] = state;
+				}
+				dampingStates[i] = state;
+			}
+		}
+
+		/** Gain of each line for the decay time, with the matrix normalization folded in. */
+		void UpdateGains() {
+			double scale = MixingMatrix::template GetScale<N>();
+			for (int i = 0; i < N; i++)
+				gains[i] = (sT)(scale * std::pow(10.0, -3.0 * delays[i] / (decayTimeInSeconds * sampleRate)));
+			outputGain = (sT)std::sqrt((double)numChannels / N);
+		}
+		void UpdateDamping() {
+			for (int i = 0; i < N; i++) {
+				float frequency = dampingFrequencies[i];
+				dampingCoefficients[i] = frequency <= 0 || frequency >= sampleRate * 0.5f ? (sT)1 :
+					(sT)(1.0 - std::exp(-2.0 * juce::MathConstants<double>::pi * frequency / sampleRate));
+			}
+		}
+	private:
+		bool isReady = false;
+		int numChannels = 2;
+		int maxDelayInSamples = 44110;
+		int sampleRate = 44100, samplesPerBlock = 0;
+		float decayTimeInSeconds = 2.0f;
+		int delays[N];
+		sT gains[N];
+		float dampingFrequencies[N] = {};
+		sT dampingCoefficients[N];
+		sT dampingStates[N] = {};
+		sT outputGain = 1;
+		DenormalProtection denormalProtection = DenormalProtection::FlushToZero;
+		sT noiseFloor = (sT)denormalNoiseFloor;
+		DelayLine<sT> delayLine;
+		juce::AudioBuffer<sT> lines{};
+		juce::AudioBuffer<sT> inputCopy{};
+		juce::AudioBuffer<sT> matrixScratch{};
+		Arena ownArena{};
+	};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+
+namespace Penny {
+	/**
+	 * Constant gain. It is an element wise stage, a Chain fuses it with its element wise neighbours in a single pass.
+	 */
+	template<typename sT>
+	class Gain : public BaseDSP<sT> {
+	public:
+		using SampleType = sT;
+		/** Process is equivalent to ProcessSample on every sample, independently. */
+		static constexpr bool isElementwise = true;
+	public:
+		Gain() {}
+		Gain(sT gain) : gain{ gain } {}
+
+		void SetGain(sT gain) {
+			this->gain = gain;
+		}
+		void SetGainDecibels(float gainInDecibels) {
+			gain = juce::Decibels::decibelsToGain((sT)gainInDecibels);
+		}
+		sT GetGain() {
+			return gain;
+		}
+
+		void Prepare(int, int) {}
+		void Process(ProcessContext<sT>& ctx) {
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			if (!ctx.IsInout())
+				output.CopyFrom(ctx.GetInput());
+			output *= gain;
+		}
+		inline sT ProcessSample(sT sample, int) const noexcept {
+			return sample * gain;
+		}
+		void Reset() {}
+	private:
+		sT gain = 1;
+	};
+}
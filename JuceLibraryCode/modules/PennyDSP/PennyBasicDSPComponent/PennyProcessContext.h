@@ -15,6 +15,36 @@ namespace Penny {
 		const AudioBufferView<sT>& GetInput() const noexcept { return input; }
 		AudioBufferView<sT>& GetOutput() noexcept { return output; }
 		bool IsInout() const noexcept { return isInout; }
+
+		/**
+		 * Call process with a context on each sub-block of at most subBlockSize samples, in order.
+		 * A whole graph run per sub-block keeps its working set in the L1 cache with large host blocks,
+		 * its components only need to be prepared for subBlockSize samples. 0 processes the whole block.
+		 */
+		template<typename ProcessFn>
+		void ForEachSubBlock(int subBlockSize, ProcessFn&& process) {
+			jassert(subBlockSize >= 0);
+			int numSamples = output.GetNumSamples();
+			if (subBlockSize == 0 || numSamples <= subBlockSize) {
+				process(*this);
+				return;
+			}
+
+			AudioBufferView<sT> in = input;
+			for (int offset = 0; offset < numSamples; offset += subBlockSize) {
+				int length = juce::jmin(subBlockSize, numSamples - offset);
+				AudioBufferView<sT> subOutput = output.GetSubView(offset, length);
+				if (isInout) {
+					ProcessContext subCtx{ subOutput };
+					process(subCtx);
+				}
+				else {
+					AudioBufferView<sT> subInput = in.GetSubView(offset, length);
+					ProcessContext subCtx{ subInput, subOutput };
+					process(subCtx);
+				}
+			}
+		}
 	private:
 		const AudioBufferView<sT>& input;
 		AudioBufferView<sT>& output;
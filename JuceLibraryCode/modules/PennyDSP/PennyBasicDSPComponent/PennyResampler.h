@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+#include <PennyDSP/PennySIMD/PennySIMDKernels.h>
+
+namespace Penny {
+	/**
+	 * Rational sample rate converter, a polyphase FIR filter (Kaiser windowed sinc) computed by the SIMD Dot kernel.
+	 * The rates are reduced to an up factor L and a down factor M, the filter has L phases of a few taps
+	 * precomputed in Prepare. Process consumes every input sample and returns how many output samples it wrote,
+	 * which changes from block to block, the count only depends on the total number of input samples.
+	 * The cutoff is at 42% of the lower rate (flat to about 16kHz at 48kHz), the stopband attenuation is about 80dB.
+	 */
+	template<typename sT>
+	class Resampler {
+	public:
+		using SampleType = sT;
+		/** Largest up factor, the rates are not converted (jassert) above it. */
+		static constexpr int maxUpFactor = 1024;
+	public:
+		/** Construct a resampler with 1 channel and 32 taps per phase */
+		Resampler() {}
+		/** Construct a resampler with specified number of channels and 32 taps per phase */
+		Resampler(int numChannels) : numChannels{ numChannels } {}
+		/** Construct a resampler with specified number of channels and taps per phase (at the lower rate) */
+		Resampler(int numChannels, int tapsPerPhase) : numChannels{ numChannels }, baseTapsPerPhase{ tapsPerPhase } {}
+
+		/** Set the output sample rate, 0 for the input one. It is used on next Prepare. */
+		void SetOutputSampleRate(int outputSampleRate) {
+			jassert(outputSampleRate >= 0);
+			this->outputSampleRate = outputSampleRate;
+		}
+		int GetOutputSampleRate() {
+			return outputSampleRate == 0 ? sampleRate : outputSampleRate;
+		}
+		int GetUpFactor() {
+			return upFactor;
+		}
+		int GetDownFactor() {
+			return downFactor;
+		}
+		/** True if the rates are the same, Process only copies. */
+		bool IsBypassed() {
+			return upFactor == downFactor;
+		}
+
+		/** Largest number of output samples Process can write for numInputSamples input samples. */
+		int GetMaxOutputSamples(int numInputSamples) {
+			return (int)(((long long)numInputSamples * upFactor + downFactor - 1) / downFactor);
+		}
+		/** Group delay of the filter, in input samples. */
+		double GetLatencyInSamples() {
+			if (IsBypassed())
+				return 0;
+			return ((double)upFactor * tapsPerPhase - 1.0) / (2.0 * upFactor);
+		}
+
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+		}
+		/** Same as Prepare, with the coefficients and the history allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			this->sampleRate = sampleRate;
+			this->samplesPerBlock = samplesPerBlock;
+
+			int targetSampleRate = GetOutputSampleRate();
+			int divisor = Gcd(sampleRate, targetSampleRate);
+			upFactor = targetSampleRate / divisor;
+			downFactor = sampleRate / divisor;
+			if (upFactor > maxUpFactor) {
+				jassertfalse;
+				upFactor = downFactor = 1;
+			}
+
+			if (!IsBypassed()) {
+				// The filter spans baseTapsPerPhase samples of the lower rate.
+				tapsPerPhase = baseTapsPerPhase * juce::jmax(1, (downFactor + upFactor - 1) / upFactor);
+				coefficients = arena.Allocate<sT>((size_t)upFactor * tapsPerPhase);
+				ComputeCoefficients(juce::jmin(sampleRate, targetSampleRate));
+				history = arena.AllocateChannels<sT>(numChannels, tapsPerPhase - 1 + samplesPerBlock);
+				if (downFactor == 1)
+					phaseBuffer = arena.Allocate<sT>((size_t)samplesPerBlock);
+			}
+
+			isReady = true;
+			Reset();
+		}
+
+		/**
+		 * Convert input into output and return the number of samples written to it, at most
+		 * GetMaxOutputSamples(input.GetNumSamples()). Input can be longer than the prepared block.
+		 */
+		int Process(const AudioBufferView<sT>& input, AudioBufferView<sT>& output) {
+			jassert(isReady);
+			jassert(input.GetNumChannels() >= numChannels && output.GetNumChannels() >= numChannels);
+			jassert(output.GetNumSamples() >= GetMaxOutputSamples(input.GetNumSamples()));
+
+			if (IsBypassed()) {
+				AudioBufferView<sT> outputView = output.GetSubView(0, input.GetNumSamples());
+				outputView.CopyFrom(input);
+				return input.GetNumSamples();
+			}
+
+			int numWritten = 0;
+			for (int offset = 0; offset < input.GetNumSamples(); offset += samplesPerBlock) {
+				int numSamples = juce::jmin(samplesPerBlock, input.GetNumSamples() - offset);
+				numWritten += ProcessChunk(input, offset, numSamples, output, numWritten);
+			}
+			return numWritten;
+		}
+
+		void Reset() {
+			if (!isReady)
+				return;
+
+			phase = 0;
+			if (!IsBypassed())
+				for (int channel = 0; channel < numChannels; channel++)
+					std::fill(history[channel], history[channel] + tapsPerPhase - 1, sT{});
+		}
+	private:
+		static int Gcd(int a, int b) {
+			while (b != 0) {
+				int r = a % b;
+				a = b;
+				b = r;
+			}
+			return a;
+		}
+
+		/** Modified Bessel function of the first kind of order 0, for the Kaiser window. */
+		static double BesselI0(double x) {
+			double sum = 1, term = 1;
+			for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+				term *= (x / (2.0 * k)) * (x / (2.0 * k));
+				sum += term;
+			}
+			return sum;
+		}
+
+		/** Design the prototype low pass at upFactor * sampleRate and split it in phases, each one reversed for Dot. */
+		void ComputeCoefficients(int lowerSampleRate) {
+			const double beta = 8.0;
+			int length = upFactor * tapsPerPhase;
+			double center = (length - 1) * 0.5;
+			double cutoff = 0.42 * lowerSampleRate / ((double)upFactor * sampleRate);
+			double windowNorm = BesselI0(beta);
+
+			for (int i = 0; i < length; i++) {
+				double t = i - center;
+				double x = 2.0 * cutoff * t;
+				double sinc = std::abs(x) < 1e-12 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+				double ratio = t / (center + 0.5);
+				double window = BesselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - ratio * ratio))) / windowNorm;
+				// Times upFactor to make up for the zeros stuffed between the input samples.
+				double h = 2.0 * cutoff * sinc * window * upFactor;
+
+				int phaseIndex = i % upFactor;
+				int tap = i / upFactor;
+				coefficients[phaseIndex * tapsPerPhase + (tapsPerPhase - 1 - tap)] = (sT)h;
+			}
+		}
+
+		int ProcessChunk(const AudioBufferView<sT>& input, int offset, int numSamples, AudioBufferView<sT>& output, int outputOffset) {
+			if (downFactor == 1)
+				return ProcessChunkInteger(input, offset, numSamples, output, outputOffset);
+
+			const SIMDKernelTable<sT>& kernels = SIMDKernels<sT>::Get();
+			int startPhase = phase, endPhase = phase, numWritten = 0;
+			for (int channel = 0; channel < numChannels; channel++) {
+				sT* channelHistory = history[channel];
+				memcpy(channelHistory + tapsPerPhase - 1, input.GetConstChannelPtr(channel) + offset, sizeof(sT) * numSamples);
+
+				sT* out = output.GetChannelPtr(channel) + outputOffset;
+				int currentPhase = startPhase, written = 0;
+				for (int i = 0; i < numSamples; i++) {
+					// Output samples falling between input sample i and the next one, the window ends at input sample i.
+					for (; currentPhase < upFactor; currentPhase += downFactor)
+						out[written++] = kernels.Dot(channelHistory + i, coefficients + currentPhase * tapsPerPhase, tapsPerPhase);
+					currentPhase -= upFactor;
+				}
+
+				memmove(channelHistory, channelHistory + numSamples, sizeof(sT) * (tapsPerPhase - 1));
+				endPhase = currentPhase;
+				numWritten = written;
+			}
+			phase = endPhase;
+			return numWritten;
+		}
+
+		/**
+		 * Integer up factor, every input sample gives one output per phase. Each phase is then a plain FIR filter,
+		 * run over the whole chunk with the axpy kernel instead of a Dot per output sample.
+		 */
+		int ProcessChunkInteger(const AudioBufferView<sT>& input, int offset, int numSamples, AudioBufferView<sT>& output, int outputOffset) {
+			const SIMDKernelTable<sT>& kernels = SIMDKernels<sT>::Get();
+			for (int channel = 0; channel < numChannels; channel++) {
+				sT* channelHistory = history[channel];
+				memcpy(channelHistory + tapsPerPhase - 1, input.GetConstChannelPtr(channel) + offset, sizeof(sT) * numSamples);
+
+				sT* out = output.GetChannelPtr(channel) + outputOffset;
+				for (int currentPhase = 0; currentPhase < upFactor; currentPhase++) {
+					const sT* phaseCoefficients = coefficients + currentPhase * tapsPerPhase;
+					std::fill(phaseBuffer, phaseBuffer + numSamples, sT{});
+					for (int tap = 0; tap < tapsPerPhase; tap++)
+						kernels.MulAdd(phaseBuffer, channelHistory + tap, phaseCoefficients[tap], numSamples);
+					for (int i = 0; i < numSamples; i++)
+						out[i * upFactor + currentPhase] = phaseBuffer[i];
+				}
+
+				memmove(channelHistory, channelHistory + numSamples, sizeof(sT) * (tapsPerPhase - 1));
+			}
+			return numSamples * upFactor;
+		}
+	private:
+		bool isReady = false;
+		int numChannels = 1;
+		int baseTapsPerPhase = 32;
+		int outputSampleRate = 0;
+		int sampleRate = 44100, samplesPerBlock = 0;
+		int upFactor = 1, downFactor = 1, tapsPerPhase = 0;
+		int phase = 0;
+		sT* coefficients = nullptr;
+		sT** history = nullptr;
+		sT* phaseBuffer = nullptr;
+		Arena ownArena{};
+	};
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cmath>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+
+namespace Penny {
+	enum class SmoothingType {
+		/** Constant step between each sample, for gains and mixing ratios. */
+		Linear,
+		/** Constant ratio between each sample, for frequencies. Values must be strictly positive. */
+		Multiplicative
+	};
+
+	/**
+	 * Parameter moving to its target value over a fixed ramp length.
+	 * The per sample values are generated a block at a time in a ramp buffer, with the SIMD kernels,
+	 * so the DSP components can consume them directly with the ramp operations of AudioBufferView.
+	 */
+	template<typename sT>
+	class SmoothedParameter {
+	public:
+		using SampleType = sT;
+	public:
+		/** Construct a linear smoothed parameter starting at 0 with a 50ms ramp */
+		SmoothedParameter() {}
+		/** Construct a smoothed parameter starting at initialValue with a 50ms ramp */
+		SmoothedParameter(sT initialValue, SmoothingType smoothingType = SmoothingType::Linear) :
+			smoothingType{ smoothingType }, currentValue{ initialValue }, targetValue{ initialValue } {}
+
+		/** Set the ramp length used by the next target changes. */
+		void SetRampLength(double rampLengthInSeconds) {
+			this->rampLengthInSeconds = rampLengthInSeconds;
+			rampLengthInSamples = (int)std::floor(rampLengthInSeconds * sampleRate);
+		}
+		double GetRampLength() {
+			return rampLengthInSeconds;
+		}
+
+		/** Start moving to a new value, nothing happens if it is already the target. */
+		void SetTargetValue(sT value) {
+			if (value == targetValue)
+				return;
+
+			targetValue = value;
+			if (rampLengthInSamples <= 0) {
+				SetCurrentAndTargetValue(value);
+				return;
+			}
+
+			countdown = rampLengthInSamples;
+			if (smoothingType == SmoothingType::Linear) {
+				step = (targetValue - currentValue) / (sT)countdown;
+			}
+			else {
+				jassert(currentValue > 0 && targetValue > 0);
+				step = (sT)std::exp(std::log((double)targetValue / (double)currentValue) / countdown);
+			}
+		}
+		/** Jump straight to value. */
+		void SetCurrentAndTargetValue(sT value) {
+			currentValue = targetValue = value;
+			countdown = 0;
+		}
+
+		inline sT GetCurrentValue() const noexcept { return currentValue; }
+		inline sT GetTargetValue() const noexcept { return targetValue; }
+		inline bool IsSmoothing() const noexcept { return countdown > 0; }
+
+		/**
+		 * Get the values of the next numSamples samples and advance the parameter.
+		 * The ramp is owned by the parameter and valid until the next call.
+		 */
+		const sT* GetNextRamp(int numSamples) {
+			jassert(numSamples <= rampBuffer.getNumSamples());
+			sT* ramp = rampBuffer.getWritePointer(0);
+
+			int rampSamples = juce::jmin(numSamples, countdown);
+			if (rampSamples > 0) {
+				if (smoothingType == SmoothingType::Linear)
+					AudioBufferView_Impl<sT>::LinearRamp(ramp, currentValue + step, step, rampSamples);
+				else
+					AudioBufferView_Impl<sT>::GeometricRamp(ramp, currentValue * step, step, rampSamples);
+
+				countdown -= rampSamples;
+				currentValue = countdown == 0 ? targetValue : ramp[rampSamples - 1];
+			}
+			for (int i = rampSamples; i < numSamples; i++)
+				ramp[i] = targetValue;
+
+			return ramp;
+		}
+		/** Advance the parameter without generating the values. */
+		void Skip(int numSamples) {
+			int rampSamples = juce::jmin(numSamples, countdown);
+			if (rampSamples <= 0)
+				return;
+
+			countdown -= rampSamples;
+			if (countdown == 0)
+				currentValue = targetValue;
+			else if (smoothingType == SmoothingType::Linear)
+				currentValue += step * (sT)rampSamples;
+			else
+				currentValue *= (sT)std::pow((double)step, rampSamples);
+		}
+
+		/** Allocate the ramp buffer, the parameter jumps to its target. */
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			this->sampleRate = sampleRate;
+			rampBuffer.setSize(1, samplesPerBlock);
+			SetRampLength(rampLengthInSeconds);
+			SetCurrentAndTargetValue(targetValue);
+		}
+		/** Same as Prepare, with the ramp buffer allocated from arena. */
+		void Prepare(int sampleRate, int samplesPerBlock, Arena& arena) {
+			this->sampleRate = sampleRate;
+			arena.AllocateBuffer(rampBuffer, 1, samplesPerBlock);
+			SetRampLength(rampLengthInSeconds);
+			SetCurrentAndTargetValue(targetValue);
+		}
+		void Reset() {
+			SetCurrentAndTargetValue(targetValue);
+		}
+	private:
+		SmoothingType smoothingType = SmoothingType::Linear;
+		double rampLengthInSeconds = 0.05;
+		int sampleRate = 44100;
+		int rampLengthInSamples = 0;
+		int countdown = 0;
+		sT currentValue{}, targetValue{}, step{};
+		juce::AudioBuffer<sT> rampBuffer{};
+	};
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyThreading/PennyRealtimeCheck.h>
+
+namespace Penny {
+	/**
+	 * Linear allocator handing out cache line aligned regions of one memory block.
+	 * A processing graph owns one, and its components carve their delay lines and scratch buffers out of it in Prepare,
+	 * so the memory of the graph is a single contiguous block allocated once.
+	 * Regions are never freed one by one, Clear releases all of them.
+	 * If the block is full the arena grows with a new block, Clear then merges them so the next layout is contiguous.
+	 */
+	class Arena {
+	public:
+		static constexpr size_t alignment = 64;
+	public:
+		Arena() {}
+		explicit Arena(size_t capacityInBytes) { Reserve(capacityInBytes); }
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		/** Release every region and allocate a single block of capacityInBytes bytes. */
+		void Reserve(size_t capacityInBytes) {
+			blocks.clear();
+			AddBlock(capacityInBytes);
+		}
+		/** Release every region, the memory is kept. */
+		void Clear() {
+			if (blocks.size() > 1) {
+				Reserve(GetUsedBytes());
+				return;
+			}
+			for (Block& block : blocks)
+				block.used = 0;
+		}
+
+		/**
+		 * Call prepare, which allocates the regions of a graph from this arena.
+		 * It is called a second time if the regions did not fit in a single block, so they end up contiguous.
+		 */
+		template<typename PrepareFunction>
+		void Layout(PrepareFunction&& prepare) {
+			Clear();
+			prepare();
+			if (blocks.size() > 1) {
+				Clear();
+				prepare();
+			}
+		}
+
+		/** Allocate an aligned and uninitialised array of count T, T must be trivial. */
+		template<typename T>
+		T* Allocate(size_t count) {
+			static_assert(std::is_trivially_destructible<T>::value, "Arena regions are never destroyed.");
+			return reinterpret_cast<T*>(AllocateBytes(count * sizeof(T)));
+		}
+		/** Allocate numChannels aligned channels of numSamples samples, return the array of channel pointers. */
+		template<typename T>
+		T** AllocateChannels(int numChannels, int numSamples) {
+			T** channels = Allocate<T*>((size_t)numChannels);
+			for (int i = 0; i < numChannels; i++)
+				channels[i] = Allocate<T>((size_t)numSamples);
+			return channels;
+		}
+		/** Make buffer refer to numChannels cleared channels of numSamples samples allocated from the arena. */
+		template<typename T>
+		void AllocateBuffer(juce::AudioBuffer<T>& buffer, int numChannels, int numSamples) {
+			buffer.setDataToReferTo(AllocateChannels<T>(numChannels, numSamples), numChannels, numSamples);
+			buffer.clear();
+		}
+
+		inline size_t GetUsedBytes() const noexcept {
+			size_t used = 0;
+			for (const Block& block : blocks)
+				used += block.used;
+			return used;
+		}
+		inline size_t GetCapacity() const noexcept {
+			size_t capacity = 0;
+			for (const Block& block : blocks)
+				capacity += block.capacity;
+			return capacity;
+		}
+		inline int GetNumBlocks() const noexcept { return (int)blocks.size(); }
+	private:
+		struct Block {
+			std::unique_ptr<char[]> memory;
+			char* data;
+			size_t capacity;
+			size_t used;
+		};
+
+		void* AllocateBytes(size_t size) {
+			size = (size + alignment - 1) & ~(alignment - 1);
+			if (blocks.empty() || blocks.back().capacity - blocks.back().used < size) {
+				size_t lastCapacity = blocks.empty() ? 0 : blocks.back().capacity;
+				AddBlock(juce::jmax(size, juce::jmax(lastCapacity * 2, (size_t)minBlockSize)));
+			}
+
+			Block& block = blocks.back();
+			void* ptr = block.data + block.used;
+			block.used += size;
+			return ptr;
+		}
+		void AddBlock(size_t capacity) {
+			PENNY_ASSERT_NOT_REALTIME();
+			Block block;
+			block.memory.reset(new char[capacity + alignment]);
+			block.data = block.memory.get() + ((alignment - (uintptr_t)block.memory.get() % alignment) % alignment);
+			block.capacity = capacity;
+			block.used = 0;
+			blocks.push_back(std::move(block));
+		}
+	private:
+		static constexpr size_t minBlockSize = 64 * 1024;
+		std::vector<Block> blocks{};
+	};
+}
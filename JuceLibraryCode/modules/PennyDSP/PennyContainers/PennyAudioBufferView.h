@@ -1,83 +1,66 @@
 #pragma once
 
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennySIMD/PennySIMDKernels.h>
 
 namespace Penny {
+	/** Per channel kernels, dispatched to the best instruction set of the machine. */
 	template<typename sT>
 	struct AudioBufferView_Impl {
 	public:
-		static void Add(sT* __restrict dst, sT* __restrict buffer, int size) {
-			for (int i = 0; i < dsize; i++)
-				dst[i] += buffer[i];
+		static void Add(sT* __restrict dst, const sT* __restrict buffer, int size) {
+			SIMDKernels<sT>::Get().Add(dst, buffer, size);
 		}
-		static void Sub(sT* __restrict dst, sT* __restrict buffer, int size) {
-			for (int i = 0; i < dsize; i++)
-				dst[i] -= buffer[i];
+		static void Sub(sT* __restrict dst, const sT* __restrict buffer, int size) {
+			SIMDKernels<sT>::Get().Sub(dst, buffer, size);
 		}
-		static void Mul(sT* __restrict dst, sT* __restrict buffer, int size) {
-			for (int i = 0; i < dsize; i++)
-				dst[i] *= buffer[i];
+		static void Mul(sT* __restrict dst, const sT* __restrict buffer, int size) {
+			SIMDKernels<sT>::Get().Mul(dst, buffer, size);
 		}
-		static void Div(sT* __restrict dst, sT* __restrict buffer, int size) {
-			for (int i = 0; i < dsize; i++)
-				dst[i] /= buffer[i];
+		static void Div(sT* __restrict dst, const sT* __restrict buffer, int size) {
+			SIMDKernels<sT>::Get().Div(dst, buffer, size);
 		}
-	};
-
-	template<>
-	struct AudioBufferView_Impl<float> {
-	public:
-		static void Add(float* __restrict dst, float* __restrict buffer, int size) {
-			__m256* vDst = (__m256*)dst;
-			__m256* vBuffer = (__m256*)buffer;
-			int qsize = (size / 8);
-			for (int i = 0; i < qsize; i++) {
-				vDst[i] = _mm256_add_ps(vDst[i], vBuffer[i]);
-			}
-			if (qsize * 8 != size) {
-				for (int i = qsize * 8; i < size; i++) {
-					dst[i] += buffer[i];
-				}
-			}
-		}
-		static void Sub(float* __restrict dst, float* __restrict buffer, int size) {
-			__m256* vDst = (__m256*)dst;
-			__m256* vBuffer = (__m256*)buffer;
-			int qsize = (size / 8);
-			for (int i = 0; i < qsize; i++) {
-				vDst[i] = _mm256_sub_ps(vDst[i], vBuffer[i]);
-			}
-			if (qsize * 8 != size) {
-				for (int i = qsize * 8; i < size; i++) {
-					dst[i] -= buffer[i];
-				}
-			}
-		}
-		static void Mul(float* __restrict dst, float* __restrict buffer, int size) {
-			__m256* vDst = (__m256*)dst;
-			__m256* vBuffer = (__m256*)buffer;
-			int qsize = (size / 8);
-			for (int i = 0; i < qsize; i++) {
-				vDst[i] = _mm256_mul_ps(vDst[i], vBuffer[i]);
-			}
-			if (qsize * 8 != size) {
-				for (int i = qsize * 8; i < size; i++) {
-					dst[i] *= buffer[i];
-				}
-			}
-		}
-		static void Div(float* __restrict dst, float* __restrict buffer, int size) {
-			__m256* vDst = (__m256*)dst;
-			__m256* vBuffer = (__m256*)buffer;
-			int qsize = (size / 8);
-			for (int i = 0; i < qsize; i++) {
-				vDst[i] = _mm256_div_ps(vDst[i], vBuffer[i]);
-			}
-			if (qsize * 8 != size) {
-				for (int i = qsize * 8; i < size; i++) {
-					dst[i] /= buffer[i];
-				}
-			}
+		static void AddScalar(sT* __restrict dst, sT value, int size) {
+			SIMDKernels<sT>::Get().AddScalar(dst, value, size);
+		}
+		static void MulScalar(sT* __restrict dst, sT value, int size) {
+			SIMDKernels<sT>::Get().MulScalar(dst, value, size);
+		}
+		static void DivScalar(sT* __restrict dst, sT value, int size) {
+			SIMDKernels<sT>::Get().DivScalar(dst, value, size);
+		}
+		static void MulAdd(sT* __restrict dst, const sT* __restrict buffer, sT gain, int size) {
+			SIMDKernels<sT>::Get().MulAdd(dst, buffer, gain, size);
+		}
+		static void LinearCombination(sT* __restrict dst, const sT* __restrict buffer, sT bufferGain, sT dstGain, int size) {
+			SIMDKernels<sT>::Get().LinearCombination(dst, buffer, bufferGain, dstGain, size);
+		}
+		static void CrossFade(sT* __restrict dst, const sT* __restrict buffer, const sT* __restrict ramp, int size) {
+			SIMDKernels<sT>::Get().CrossFade(dst, buffer, ramp, size);
+		}
+		static void MulRampAdd(sT* __restrict dst, const sT* __restrict buffer, const sT* __restrict ramp, int size) {
+			SIMDKernels<sT>::Get().MulRampAdd(dst, buffer, ramp, size);
+		}
+		static void MulAddRamp(sT* __restrict dst, const sT* __restrict buffer, const sT* __restrict ramp, int size) {
+			SIMDKernels<sT>::Get().MulAddRamp(dst, buffer, ramp, size);
+		}
+		static void LinearRamp(sT* __restrict dst, sT start, sT step, int size) {
+			SIMDKernels<sT>::Get().LinearRamp(dst, start, step, size);
+		}
+		static void GeometricRamp(sT* __restrict dst, sT start, sT factor, int size) {
+			SIMDKernels<sT>::Get().GeometricRamp(dst, start, factor, size);
+		}
+		static void GatherMulAdd(sT* __restrict dst, const sT* __restrict buffer, const int32_t* __restrict indices, const sT* __restrict gains, int size) {
+			SIMDKernels<sT>::Get().GatherMulAdd(dst, buffer, indices, gains, size);
+		}
+		static void Butterfly(sT* __restrict a, sT* __restrict b, int size) {
+			SIMDKernels<sT>::Get().Butterfly(a, b, size);
+		}
+		static sT Dot(const sT* __restrict a, const sT* __restrict b, int size) {
+			return SIMDKernels<sT>::Get().Dot(a, b, size);
+		}
+		static sT Peak(const sT* __restrict src, int size) {
+			return SIMDKernels<sT>::Get().Peak(src, size);
 		}
 	};
 
@@ -140,14 +123,19 @@ namespace Penny {
 		/** Get new audio buffer view, viewing multiple channels. */
 		inline AudioBufferView GetChannelsView(int startChannel, int numChannels) {
 			jassert(startChannel < this->numChannels && startChannel > -1);
-			jassert(numChannels > -1 && startChannel + numChannels < this->numChannels);
+			jassert(numChannels > -1 && startChannel + numChannels <= this->numChannels);
 			return AudioBufferView{ channels + startChannel, numChannels, offset, size };
 		}
 		/** Get new audio buffer view, offseting this one. */
 		inline AudioBufferView GetOffsetView(int offset) {
-			jassert(offset < length);
+			jassert(offset <= size);
 			return AudioBufferView{ channels, numChannels, this->offset + offset, size - offset };
 		}
+		/** Get new audio buffer view, viewing length samples from offset. */
+		inline AudioBufferView GetSubView(int offset, int length) {
+			jassert(offset >= 0 && length >= 0 && offset + length <= size);
+			return AudioBufferView{ channels, numChannels, this->offset + offset, length };
+		}
 
 		/** Get sample from specified channel. */
 		inline SampleType GetSample(int channel, int idx) const {
@@ -169,95 +157,124 @@ namespace Penny {
 			jassert(srcStartOffset > -1 && srcStartOffset + length <= src.GetNumSamples());
 
 			const SampleType* channelData = src.GetConstChannelPtr(srcChannel);
-			memcpy(channels[channel] + startOffset, channelData + srcStartOffset, sizeof(SampleType) * length);
+			memcpy(channels[channel] + offset + startOffset, channelData + srcStartOffset, sizeof(SampleType) * length);
+		}
+		/** Copy every channel of src to this audio buffer view, src must be at least as big. */
+		void CopyFrom(const AudioBufferView<SampleType>& src) {
+			for (int i = 0; i < numChannels; i++)
+				CopyFrom(i, 0, src, i, 0, size);
 		}
 		/** Copy sample in src ptr to this audio buffer view specified channel. */
 		void CopyFrom(int channel, int startOffset, const SampleType* src, int length) {
 			jassert(channel < numChannels&& channel > -1);
 			jassert(startOffset > -1 && startOffset + length <= size);
 			
-			memcpy(channels[channel] + startOffset, src, sizeof(SampleType) * length);
+			memcpy(channels[channel] + offset + startOffset, src, sizeof(SampleType) * length);
+		}
+
+		/** Set every sample to 0. */
+		void Clear() {
+			for (int i = 0; i < numChannels; i++)
+				std::fill(GetChannelPtr(i), GetChannelPtr(i) + size, SampleType{});
+		}
+
+		/** The largest absolute sample of every channel. */
+		SampleType GetPeak() const {
+			SampleType peak{};
+			for (int i = 0; i < numChannels; i++)
+				peak = std::max(peak, AudioBufferView_Impl<sT>::Peak(GetConstChannelPtr(i), size));
+			return peak;
+		}
+		/** The root mean square of every channel together. */
+		SampleType GetRMS() const {
+			if (numChannels == 0 || size == 0)
+				return SampleType{};
+			SampleType sum{};
+			for (int i = 0; i < numChannels; i++)
+				sum += AudioBufferView_Impl<sT>::Dot(GetConstChannelPtr(i), GetConstChannelPtr(i), size);
+			return std::sqrt(sum / (SampleType)(numChannels * size));
 		}
 
 		void operator+=(SampleType value) {
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				for (int j = 0; j < size; j++) {
-					data[offset + j] += value;
-				}
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::AddScalar(GetChannelPtr(i), value, size);
 		}
 		void operator+=(const AudioBufferView<SampleType>& src) {
 			jassert(src.GetNumChannels() >= numChannels);
 			jassert(src.GetNumSamples() >= size);
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				const SampleType* __restrict srcData = src.GetConstChannelPtr(i);
-				/*for (int j = 0; j < size; j++) {
-					data[offset + j] += srcData[src.offset + j];
-				}*/
-				AudioBufferView_Impl<sT>::Add(data, const_cast<SampleType*>(srcData + src.offset), size);
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::Add(GetChannelPtr(i), src.GetConstChannelPtr(i), size);
 		}
 		void operator-=(SampleType value) {
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				for (int j = 0; j < size; j++) {
-					data[offset + j] -= value;
-				}
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::AddScalar(GetChannelPtr(i), -value, size);
 		}
 		void operator-=(const AudioBufferView<SampleType>& src) {
 			jassert(src.GetNumChannels() >= numChannels);
 			jassert(src.GetNumSamples() >= size);
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				const SampleType* __restrict srcData = src.GetConstChannelPtr(i);
-				/*for (int j = 0; j < size; j++) {
-					data[offset + j] += srcData[src.offset + j];
-				}*/
-				AudioBufferView_Impl<sT>::Sub(data, const_cast<SampleType*>(srcData + src.offset), size);
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::Sub(GetChannelPtr(i), src.GetConstChannelPtr(i), size);
 		}
 		void operator*=(SampleType value) {
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				for (int j = 0; j < size; j++) {
-					data[offset + j] *= value;
-				}
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::MulScalar(GetChannelPtr(i), value, size);
 		}
 		void operator*=(const AudioBufferView<SampleType>& src) {
 			jassert(src.GetNumChannels() >= numChannels);
 			jassert(src.GetNumSamples() >= size);
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				const SampleType* __restrict srcData = src.GetConstChannelPtr(i);
-				/*for (int j = 0; j < size; j++) {
-					data[offset + j] += srcData[src.offset + j];
-				}*/
-				AudioBufferView_Impl<sT>::Mul(data, const_cast<SampleType*>(srcData + src.offset), size);
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::Mul(GetChannelPtr(i), src.GetConstChannelPtr(i), size);
 		}
 		void operator/=(SampleType value) {
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				for (int j = 0; j < size; j++) {
-					data[offset + j] /= value;
-				}
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::DivScalar(GetChannelPtr(i), value, size);
 		}
 		void operator/=(const AudioBufferView<SampleType>& src) {
 			jassert(src.GetNumChannels() >= numChannels);
 			jassert(src.GetNumSamples() >= size);
-			for (int i = 0; i < numChannels; i++) {
-				SampleType* __restrict data = channels[i];
-				const SampleType* __restrict srcData = src.GetConstChannelPtr(i);
-				/*for (int j = 0; j < size; j++) {
-					data[offset + j] += srcData[src.offset + j];
-				}*/
-				AudioBufferView_Impl<sT>::Div(data, const_cast<SampleType*>(srcData + src.offset), size);
-			}
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::Div(GetChannelPtr(i), src.GetConstChannelPtr(i), size);
+		}
+
+		/** this += src * gain, in a single pass. */
+		void MulAdd(const AudioBufferView<SampleType>& src, SampleType gain) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() >= size);
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::MulAdd(GetChannelPtr(i), src.GetConstChannelPtr(i), gain, size);
+		}
+		/** this = src * srcGain + this * gain, in a single pass. */
+		void LinearCombination(const AudioBufferView<SampleType>& src, SampleType srcGain, SampleType gain) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() >= size);
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::LinearCombination(GetChannelPtr(i), src.GetConstChannelPtr(i), srcGain, gain, size);
+		}
+		/** Crossfade from src to this, this = src + (this - src) * ramp, ramp holds GetNumSamples() values shared by every channel. */
+		void CrossFade(const AudioBufferView<SampleType>& src, const SampleType* ramp) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() >= size);
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::CrossFade(GetChannelPtr(i), src.GetConstChannelPtr(i), ramp, size);
+		}
+		/** this *= ramp, ramp holds GetNumSamples() values shared by every channel. */
+		void MulRamp(const SampleType* ramp) {
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::Mul(GetChannelPtr(i), ramp, size);
+		}
+		/** this = this * ramp + src, in a single pass, ramp holds GetNumSamples() values shared by every channel. */
+		void MulRampAdd(const AudioBufferView<SampleType>& src, const SampleType* ramp) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() >= size);
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::MulRampAdd(GetChannelPtr(i), src.GetConstChannelPtr(i), ramp, size);
+		}
+		/** this += src * ramp, ramp holds GetNumSamples() values shared by every channel. */
+		void MulAddRamp(const AudioBufferView<SampleType>& src, const SampleType* ramp) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() >= size);
+			for (int i = 0; i < numChannels; i++)
+				AudioBufferView_Impl<sT>::MulAddRamp(GetChannelPtr(i), src.GetConstChannelPtr(i), ramp, size);
 		}
 	private:
 		int numChannels, size, offset;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyContainers/PennyArena.h>
+
+namespace Penny {
+	/**
+	 * Multichannel buffer stored frame by frame, the numChannels samples of an instant are contiguous.
+	 * A bank of parallel filters running on it processes every channel with the same vector instructions,
+	 * a flat run of GetNumValues() values instead of one loop per channel.
+	 */
+	template<typename sT>
+	class InterleavedBuffer {
+	public:
+		using SampleType = sT;
+	public:
+		InterleavedBuffer() {}
+		InterleavedBuffer(int numChannels, int numSamples) { SetSize(numChannels, numSamples); }
+
+		/** Allocate a cleared buffer of numSamples frames of numChannels samples. */
+		void SetSize(int numChannels, int numSamples) {
+			this->numChannels = numChannels;
+			this->numSamples = numSamples;
+			data.setSize(1, numChannels * numSamples);
+			data.clear();
+		}
+		/** Same as SetSize, with the memory allocated from arena. */
+		void SetSize(int numChannels, int numSamples, Arena& arena) {
+			this->numChannels = numChannels;
+			this->numSamples = numSamples;
+			arena.AllocateBuffer(data, 1, numChannels * numSamples);
+		}
+
+		inline int GetNumChannels() const noexcept { return numChannels; }
+		/** Get frames number. */
+		inline int GetNumSamples() const noexcept { return numSamples; }
+		/** Get the number of values, numChannels per frame. */
+		inline int GetNumValues() const noexcept { return numChannels * numSamples; }
+
+		inline SampleType* GetData() { return data.getWritePointer(0); }
+		inline const SampleType* GetData() const { return data.getReadPointer(0); }
+		/** Get raw ptr to the numChannels samples of a frame. */
+		inline SampleType* GetFrame(int sample) {
+			jassert(sample >= 0 && sample < numSamples);
+			return GetData() + sample * numChannels;
+		}
+		inline const SampleType* GetFrame(int sample) const {
+			jassert(sample >= 0 && sample < numSamples);
+			return GetData() + sample * numChannels;
+		}
+
+		void Clear() {
+			data.clear();
+		}
+
+		/** Interleave the first numChannels channels of src in the first src.GetNumSamples() frames. */
+		void CopyFrom(const AudioBufferView<SampleType>& src) {
+			jassert(src.GetNumChannels() >= numChannels);
+			jassert(src.GetNumSamples() <= numSamples);
+			SampleType* dst = GetData();
+			for (int i = 0; i < numChannels; i++) {
+				const SampleType* channel = src.GetConstChannelPtr(i);
+				for (int j = 0; j < src.GetNumSamples(); j++)
+					dst[j * numChannels + i] = channel[j];
+			}
+		}
+		/** Deinterleave the first dst.GetNumSamples() frames in the first numChannels channels of dst. */
+		void CopyTo(AudioBufferView<SampleType>& dst) const {
+			jassert(dst.GetNumChannels() >= numChannels);
+			jassert(dst.GetNumSamples() <= numSamples);
+			const SampleType* src = GetData();
+			for (int i = 0; i < numChannels; i++) {
+				SampleType* channel = dst.GetChannelPtr(i);
+				for (int j = 0; j < dst.GetNumSamples(); j++)
+					channel[j] = src[j * numChannels + i];
+			}
+		}
+	private:
+		int numChannels = 0;
+		int numSamples = 0;
+		juce::AudioBuffer<sT> data{};
+	};
+}
@@ -0,0 +1,7 @@
+/*
+ * The few parts of PennyDSP that are not header only, compiled once with the module.
+ */
+
+#include "PennyDSP.h"
+
+#include "PennyThreading/PennySemaphore.cpp"
@@ -20,14 +20,38 @@
 
 *******************************************************************************/
 
+#include "PennySIMD/PennyCPUFeatures.h"
+#include "PennySIMD/PennySIMDKernels.h"
+#include "PennySIMD/PennyDenormals.h"
+
 #include "PennyContainers/PennyAudioBufferView.h"
+#include "PennyContainers/PennyArena.h"
+#include "PennyContainers/PennyInterleavedBuffer.h"
+
+#include "PennyThreading/PennySemaphore.h"
+#include "PennyThreading/PennyWorkerPool.h"
+#include "PennyThreading/PennyRealtimeCheck.h"
+#include "PennyThreading/PennyProfiler.h"
+#include "PennyThreading/PennyTripleBuffer.h"
 
 #include "PennyMath/PennyConvolution.h"
+#include "PennyMath/PennyFFT.h"
+#include "PennyMath/PennyIRCache.h"
 #include "PennyMath/PennyFFTConvolution.h"
+#include "PennyMath/PennyConvolutionStage.h"
+#include "PennyMath/PennyNonUniformConvolution.h"
+#include "PennyMath/PennyMixingMatrix.h"
 
 #include "PennyBasicDSPComponent/PennyBaseDSP.h"
 #include "PennyBasicDSPComponent/PennyProcessContext.h"
 #include "PennyBasicDSPComponent/PennyDelayLine.h"
+#include "PennyBasicDSPComponent/PennySmoothedParameter.h"
 #include "PennyBasicDSPComponent/PennyDryWetMixer.h"
-#include "PennybasicDSPComponent/PennyCombFilter.h"
-#include "PennybasicDSPComponent/PennyAllPassFilter.h"
+#include "PennyBasicDSPComponent/PennyCombFilter.h"
+#include "PennyBasicDSPComponent/PennyAllPassFilter.h"
+#include "PennyBasicDSPComponent/PennyCombFilterBank.h"
+#include "PennyBasicDSPComponent/PennyAllPassFilterBank.h"
+#include "PennyBasicDSPComponent/PennyFDN.h"
+#include "PennyBasicDSPComponent/PennyGain.h"
+#include "PennyBasicDSPComponent/PennyChain.h"
+#include "PennyBasicDSPComponent/PennyResampler.h"
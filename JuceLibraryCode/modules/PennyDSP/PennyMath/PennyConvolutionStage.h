@@ -0,0 +1,328 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyMath/PennyFFT.h>
+#include <PennyDSP/PennyMath/PennyIRCache.h>
+#include <PennyDSP/PennyThreading/PennyWorkerPool.h>
+
+namespace Penny {
+	/**
+	 * One uniformly partitioned segment of an impulse response, processed block by block.
+	 * Input is gathered until a whole partition is received, the block is then convolved with every partition
+	 * of the segment. The work of a block is cut in small steps (forward FFT, one complex multiply per partition,
+	 * inverse FFT, for each channel) so it can be done as soon as the block is complete (0 delay block), or spread
+	 * over the next block (1 delay block). Its result is played delayBlocks blocks after the block is complete.
+	 * The output of the stage is delayed by GetLatency() samples, so the segment must start exactly this far in the IR:
+	 * the earlier stages cover the samples before it, and any other offset would misalign every partition.
+	 * A delayed stage can also hand its block work to a WorkerPool thread, the worker then has delayBlocks blocks
+	 * to finish it. The audio thread never runs nor waits for that work: a block that is not ready in time
+	 * is counted as late (see GetLateBlocks) and the stage plays silence for it.
+	 */
+	template<typename sT>
+	class ConvolutionStage {
+	public:
+		using SampleType = sT;
+		using ComplexType = std::complex<sT>;
+	public:
+		/**
+		 * Compute the partitions spectra and allocate the stage buffers.
+		 *
+		 * \param ir : the whole impulse response, if it has less channels than numChannels the last one is reused.
+		 * \param irOffset : first sample of the segment in ir, it must be the latency of the stage.
+		 * \param partitionSize : partition size, must be a power of 2.
+		 * \param numPartitions : number of partitions in the segment.
+		 * \param delayBlocks : number of blocks between a block being complete and its result being played,
+		 *                      the latency is then (delayBlocks + 1) * partitionSize.
+		 */
+		void Prepare(int numChannels, const juce::AudioBuffer<sT>& ir, int irOffset, int partitionSize, int numPartitions, int delayBlocks) {
+			IRSpectraKey key{ 0, irOffset, partitionSize, numPartitions, 0 };
+			Prepare(numChannels, std::make_shared<const IRSpectra<sT>>(ir, key), delayBlocks);
+		}
+		/**
+		 * Same as Prepare, with the partitions spectra already computed (or shared by an IRCache).
+		 * The segment, partition size and number of partitions are the ones of irSpectra.
+		 */
+		void Prepare(int numChannels, std::shared_ptr<const IRSpectra<sT>> irSpectra, int delayBlocks) {
+			jassert(irSpectra != nullptr);
+			jassert(delayBlocks >= 0);
+			CompleteBlocks();
+			this->numChannels = numChannels;
+			this->irOffset = irSpectra->GetKey().irOffset;
+			this->partitionSize = irSpectra->GetPartitionSize();
+			this->numPartitions = irSpectra->GetPartitionsNumber();
+			this->delayBlocks = delayBlocks;
+			jassert(irOffset == GetLatency());
+			this->irSpectra = std::move(irSpectra);
+			lateBlocks.store(0, std::memory_order_relaxed);
+			// The input is transformed with the FFT of the spectra, shared with the other users of the cache.
+			fft = this->irSpectra->GetSharedFFT();
+			numBins = fft->GetNumBins();
+
+			inputFrames.setSize(numChannels, partitionSize * 2);
+			// A block is played delayBlocks blocks after its own, the next one may reuse its buffers only then.
+			blocks.clear();
+			for (int i = 0; i <= delayBlocks; i++) {
+				blocks.push_back(std::make_unique<Block>(*this));
+				blocks.back()->frame.setSize(numChannels, partitionSize * 2);
+				blocks.back()->output.setSize(numChannels, partitionSize);
+			}
+			inputSpectra.assign((size_t)numChannels * numPartitions * numBins, ComplexType{});
+			accumulators.assign((size_t)numChannels * numBins, ComplexType{});
+			inverseFrame.resize(partitionSize * 2);
+
+			Reset();
+		}
+
+		/**
+		 * Run the block work on a worker of pool instead of the calling thread, only for delayed stages. nullptr to disable.
+		 * Every block of the stage goes to the same worker, so they are computed one after the other, in order.
+		 */
+		void SetWorker(WorkerPool* pool, int workerIndex) {
+			jassert(pool == nullptr || delayBlocks > 0);
+			CompleteBlocks();
+			this->pool = pool;
+			this->workerIndex = workerIndex;
+		}
+		/**
+		 * When rendering offline, wait for a late worker instead of playing silence. A worker is only late because
+		 * the blocks come faster than real time then, never set it on the audio thread of a live host.
+		 */
+		void SetNonRealtime(bool nonRealtime) {
+			this->nonRealtime = nonRealtime;
+		}
+
+		inline int GetPartitionSize() const noexcept { return partitionSize; }
+		inline int GetPartitionsNumber() const noexcept { return numPartitions; }
+		inline int GetIROffset() const noexcept { return irOffset; }
+		inline int GetDelayBlocks() const noexcept { return delayBlocks; }
+		/** Delay between a sample entering the stage and its first contribution going out. */
+		inline int GetLatency() const noexcept { return partitionSize * (delayBlocks + 1); }
+		/** Number of work steps needed by one block. */
+		inline int GetTotalWork() const noexcept { return numChannels * (numPartitions + 2); }
+		/** Number of blocks played as silence because the worker was late, since Prepare. Can be read from any thread. */
+		inline int GetLateBlocks() const noexcept { return lateBlocks.load(std::memory_order_relaxed); }
+
+		/**
+		 * Push input and accumulate the stage output in output.
+		 * The number of samples must not cross a partition boundary.
+		 */
+		void Process(const AudioBufferView<sT>& input, AudioBufferView<sT>& output) {
+			int numSamples = input.GetNumSamples();
+			jassert(position + numSamples <= partitionSize);
+
+			for (int channel = 0; channel < numChannels; channel++) {
+				if (ready != nullptr) {
+					const sT* readyData = ready->getReadPointer(channel, position);
+					sT* outputData = output.GetChannelPtr(channel);
+					for (int i = 0; i < numSamples; i++)
+						outputData[i] += readyData[i];
+				}
+
+				inputFrames.copyFrom(channel, partitionSize + position, input.GetConstChannelPtr(channel), numSamples);
+			}
+
+			position += numSamples;
+
+			if (position == partitionSize) {
+				position = 0;
+				long long index = blockIndex++;
+				if (delayBlocks == 0) {
+					StartBlock(index);
+					PerformWork(GetTotalWork());
+					SelectReady(index);
+				}
+				else {
+					// Without a worker the previous block is finished here, the blocks of a stage are always computed in order.
+					if (pool == nullptr)
+						PerformWork(GetTotalWork());
+					SelectReady(index - delayBlocks);
+					StartBlock(index);
+				}
+			}
+			else if (delayBlocks > 0 && pool == nullptr) {
+				// Keep the pending block work proportional to the samples received since it started.
+				PerformWork((int)(((long long)GetTotalWork() * position + partitionSize - 1) / partitionSize));
+			}
+		}
+
+		/** Perform the pending block work until targetWork steps are done, when there is no worker. */
+		void PerformWork(int targetWork) {
+			targetWork = juce::jmin(targetWork, GetTotalWork());
+			while (workDone < targetWork)
+				PerformStep(*pending, workDone++);
+		}
+
+		void Reset() {
+			CompleteBlocks();
+			inputFrames.clear();
+			// Every block starts as the silent, finished result of one of the blocks before the first.
+			for (int i = 0; i < (int)blocks.size(); i++) {
+				Block& block = *blocks[i];
+				block.frame.clear();
+				block.output.clear();
+				block.index = i - (long long)blocks.size();
+				block.numLost = 0;
+			}
+			std::fill(inputSpectra.begin(), inputSpectra.end(), ComplexType{});
+			position = 0;
+			blockIndex = 0;
+			numLost = 0;
+			ready = nullptr;
+			pending = nullptr;
+			workDone = GetTotalWork();
+		}
+	private:
+		/** The work of one input block, with the buffers it reads and writes while it may run on a worker. */
+		struct Block : public BackgroundJob {
+			Block(ConvolutionStage& stage) : stage{ stage } {}
+
+			void Run() override {
+				for (int step = 0; step < stage.GetTotalWork(); step++)
+					stage.PerformStep(*this, step);
+			}
+
+			ConvolutionStage& stage;
+			juce::AudioBuffer<sT> frame{};
+			juce::AudioBuffer<sT> output{};
+			long long index = 0;
+			int spectrumSlot = 0;
+			// Number of blocks lost just before this one, their spectra are silenced before they are read.
+			int numLost = 0;
+		};
+
+		inline Block& GetBlock(long long index) {
+			long long numBlocks = (long long)blocks.size();
+			return *blocks[(size_t)(((index % numBlocks) + numBlocks) % numBlocks)];
+		}
+
+		/** Wait for the workers to finish every block of the stage, never on the audio thread. */
+		void CompleteBlocks() {
+			for (auto& block : blocks)
+				block->Complete();
+		}
+
+		/** Play the result of the block index during the next block, or silence if it is not ready. */
+		void SelectReady(long long index) {
+			Block& block = GetBlock(index);
+			if (pool != nullptr && nonRealtime)
+				block.Complete();
+			if (block.IsIdle() && block.index == index) {
+				ready = &block.output;
+			}
+			else {
+				ready = nullptr;
+				lateBlocks.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * The input block index is complete, snapshot it and schedule its work. If the worker still holds the buffers
+		 * of the block, or its queue is full, the block is lost: its result will be late, and its spectrum is silenced
+		 * by the next block so the following ones do not convolve stale input.
+		 */
+		void StartBlock(long long index) {
+			Block& block = GetBlock(index);
+			if (pool != nullptr && nonRealtime)
+				block.Complete();
+			bool isFree = block.IsIdle();
+
+			for (int channel = 0; channel < numChannels; channel++) {
+				sT* frame = inputFrames.getWritePointer(channel);
+				if (isFree)
+					block.frame.copyFrom(channel, 0, frame, partitionSize * 2);
+				memcpy(frame, frame + partitionSize, sizeof(sT) * partitionSize);
+				memset(frame + partitionSize, 0, sizeof(sT) * partitionSize);
+			}
+			if (!isFree) {
+				numLost++;
+				return;
+			}
+
+			block.spectrumSlot = (int)(index % numPartitions);
+			block.numLost = juce::jmin(numLost, numPartitions);
+			if (pool == nullptr) {
+				pending = &block;
+				workDone = 0;
+			}
+			else if (!pool->Push(workerIndex, block)) {
+				if (!nonRealtime) {
+					numLost++;
+					return;
+				}
+				// Offline, the previous blocks are finished first so the blocks are still computed in order.
+				CompleteBlocks();
+				block.Run();
+			}
+			// The worker never reads the index, it is only compared by SelectReady on this thread.
+			block.index = index;
+			numLost = 0;
+		}
+
+		void PerformStep(Block& block, int step) {
+			int channel = step / (numPartitions + 2);
+			int stage = step % (numPartitions + 2);
+			ComplexType* accumulator = accumulators.data() + (size_t)channel * numBins;
+
+			if (stage == 0) {
+				for (int i = 1; i <= block.numLost; i++) {
+					ComplexType* lost = GetInputSpectrum(channel, (block.spectrumSlot + numPartitions - i) % numPartitions);
+					std::fill(lost, lost + numBins, ComplexType{});
+				}
+				fft->PerformRealForward(block.frame.getReadPointer(channel), GetInputSpectrum(channel, block.spectrumSlot));
+				std::fill(accumulator, accumulator + numBins, ComplexType{});
+			}
+			else if (stage <= numPartitions) {
+				int p = stage - 1;
+				int slot = (block.spectrumSlot + numPartitions - p) % numPartitions;
+				MultiplyAccumulate(GetInputSpectrum(channel, slot), irSpectra->GetSpectrum(channel, p), accumulator, numBins);
+			}
+			else {
+				fft->PerformRealInverse(accumulator, inverseFrame.data());
+				block.output.copyFrom(channel, 0, inverseFrame.data() + partitionSize, partitionSize);
+			}
+		}
+
+		static void MultiplyAccumulate(const ComplexType* __restrict a, const ComplexType* __restrict b, ComplexType* __restrict dst, int size) {
+			for (int i = 0; i < size; i++) {
+				sT re = a[i].real() * b[i].real() - a[i].imag() * b[i].imag();
+				sT im = a[i].real() * b[i].imag() + a[i].imag() * b[i].real();
+				dst[i] = ComplexType{ dst[i].real() + re, dst[i].imag() + im };
+			}
+		}
+
+		inline ComplexType* GetInputSpectrum(int channel, int slot) {
+			return inputSpectra.data() + ((size_t)channel * numPartitions + slot) * numBins;
+		}
+	private:
+		int numChannels = 1;
+		int irOffset = 0;
+		int partitionSize = 0;
+		int numPartitions = 0;
+		int numBins = 0;
+		int delayBlocks = 0;
+		WorkerPool* pool = nullptr;
+		int workerIndex = 0;
+		bool nonRealtime = false;
+		std::atomic<int> lateBlocks{ 0 };
+		int position = 0;
+		long long blockIndex = 0;
+		int numLost = 0;
+		const juce::AudioBuffer<sT>* ready = nullptr;
+		Block* pending = nullptr;
+		int workDone = 0;
+		std::shared_ptr<const FFT<sT>> fft{};
+		juce::AudioBuffer<sT> inputFrames{};
+		// The blocks are shared with the worker, owned through pointers so they never move.
+		std::vector<std::unique_ptr<Block>> blocks{};
+		std::shared_ptr<const IRSpectra<sT>> irSpectra{};
+		std::vector<ComplexType> inputSpectra{};
+		std::vector<ComplexType> accumulators{};
+		std::vector<sT> inverseFrame{};
+	};
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace Penny {
+	template<typename sT>
+	class FFT {
+	public:
+		using SampleType = sT;
+		using ComplexType = std::complex<sT>;
+	public:
+		FFT() {}
+		/** Construct a real FFT of size 2^order. */
+		explicit FFT(int order) { SetOrder(order); }
+
+		/** Set the FFT size to 2^order and precompute the tables, this allocate. */
+		void SetOrder(int order) {
+			jassert(order >= 1);
+			size = 1 << order;
+			halfSize = size / 2;
+
+			bitReverse.resize(halfSize);
+			int bits = order - 1;
+			for (int i = 0; i < halfSize; i++) {
+				int r = 0;
+				for (int b = 0; b < bits; b++)
+					r |= ((i >> b) & 1) << (bits - 1 - b);
+				bitReverse[i] = r;
+			}
+
+			twiddles.resize(juce::jmax(1, halfSize / 2));
+			for (int i = 0; i < (int)twiddles.size(); i++) {
+				double angle = -2.0 * juce::MathConstants<double>::pi * i / halfSize;
+				twiddles[i] = ComplexType{ (sT)std::cos(angle), (sT)std::sin(angle) };
+			}
+
+			realTwiddles.resize(halfSize + 1);
+			for (int i = 0; i <= halfSize; i++) {
+				double angle = -2.0 * juce::MathConstants<double>::pi * i / size;
+				realTwiddles[i] = ComplexType{ (sT)std::cos(angle), (sT)std::sin(angle) };
+			}
+		}
+
+		/** Get the FFT size in samples. */
+		inline int GetSize() const noexcept { return size; }
+		/** Get the number of bins produced by a real forward transform (size / 2 + 1). */
+		inline int GetNumBins() const noexcept { return halfSize + 1; }
+
+		/**
+		 * Real forward transform.
+		 *
+		 * \param input : size real samples.
+		 * \param output : GetNumBins() complex bins.
+		 */
+		void PerformRealForward(const sT* input, ComplexType* output) const {
+			for (int i = 0; i < halfSize; i++)
+				output[bitReverse[i]] = ComplexType{ input[2 * i], input[2 * i + 1] };
+
+			PerformInPlace(output, false);
+
+			ComplexType z0 = output[0];
+			output[0] = ComplexType{ z0.real() + z0.imag(), 0 };
+			output[halfSize] = ComplexType{ z0.real() - z0.imag(), 0 };
+
+			for (int k = 1; k <= halfSize / 2; k++) {
+				ComplexType zk = output[k];
+				ComplexType zmk = std::conj(output[halfSize - k]);
+				ComplexType even = (zk + zmk) * (sT)0.5;
+				ComplexType odd = (zk - zmk) * ComplexType{ 0, (sT)-0.5 };
+				output[k] = even + realTwiddles[k] * odd;
+				output[halfSize - k] = std::conj(even - realTwiddles[k] * odd);
+			}
+		}
+
+		/**
+		 * Real inverse transform, normalized so that inverse(forward(x)) == x.
+		 *
+		 * \param input : GetNumBins() complex bins, overwritten.
+		 * \param output : size real samples.
+		 */
+		void PerformRealInverse(ComplexType* input, sT* output) const {
+			ComplexType x0 = input[0];
+			ComplexType xm = input[halfSize];
+			input[0] = ComplexType{ (x0.real() + xm.real()) * (sT)0.5, (x0.real() - xm.real()) * (sT)0.5 };
+
+			for (int k = 1; k <= halfSize / 2; k++) {
+				ComplexType xk = input[k];
+				ComplexType xmk = std::conj(input[halfSize - k]);
+				ComplexType even = (xk + xmk) * (sT)0.5;
+				ComplexType odd = (xk - xmk) * std::conj(realTwiddles[k]) * (sT)0.5;
+				input[k] = even + ComplexType{ -odd.imag(), odd.real() };
+				input[halfSize - k] = std::conj(even - ComplexType{ -odd.imag(), odd.real() });
+			}
+
+			for (int i = 0; i < halfSize; i++) {
+				int r = bitReverse[i];
+				if (r > i)
+					std::swap(input[i], input[r]);
+			}
+
+			PerformInPlace(input, true);
+
+			sT scale = (sT)1 / halfSize;
+			for (int i = 0; i < halfSize; i++) {
+				output[2 * i] = input[i].real() * scale;
+				output[2 * i + 1] = input[i].imag() * scale;
+			}
+		}
+	private:
+		/** Iterative radix-2 butterflies, data must already be in bit reversed order. */
+		void PerformInPlace(ComplexType* data, bool inverse) const {
+			for (int length = 2; length <= halfSize; length <<= 1) {
+				int half = length / 2;
+				int step = halfSize / length;
+				for (int start = 0; start < halfSize; start += length) {
+					for (int j = 0; j < half; j++) {
+						ComplexType w = inverse ? std::conj(twiddles[j * step]) : twiddles[j * step];
+						ComplexType a = data[start + j];
+						ComplexType b = data[start + j + half] * w;
+						data[start + j] = a + b;
+						data[start + j + half] = a - b;
+					}
+				}
+			}
+		}
+	private:
+		int size = 0;
+		int halfSize = 0;
+		std::vector<int> bitReverse{};
+		std::vector<ComplexType> twiddles{};
+		std::vector<ComplexType> realTwiddles{};
+	};
+}
@@ -1,7 +1,187 @@
 #pragma once
 
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyMath/PennyFFT.h>
+#include <PennyDSP/PennyMath/PennyIRCache.h>
+
 namespace Penny {
-	class FFTConvolution {
-		//Not implemented
+	/**
+	 * Uniformly partitioned overlap-save convolution.
+	 * The impulse response is cut in partitions of partitionSize samples, each one convolved in the frequency domain
+	 * with a frequency domain delay line of the past input blocks. The current (maybe partial) block is transformed
+	 * on every call, so the convolution does not add any latency whatever the host block size is.
+	 * The impulse response spectra come from an IRCache, shared with the other convolutions of the same IR.
+	 */
+	template<typename sT>
+	class FFTConvolution : public BaseDSP<sT> {
+	public:
+		using SampleType = sT;
+		using ComplexType = std::complex<sT>;
+	public:
+		/** Construct a convolution with 1 channel and 512 samples partitions */
+		FFTConvolution() {}
+		/** Construct a convolution with specified number of channels and 512 samples partitions */
+		FFTConvolution(int numChannels) : numChannels{ numChannels } {}
+		/** Construct a convolution with specified number of channels and partition size (rounded up to a power of 2) */
+		FFTConvolution(int numChannels, int partitionSize) : numChannels{ numChannels }, partitionSize{ partitionSize } {}
+
+		/** Set the impulse response, it is copied and will be used on next Prepare. This allocate. */
+		void SetImpulseResponse(const AudioBufferView<sT>& ir) {
+			jassert(ir.GetNumChannels() > 0);
+			impulseResponse.setSize(ir.GetNumChannels(), ir.GetNumSamples());
+			for (int i = 0; i < ir.GetNumChannels(); i++)
+				impulseResponse.copyFrom(i, 0, ir.GetConstChannelPtr(i), ir.GetNumSamples());
+			irHash = HashImpulseResponse(impulseResponse);
+		}
+		/** Set the cache the spectra are shared through, IRCache::GetShared() by default, nullptr to compute them for this convolution only. Used on next Prepare. */
+		void SetIRCache(IRCache<sT>* cache) {
+			irCache = cache;
+		}
+		int GetImpulseResponseLength() {
+			return impulseResponse.getNumSamples();
+		}
+		int GetPartitionSize() {
+			return partitionSize;
+		}
+		int GetPartitionsNumber() {
+			return numPartitions;
+		}
+
+		/** Get (or compute) the impulse response spectra and allocate every buffer needed by Process. */
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			this->sampleRate = sampleRate;
+			this->samplesPerBlock = samplesPerBlock;
+
+			partitionSize = juce::nextPowerOfTwo(juce::jmax(1, partitionSize));
+			numPartitions = juce::jmax(1, (impulseResponse.getNumSamples() + partitionSize - 1) / partitionSize);
+			IRSpectraKey key{ irHash, 0, partitionSize, numPartitions, sampleRate };
+			irSpectra = irCache != nullptr ? irCache->GetSpectra(impulseResponse, key) : std::make_shared<const IRSpectra<sT>>(impulseResponse, key);
+			// The input is transformed with the FFT of the spectra, shared with the other users of the cache.
+			fft = irSpectra->GetSharedFFT();
+			numBins = fft->GetNumBins();
+
+			inputFrames.setSize(numChannels, partitionSize * 2);
+			outputFrame.resize(partitionSize * 2);
+			inputSpectra.assign((size_t)numChannels * numPartitions * numBins, ComplexType{});
+			tailSpectra.assign((size_t)numChannels * numBins, ComplexType{});
+			workSpectrum.assign(numBins, ComplexType{});
+
+			isReady = true;
+			Reset();
+		}
+
+		/** Convolve input with the impulse response into output, input and output can be the same. */
+		void Process(ProcessContext<sT>& ctx) {
+			if (!isReady)
+				return;
+
+			const AudioBufferView<sT>& input = ctx.GetInput();
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			jassert(input.GetNumChannels() >= numChannels && output.GetNumChannels() >= numChannels);
+			jassert(output.GetNumSamples() >= input.GetNumSamples());
+
+			int numSamples = input.GetNumSamples();
+			int startPosition = inputPosition;
+			int startSegment = currentSegment;
+
+			for (int channel = 0; channel < numChannels; channel++) {
+				inputPosition = startPosition;
+				currentSegment = startSegment;
+				ProcessChannel(channel, input.GetConstChannelPtr(channel), output.GetChannelPtr(channel), numSamples);
+			}
+		}
+
+		void Reset() {
+			if (!isReady)
+				return;
+
+			inputFrames.clear();
+			std::fill(inputSpectra.begin(), inputSpectra.end(), ComplexType{});
+			std::fill(tailSpectra.begin(), tailSpectra.end(), ComplexType{});
+			inputPosition = 0;
+			currentSegment = 0;
+		}
+	private:
+		void ProcessChannel(int channel, const sT* input, sT* output, int numSamples) {
+			sT* frame = inputFrames.getWritePointer(channel);
+			ComplexType* tail = tailSpectra.data() + (size_t)channel * numBins;
+
+			int processed = 0;
+			while (processed < numSamples) {
+				int length = juce::jmin(numSamples - processed, partitionSize - inputPosition);
+
+				// The frame is [previous block, current block], the not yet received part of the current block is zero.
+				memcpy(frame + partitionSize + inputPosition, input + processed, sizeof(sT) * length);
+
+				ComplexType* current = GetInputSpectrum(channel, currentSegment);
+				fft->PerformRealForward(frame, current);
+
+				// Contribution of the past blocks only change once per block, accumulate it once.
+				if (inputPosition == 0) {
+					std::fill(tail, tail + numBins, ComplexType{});
+					for (int p = 1; p < numPartitions; p++) {
+						int segment = (currentSegment + numPartitions - p) % numPartitions;
+						MultiplyAccumulate(GetInputSpectrum(channel, segment), irSpectra->GetSpectrum(channel, p), tail);
+					}
+				}
+
+				std::copy(tail, tail + numBins, workSpectrum.begin());
+				MultiplyAccumulate(current, irSpectra->GetSpectrum(channel, 0), workSpectrum.data());
+				fft->PerformRealInverse(workSpectrum.data(), outputFrame.data());
+
+				// Overlap-save, only the second half of the frame is valid.
+				memcpy(output + processed, outputFrame.data() + partitionSize + inputPosition, sizeof(sT) * length);
+
+				inputPosition += length;
+				processed += length;
+
+				if (inputPosition == partitionSize) {
+					memcpy(frame, frame + partitionSize, sizeof(sT) * partitionSize);
+					memset(frame + partitionSize, 0, sizeof(sT) * partitionSize);
+					inputPosition = 0;
+					currentSegment = (currentSegment + 1) % numPartitions;
+				}
+			}
+		}
+
+		static void MultiplyAccumulate(const ComplexType* __restrict a, const ComplexType* __restrict b, ComplexType* __restrict dst, int size) {
+			for (int i = 0; i < size; i++) {
+				sT re = a[i].real() * b[i].real() - a[i].imag() * b[i].imag();
+				sT im = a[i].real() * b[i].imag() + a[i].imag() * b[i].real();
+				dst[i] = ComplexType{ dst[i].real() + re, dst[i].imag() + im };
+			}
+		}
+		void MultiplyAccumulate(const ComplexType* a, const ComplexType* b, ComplexType* dst) const {
+			MultiplyAccumulate(a, b, dst, numBins);
+		}
+
+		inline ComplexType* GetInputSpectrum(int channel, int segment) {
+			return inputSpectra.data() + ((size_t)channel * numPartitions + segment) * numBins;
+		}
+	private:
+		bool isReady = false;
+		int numChannels = 1;
+		int partitionSize = 512;
+		int numPartitions = 1;
+		int numBins = 0;
+		int sampleRate, samplesPerBlock;
+		int inputPosition = 0;
+		int currentSegment = 0;
+		std::shared_ptr<const FFT<sT>> fft{};
+		juce::AudioBuffer<sT> impulseResponse{};
+		uint64_t irHash = HashImpulseResponse(juce::AudioBuffer<sT>{});
+		IRCache<sT>* irCache = &IRCache<sT>::GetShared();
+		std::shared_ptr<const IRSpectra<sT>> irSpectra{};
+		juce::AudioBuffer<sT> inputFrames{};
+		std::vector<sT> outputFrame{};
+		std::vector<ComplexType> inputSpectra{};
+		std::vector<ComplexType> tailSpectra{};
+		std::vector<ComplexType> workSpectrum{};
 	};
 }
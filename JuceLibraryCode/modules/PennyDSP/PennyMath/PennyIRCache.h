@@ -0,0 +1,335 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyMath/PennyFFT.h>
+#include <PennyDSP/PennyThreading/PennyRealtimeCheck.h>
+
+namespace Penny {
+	/** What identifies the partition spectra of an impulse response segment, see IRCache. */
+	struct IRSpectraKey {
+		/** HashImpulseResponse of the whole IR. */
+		uint64_t irHash = 0;
+		/** First sample of the segment in the IR. */
+		int irOffset = 0;
+		int partitionSize = 0;
+		int numPartitions = 0;
+		int sampleRate = 0;
+
+		bool operator<(const IRSpectraKey& other) const noexcept {
+			return std::tie(irHash, irOffset, partitionSize, numPartitions, sampleRate)
+				< std::tie(other.irHash, other.irOffset, other.partitionSize, other.numPartitions, other.sampleRate);
+		}
+	};
+
+	/** Hash of the size and the samples of an impulse response, 8 bytes at a time. */
+	template<typename sT>
+	uint64_t HashImpulseResponse(const juce::AudioBuffer<sT>& ir) {
+		const uint64_t prime = 0x100000001b3ull;
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto mix = [&](uint64_t value) { hash = (hash ^ value) * prime; };
+
+		mix((uint64_t)ir.getNumChannels());
+		mix((uint64_t)ir.getNumSamples());
+		mix((uint64_t)sizeof(sT));
+		for (int channel = 0; channel < ir.getNumChannels(); channel++) {
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(ir.getReadPointer(channel));
+			size_t size = sizeof(sT) * (size_t)ir.getNumSamples();
+			size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				uint64_t word;
+				memcpy(&word, bytes + i, 8);
+				mix(word);
+			}
+			for (; i < size; i++)
+				mix(bytes[i]);
+		}
+
+		// Final avalanche (splitmix64), the low bits of a FNV hash of whole words are weak.
+		hash ^= hash >> 30;
+		hash *= 0xbf58476d1ce4e5b9ull;
+		hash ^= hash >> 27;
+		hash *= 0x94d049bb133111ebull;
+		hash ^= hash >> 31;
+		return hash;
+	}
+
+	/** Order of the FFT of a partitioned convolution, 2 * partitionSize samples. */
+	inline int GetPartitionFFTOrder(int partitionSize) {
+		int order = 1;
+		while ((1 << order) < partitionSize * 2)
+			order++;
+		return order;
+	}
+
+	/**
+	 * The spectra of the numPartitions partitions of an impulse response segment, for every channel of the IR,
+	 * with the FFT they were computed with. The convolutions transform their input with the same one.
+	 * Read only once built, one IRSpectra is shared by every convolution of the same segment.
+	 * The spectra are either computed or read from a memory mapped IRCache file.
+	 */
+	template<typename sT>
+	class IRSpectra {
+	public:
+		using SampleType = sT;
+		using ComplexType = std::complex<sT>;
+	public:
+		/** Compute the spectra of the segment of ir described by key, past the end of ir is zero. This allocate. */
+		IRSpectra(const juce::AudioBuffer<sT>& ir, const IRSpectraKey& key) :
+			IRSpectra(ir, key, std::make_shared<const FFT<sT>>(GetPartitionFFTOrder(key.partitionSize))) {}
+		/** Same as above, with the FFT of order GetPartitionFFTOrder(key.partitionSize) shared with other spectra. */
+		IRSpectra(const juce::AudioBuffer<sT>& ir, const IRSpectraKey& key, std::shared_ptr<const FFT<sT>> fft) :
+			key{ key }, numChannels{ juce::jmax(1, ir.getNumChannels()) }, fft{ std::move(fft) } {
+			jassert(juce::isPowerOfTwo(key.partitionSize) && key.numPartitions > 0);
+			jassert(this->fft->GetSize() == key.partitionSize * 2);
+			numBins = this->fft->GetNumBins();
+
+			spectra.assign(GetDataSize(), ComplexType{});
+			std::vector<sT> frame((size_t)key.partitionSize * 2, (sT)0);
+			for (int channel = 0; channel < ir.getNumChannels(); channel++) {
+				const sT* irData = ir.getReadPointer(channel);
+				for (int p = 0; p < key.numPartitions; p++) {
+					int offset = key.irOffset + p * key.partitionSize;
+					int length = juce::jmax(0, juce::jmin(key.partitionSize, ir.getNumSamples() - offset));
+					std::fill(frame.begin(), frame.end(), (sT)0);
+					if (length > 0)
+						memcpy(frame.data(), irData + offset, sizeof(sT) * length);
+					this->fft->PerformRealForward(frame.data(), spectra.data() + ((size_t)channel * key.numPartitions + p) * numBins);
+				}
+			}
+			data = spectra.data();
+		}
+		/** Use the spectra stored in a mapped file at dataOffset, checked by IRCache. */
+		IRSpectra(const IRSpectraKey& key, int numChannels, std::unique_ptr<juce::MemoryMappedFile> file, size_t dataOffset,
+			std::shared_ptr<const FFT<sT>> fft) :
+			key{ key }, numChannels{ numChannels }, numBins{ key.partitionSize + 1 }, fft{ std::move(fft) }, file{ std::move(file) } {
+			data = reinterpret_cast<const ComplexType*>(static_cast<const char*>(this->file->getData()) + dataOffset);
+		}
+		IRSpectra(const IRSpectra&) = delete;
+		IRSpectra& operator=(const IRSpectra&) = delete;
+
+		const IRSpectraKey& GetKey() const noexcept { return key; }
+		int GetChannelsNumber() const noexcept { return numChannels; }
+		int GetPartitionSize() const noexcept { return key.partitionSize; }
+		int GetPartitionsNumber() const noexcept { return key.numPartitions; }
+		int GetNumBins() const noexcept { return numBins; }
+		/** The FFT of 2 * partitionSize samples the spectra were computed with. */
+		const FFT<sT>& GetFFT() const noexcept { return *fft; }
+		std::shared_ptr<const FFT<sT>> GetSharedFFT() const noexcept { return fft; }
+		/** True if the spectra are read from a memory mapped file. */
+		bool IsMapped() const noexcept { return file != nullptr; }
+
+		/** Spectrum of a partition, the channels past the last one of the IR reuse it. */
+		inline const ComplexType* GetSpectrum(int channel, int partition) const noexcept {
+			channel = juce::jmin(channel, numChannels - 1);
+			return data + ((size_t)channel * key.numPartitions + partition) * numBins;
+		}
+		/** Every spectrum, channel after channel and partition after partition. */
+		const ComplexType* GetData() const noexcept { return data; }
+		/** Number of complex bins of GetData. */
+		size_t GetDataSize() const noexcept {
+			return (size_t)numChannels * key.numPartitions * numBins;
+		}
+	private:
+		IRSpectraKey key;
+		int numChannels = 1;
+		int numBins = 0;
+		std::shared_ptr<const FFT<sT>> fft;
+		const ComplexType* data = nullptr;
+		std::vector<ComplexType> spectra{};
+		std::unique_ptr<juce::MemoryMappedFile> file{};
+	};
+
+	/**
+	 * Cache of the impulse response spectra of the partitioned convolutions.
+	 * Convolutions of the same IR segment (same samples, offset, partitions and sample rate) share one read only IRSpectra,
+	 * computed by the first one to be prepared and freed with the last one. With a directory, the spectra are also stored
+	 * in versioned binary files, that the next processes memory map instead of computing the spectra again.
+	 * The FFT tables, as costly to compute as the spectra of a short IR, are shared the same way for each partition size.
+	 * Thread safe, not for the audio thread. GetShared is the cache of the process, the convolutions use it by default.
+	 */
+	template<typename sT>
+	class IRCache {
+	public:
+		using SampleType = sT;
+		/** Bump it when the file layout or the spectra change, the files of another version are computed again. */
+		static constexpr uint32_t fileVersion = 1;
+
+		/** How the lookups were served, from the spectra already shared, from a file or by computing them. */
+		struct Stats {
+			int64_t memoryHits = 0, fileHits = 0, computed = 0;
+		};
+	public:
+		IRCache() {}
+		IRCache(const IRCache&) = delete;
+		IRCache& operator=(const IRCache&) = delete;
+
+		/** The cache shared by every convolution of the process. */
+		static IRCache& GetShared() {
+			static IRCache cache{};
+			return cache;
+		}
+
+		/** Store the spectra files in directory, created if needed. The default empty File keeps the spectra in memory only. */
+		void SetDirectory(const juce::File& directory) {
+			std::lock_guard<std::mutex> lock{ mutex };
+			this->directory = directory;
+		}
+		juce::File GetDirectory() {
+			std::lock_guard<std::mutex> lock{ mutex };
+			return directory;
+		}
+
+		/**
+		 * The spectra of the segment of ir described by key, shared with every other user of key.
+		 * Found in memory, mapped from the directory, or computed (and stored in the directory). This allocate.
+		 */
+		std::shared_ptr<const IRSpectra<sT>> GetSpectra(const juce::AudioBuffer<sT>& ir, const IRSpectraKey& key) {
+			PENNY_ASSERT_NOT_REALTIME();
+			std::lock_guard<std::mutex> lock{ mutex };
+
+			auto entry = entries.find(key);
+			if (entry != entries.end()) {
+				if (std::shared_ptr<const IRSpectra<sT>> spectra = entry->second.lock()) {
+					stats.memoryHits++;
+					return spectra;
+				}
+			}
+
+			std::shared_ptr<const IRSpectra<sT>> spectra = LoadFile(key);
+			if (spectra != nullptr) {
+				stats.fileHits++;
+			}
+			else {
+				auto computed = std::make_shared<IRSpectra<sT>>(ir, key, GetFFT(key.partitionSize));
+				SaveFile(*computed);
+				spectra = computed;
+				stats.computed++;
+			}
+
+			// Forget the spectra nobody holds anymore.
+			for (auto it = entries.begin(); it != entries.end();)
+				it = it->second.expired() ? entries.erase(it) : std::next(it);
+			entries[key] = spectra;
+			return spectra;
+		}
+
+		/** Number of spectra held by at least one convolution. */
+		int GetEntriesNumber() {
+			std::lock_guard<std::mutex> lock{ mutex };
+			int count = 0;
+			for (auto& entry : entries)
+				count += entry.second.expired() ? 0 : 1;
+			return count;
+		}
+		Stats GetStats() {
+			std::lock_guard<std::mutex> lock{ mutex };
+			return stats;
+		}
+	private:
+		/** Native byte order and sample type, a file written by another kind of machine is computed again. */
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t byteOrder;
+			uint32_t sampleSize;
+			int32_t numChannels;
+			uint64_t irHash;
+			int32_t irOffset, partitionSize, numPartitions, sampleRate, numBins;
+			// The spectra start 64 bytes in, aligned for the SIMD loads.
+			char padding[12];
+		};
+		static_assert(sizeof(FileHeader) == 64, "The spectra must start 64 bytes in the file.");
+
+		static constexpr uint32_t byteOrderMark = 0x01020304;
+
+		/** The 8 first bytes of a file, the terminating zero included. */
+		static const char* GetFileMagic() noexcept {
+			return "PENNYIR";
+		}
+
+		/** The FFT of a partition size, computed once and kept as long as the cache. */
+		std::shared_ptr<const FFT<sT>> GetFFT(int partitionSize) {
+			int order = GetPartitionFFTOrder(partitionSize);
+			std::shared_ptr<const FFT<sT>>& fft = ffts[order];
+			if (fft == nullptr)
+				fft = std::make_shared<const FFT<sT>>(order);
+			return fft;
+		}
+
+		juce::File GetFile(const IRSpectraKey& key) const {
+			char name[128];
+			std::snprintf(name, sizeof(name), "%016llx_%d_%dx%d_%d_%s.pennyir", (unsigned long long)key.irHash, key.irOffset,
+				key.partitionSize, key.numPartitions, key.sampleRate, sizeof(sT) == sizeof(float) ? "f32" : "f64");
+			return directory.getChildFile(name);
+		}
+
+		std::shared_ptr<const IRSpectra<sT>> LoadFile(const IRSpectraKey& key) {
+			if (directory == juce::File{})
+				return nullptr;
+			juce::File file = GetFile(key);
+			if (!file.existsAsFile())
+				return nullptr;
+
+			auto mapped = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+			if (mapped->getData() == nullptr || mapped->getSize() < sizeof(FileHeader))
+				return nullptr;
+			FileHeader header;
+			memcpy(&header, mapped->getData(), sizeof(FileHeader));
+
+			bool isValid = memcmp(header.magic, GetFileMagic(), sizeof(header.magic)) == 0 && header.version == fileVersion
+				&& header.byteOrder == byteOrderMark && header.sampleSize == sizeof(sT)
+				&& header.irHash == key.irHash && header.irOffset == key.irOffset && header.partitionSize == key.partitionSize
+				&& header.numPartitions == key.numPartitions && header.sampleRate == key.sampleRate
+				&& header.numBins == key.partitionSize + 1 && header.numChannels > 0
+				&& mapped->getSize() == sizeof(FileHeader) + sizeof(std::complex<sT>) * (size_t)header.numChannels * header.numPartitions * header.numBins;
+			if (!isValid)
+				return nullptr;
+			return std::make_shared<IRSpectra<sT>>(key, (int)header.numChannels, std::move(mapped), sizeof(FileHeader), GetFFT(key.partitionSize));
+		}
+
+		/** Write the spectra next to their file and rename it into place, another process never maps a partial file. */
+		void SaveFile(const IRSpectra<sT>& spectra) {
+			if (directory == juce::File{} || !directory.createDirectory().wasOk())
+				return;
+
+			const IRSpectraKey& key = spectra.GetKey();
+			FileHeader header{};
+			memcpy(header.magic, GetFileMagic(), sizeof(header.magic));
+			header.version = fileVersion;
+			header.byteOrder = byteOrderMark;
+			header.sampleSize = sizeof(sT);
+			header.numChannels = spectra.GetChannelsNumber();
+			header.irHash = key.irHash;
+			header.irOffset = key.irOffset;
+			header.partitionSize = key.partitionSize;
+			header.numPartitions = key.numPartitions;
+			header.sampleRate = key.sampleRate;
+			header.numBins = spectra.GetNumBins();
+
+			juce::TemporaryFile temporary{ GetFile(key) };
+			{
+				juce::FileOutputStream stream{ temporary.getFile() };
+				if (!stream.openedOk() || !stream.write(&header, sizeof(FileHeader))
+					|| !stream.write(spectra.GetData(), sizeof(std::complex<sT>) * spectra.GetDataSize()))
+					return;
+			}
+			temporary.overwriteTargetFileWithTemporary();
+		}
+	private:
+		std::mutex mutex{};
+		juce::File directory{};
+		std::map<IRSpectraKey, std::weak_ptr<const IRSpectra<sT>>> entries{};
+		std::map<int, std::shared_ptr<const FFT<sT>>> ffts{};
+		Stats stats{};
+	};
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+
+namespace Penny {
+	/**
+	 * Unitary mixing matrices of a feedback delay network, applied to N rows of numSamples samples.
+	 * The rows are processed whole by the SIMD kernels. Apply computes the matrix times GetScale<N>(),
+	 * the caller folds the normalization into its own per row gains.
+	 */
+
+	/** Householder reflection I - 2/N * 1 * 1^T, O(N), every line feeds every other one with the same gain. */
+	struct HouseholderMatrix {
+		template<int N>
+		static double GetScale() { return 1.0; }
+
+		/** scratch holds numSamples samples. */
+		template<typename sT, int N>
+		static void Apply(sT* const* rows, sT* scratch, int numSamples) {
+			memcpy(scratch, rows[0], sizeof(sT) * numSamples);
+			for (int i = 1; i < N; i++)
+				AudioBufferView_Impl<sT>::Add(scratch, rows[i], numSamples);
+			for (int i = 0; i < N; i++)
+				AudioBufferView_Impl<sT>::MulAdd(rows[i], scratch, (sT)(-2.0 / N), numSamples);
+		}
+	};
+
+	/** Hadamard matrix with the fast Walsh-Hadamard transform, O(N log N), N must be a power of two. */
+	struct HadamardMatrix {
+		template<int N>
+		static double GetScale() { return 1.0 / std::sqrt((double)N); }
+
+		template<typename sT, int N>
+		static void Apply(sT* const* rows, sT*, int numSamples) {
+			static_assert(N > 0 && (N & (N - 1)) == 0, "The Hadamard matrix size must be a power of two.");
+			for (int half = 1; half < N; half *= 2)
+				for (int i = 0; i < N; i += half * 2)
+					for (int j = i; j < i + half; j++)
+						AudioBufferView_Impl<sT>::Butterfly(rows[j], rows[j + half], numSamples);
+		}
+	};
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyContainers/PennyAudioBufferView.h>
+#include <PennyDSP/PennyBasicDSPComponent/PennyBaseDSP.h>
+#include <PennyDSP/PennyMath/PennyConvolution.h>
+#include <PennyDSP/PennyMath/PennyConvolutionStage.h>
+#include <PennyDSP/PennyMath/PennyIRCache.h>
+#include <PennyDSP/PennyThreading/PennyWorkerPool.h>
+
+namespace Penny {
+	/**
+	 * Zero latency non uniformly partitioned convolution (Gardner).
+	 * The first headSize samples of the impulse response are convolved in direct form, the rest of the IR is cut
+	 * in stages of growing partition size (headSize, 2 * headSize, 4 * headSize... up to maxPartitionSize).
+	 * Each stage starts in the IR at twice its partition size, so the work of a block can be spread over the next one,
+	 * and the CPU usage per callback stays flat instead of spiking every time a large partition is complete.
+	 * The stages of at least the background partition size start at three times their partition size instead,
+	 * their blocks then have two whole blocks to be computed. With background threads they are computed by a worker pool
+	 * owned by the convolution, and the audio thread never waits for them. The layout does not depend on the number of
+	 * threads, so the output is bit identical to the single threaded path as long as no block is late (see GetLateBlocks).
+	 * The spectra of every stage come from an IRCache, shared with the other convolutions of the same IR.
+	 */
+	template<typename sT>
+	class NonUniformConvolution : public BaseDSP<sT> {
+	public:
+		using SampleType = sT;
+	public:
+		/** Construct a convolution with 1 channel, a 128 samples head and 8192 samples max partition */
+		NonUniformConvolution() {}
+		/** Construct a convolution with specified number of channels, a 128 samples head and 8192 samples max partition */
+		NonUniformConvolution(int numChannels) : numChannels{ numChannels } {}
+		/** Construct a convolution with specified number of channels, head size and max partition size (rounded up to a power of 2) */
+		NonUniformConvolution(int numChannels, int headSize, int maxPartitionSize) :
+			numChannels{ numChannels }, headSize{ headSize }, maxPartitionSize{ maxPartitionSize } {}
+
+		/** Set the impulse response, it is copied and will be used on next Prepare. This allocate. */
+		void SetImpulseResponse(const AudioBufferView<sT>& ir) {
+			jassert(ir.GetNumChannels() > 0);
+			impulseResponse.setSize(ir.GetNumChannels(), ir.GetNumSamples());
+			for (int i = 0; i < ir.GetNumChannels(); i++)
+				impulseResponse.copyFrom(i, 0, ir.GetConstChannelPtr(i), ir.GetNumSamples());
+			irHash = HashImpulseResponse(impulseResponse);
+		}
+		/** Set the cache the spectra are shared through, IRCache::GetShared() by default, nullptr to compute them for this convolution only. Used on next Prepare. */
+		void SetIRCache(IRCache<sT>* cache) {
+			irCache = cache;
+		}
+		int GetImpulseResponseLength() {
+			return impulseResponse.getNumSamples();
+		}
+		/**
+		 * Compute the stages with a partition size of at least minPartitionSize on numThreads background threads.
+		 * Used on next Prepare, 0 thread to process everything on the audio thread (with the same stage layout).
+		 */
+		void SetBackgroundThreads(int numThreads, int minPartitionSize = 2048) {
+			jassert(numThreads >= 0);
+			this->numThreads = numThreads;
+			this->minBackgroundPartitionSize = minPartitionSize;
+		}
+		int GetBackgroundThreads() {
+			return numThreads;
+		}
+		/**
+		 * When rendering offline, wait for the late workers instead of playing their blocks as silence,
+		 * the output is then always bit identical to the single threaded path. Used on next Prepare.
+		 */
+		void SetNonRealtime(bool nonRealtime) {
+			this->nonRealtime = nonRealtime;
+		}
+		/** Number of stage blocks played as silence because a worker was late, since Prepare. Can be read while processing, not during Prepare. */
+		int GetLateBlocks() const {
+			int lateBlocks = 0;
+			for (auto& stage : stages)
+				lateBlocks += stage->GetLateBlocks();
+			return lateBlocks;
+		}
+		int GetHeadSize() {
+			return headSize;
+		}
+		int GetStagesNumber() {
+			return (int)stages.size();
+		}
+		const ConvolutionStage<sT>& GetStage(int index) const {
+			return *stages[index];
+		}
+
+		/** Build the partition layout, get (or compute) every spectra and allocate every buffer needed by Process. */
+		void Prepare(int sampleRate, int samplesPerBlock) {
+			this->sampleRate = sampleRate;
+			this->samplesPerBlock = samplesPerBlock;
+
+			headSize = juce::nextPowerOfTwo(juce::jmax(16, headSize));
+			maxPartitionSize = juce::nextPowerOfTwo(juce::jmax(headSize, maxPartitionSize));
+
+			int irLength = impulseResponse.getNumSamples();
+			int irNumChannels = impulseResponse.getNumChannels();
+
+			headImpulseResponse.setSize(numChannels, headSize);
+			headImpulseResponse.clear();
+			for (int channel = 0; channel < numChannels && irNumChannels > 0; channel++)
+				headImpulseResponse.copyFrom(channel, 0, impulseResponse.getReadPointer(juce::jmin(channel, irNumChannels - 1)),
+					juce::jmin(headSize, irLength));
+
+			// Workers may still hold the previous stages, stop them first.
+			workerPool.reset();
+			stages.clear();
+			int offset = headSize;
+			int partitionSize = headSize;
+			while (offset < irLength) {
+				// The next (twice bigger) stage has to start at its latency, four or six times this partition size.
+				int delayBlocks = GetDelayBlocks(partitionSize);
+				int numPartitions;
+				if (partitionSize < maxPartitionSize) {
+					int nextPartitionSize = partitionSize * 2;
+					numPartitions = (nextPartitionSize * (GetDelayBlocks(nextPartitionSize) + 1) - offset) / partitionSize;
+				}
+				else
+					numPartitions = (irLength - offset + partitionSize - 1) / partitionSize;
+				numPartitions = juce::jmin(numPartitions, (irLength - offset + partitionSize - 1) / partitionSize);
+
+				IRSpectraKey key{ irHash, offset, partitionSize, numPartitions, sampleRate };
+				stages.push_back(std::make_unique<ConvolutionStage<sT>>());
+				stages.back()->Prepare(numChannels, irCache != nullptr ? irCache->GetSpectra(impulseResponse, key)
+					: std::make_shared<const IRSpectra<sT>>(impulseResponse, key), delayBlocks);
+				stages.back()->SetNonRealtime(nonRealtime);
+
+				offset += numPartitions * partitionSize;
+				partitionSize = juce::jmin(partitionSize * 2, maxPartitionSize);
+			}
+
+			if (numThreads > 0) {
+				int workerIndex = 0;
+				for (auto& stage : stages) {
+					if (stage->GetDelayBlocks() < 2)
+						continue;
+					if (workerPool == nullptr)
+						workerPool = std::make_unique<WorkerPool>(numThreads);
+					stage->SetWorker(workerPool.get(), workerIndex++);
+				}
+			}
+
+			inputChunk.setSize(numChannels, headSize);
+			outputChunk.setSize(numChannels, headSize);
+			headBuffer.setSize(numChannels, headSize * 2 - 1);
+			headOverlap.setSize(numChannels, headSize - 1);
+
+			isReady = true;
+			Reset();
+		}
+
+		/** Convolve input with the impulse response into output, input and output can be the same. */
+		void Process(ProcessContext<sT>& ctx) {
+			if (!isReady)
+				return;
+
+			const AudioBufferView<sT>& input = ctx.GetInput();
+			AudioBufferView<sT>& output = ctx.GetOutput();
+			jassert(input.GetNumChannels() >= numChannels && output.GetNumChannels() >= numChannels);
+			jassert(output.GetNumSamples() >= input.GetNumSamples());
+
+			int numSamples = input.GetNumSamples();
+			int processed = 0;
+			while (processed < numSamples) {
+				// Every partition size is a multiple of the head size, so a chunk never crosses any stage block.
+				int length = juce::jmin(numSamples - processed, headSize - headPosition);
+
+				for (int channel = 0; channel < numChannels; channel++)
+					inputChunk.copyFrom(channel, 0, input.GetConstChannelPtr(channel) + processed, length);
+
+				AudioBufferView<sT> inputView{ inputChunk, 0, length };
+				AudioBufferView<sT> outputView{ outputChunk, 0, length };
+
+				ProcessHead(inputView, outputView);
+
+				for (auto& stage : stages)
+					stage->Process(inputView, outputView);
+
+				for (int channel = 0; channel < numChannels; channel++)
+					memcpy(output.GetChannelPtr(channel) + processed, outputView.GetConstChannelPtr(channel), sizeof(sT) * length);
+
+				headPosition = (headPosition + length) % headSize;
+				processed += length;
+			}
+		}
+
+		void Reset() {
+			if (!isReady)
+				return;
+
+			for (auto& stage : stages)
+				stage->Reset();
+			headOverlap.clear();
+			headPosition = 0;
+		}
+	private:
+		/** The head stage is done at once, the others are spread over the next block, with one more block for the background ones. */
+		int GetDelayBlocks(int partitionSize) const {
+			if (partitionSize == headSize)
+				return 0;
+			return partitionSize >= minBackgroundPartitionSize ? 2 : 1;
+		}
+
+		/** Direct form convolution of the IR head, overlap-added with the previous chunks. */
+		void ProcessHead(const AudioBufferView<sT>& input, AudioBufferView<sT>& output) {
+			int length = input.GetNumSamples();
+			int overlapLength = headSize - 1;
+
+			AudioBufferView<sT> headView{ headBuffer, 0, length + overlapLength };
+			AudioBufferView<sT> headIRView{ headImpulseResponse };
+			for (int channel = 0; channel < numChannels; channel++)
+				headBuffer.clear(channel, 0, length + overlapLength);
+
+			Convolution<sT>::Convolve(input, headIRView, headView);
+
+			for (int channel = 0; channel < numChannels; channel++) {
+				sT* headData = headBuffer.getWritePointer(channel);
+				sT* overlapData = headOverlap.getWritePointer(channel);
+				for (int i = 0; i < overlapLength; i++)
+					headData[i] += overlapData[i];
+
+				memcpy(output.GetChannelPtr(channel), headData, sizeof(sT) * length);
+				memcpy(overlapData, headData + length, sizeof(sT) * overlapLength);
+			}
+		}
+	private:
+		bool isReady = false;
+		int numChannels = 1;
+		int headSize = 128;
+		int maxPartitionSize = 8192;
+		int sampleRate, samplesPerBlock;
+		int headPosition = 0;
+		int numThreads = 0;
+		int minBackgroundPartitionSize = 2048;
+		bool nonRealtime = false;
+		std::vector<std::unique_ptr<ConvolutionStage<sT>>> stages{};
+		juce::AudioBuffer<sT> impulseResponse{};
+		uint64_t irHash = HashImpulseResponse(juce::AudioBuffer<sT>{});
+		IRCache<sT>* irCache = &IRCache<sT>::GetShared();
+		juce::AudioBuffer<sT> headImpulseResponse{};
+		juce::AudioBuffer<sT> inputChunk{};
+		juce::AudioBuffer<sT> outputChunk{};
+		juce::AudioBuffer<sT> headBuffer{};
+		juce::AudioBuffer<sT> headOverlap{};
+		// Declared last so the workers are stopped before the stages are destroyed.
+		std::unique_ptr<WorkerPool> workerPool{};
+	};
+}
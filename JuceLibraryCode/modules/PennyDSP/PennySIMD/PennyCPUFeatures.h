@@ -0,0 +1,87 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define PENNY_SIMD_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#else
+	#define PENNY_SIMD_X86 0
+#endif
+
+/** Enable an instruction set for one function, MSVC does not need it to use the intrinsics. */
+#if PENNY_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+	#define PENNY_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define PENNY_TARGET(isa)
+#endif
+
+namespace Penny {
+	enum class SIMDLevel {
+		Scalar = 0,
+		SSE2,
+		AVX2,
+		AVX512
+	};
+
+	/** Detect the best instruction set supported by both the CPU and the OS. */
+	inline SIMDLevel DetectSIMDLevel() {
+#if PENNY_SIMD_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		bool avx2 = false, avx512f = false;
+		if (maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512f = (info[1] & (1 << 16)) != 0;
+		}
+
+		// The OS must save the ymm (and zmm) registers on context switch.
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool osAVX = (xcr0 & 0x6) == 0x6;
+		bool osAVX512 = (xcr0 & 0xe6) == 0xe6;
+
+		if (avx && avx2 && fma && osAVX && avx512f && osAVX512)
+			return SIMDLevel::AVX512;
+		if (avx && avx2 && fma && osAVX)
+			return SIMDLevel::AVX2;
+		if (sse2)
+			return SIMDLevel::SSE2;
+	#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return SIMDLevel::AVX512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return SIMDLevel::AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return SIMDLevel::SSE2;
+	#endif
+#endif
+		return SIMDLevel::Scalar;
+	}
+
+	/** Best instruction set of this machine, detected once. */
+	inline SIMDLevel GetSupportedSIMDLevel() {
+		static const SIMDLevel level = DetectSIMDLevel();
+		return level;
+	}
+
+	inline const char* GetSIMDLevelName(SIMDLevel level) {
+		switch (level) {
+		case SIMDLevel::SSE2: return "SSE2";
+		case SIMDLevel::AVX2: return "AVX2";
+		case SIMDLevel::AVX512: return "AVX512";
+		default: return "Scalar";
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include <PennyDSP/PennySIMD/PennyCPUFeatures.h>
+
+namespace Penny {
+	/** How a component keeps its feedback loops from decaying through denormals, which are up to 100 times slower to compute. */
+	enum class DenormalProtection {
+		/** Nothing, the caller sets the floating point mode. */
+		None = 0,
+		/** Flush denormals to zero with the CPU mode for the duration of Process, the default. */
+		FlushToZero,
+		/**
+		 * Add denormalNoiseFloor to the feedback, with a sign alternating every block so that it does not build up.
+		 * The loops never decay under it, whatever the CPU mode, for the platforms where it can't be set.
+		 */
+		NoiseFloor
+	};
+
+	/** Offset of DenormalProtection::NoiseFloor, -360dB, far above the denormals of float and under the rounding of any signal. */
+	constexpr double denormalNoiseFloor = 1e-18;
+
+	/**
+	 * Flush denormals to zero until the end of the scope, FTZ and DAZ on x86, FZ on AArch64, nothing elsewhere.
+	 * The previous mode is restored on destruction. It is only written when it changes, a scope nested in another one
+	 * only reads it. The mode belongs to the thread, construct it on the thread that processes.
+	 */
+	class ScopedFlushDenormals {
+	public:
+		ScopedFlushDenormals(bool enabled = true) noexcept {
+			if (!enabled)
+				return;
+			previousMode = ReadMode();
+			if ((previousMode & flushBits) != flushBits) {
+				WriteMode(previousMode | flushBits);
+				isWritten = true;
+			}
+		}
+		~ScopedFlushDenormals() noexcept {
+			if (isWritten)
+				WriteMode(previousMode);
+		}
+		ScopedFlushDenormals(const ScopedFlushDenormals&) = delete;
+		ScopedFlushDenormals& operator=(const ScopedFlushDenormals&) = delete;
+
+		/** True if denormals are flushed to zero on this thread, always false where the mode can't be set. */
+		static bool IsFlushing() noexcept {
+			return flushBits != 0 && (ReadMode() & flushBits) == flushBits;
+		}
+	private:
+#if PENNY_SIMD_X86
+		using ModeType = uint32_t;
+		// FTZ (bit 15) and DAZ (bit 6) of MXCSR.
+		static constexpr ModeType flushBits = 0x8040;
+
+		static ModeType ReadMode() noexcept { return (ModeType)_mm_getcsr(); }
+		static void WriteMode(ModeType mode) noexcept { _mm_setcsr(mode); }
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+		using ModeType = uint64_t;
+		// FZ (bit 24) of FPCR, it flushes both the inputs and the results.
+		static constexpr ModeType flushBits = (ModeType)1 << 24;
+
+		static ModeType ReadMode() noexcept {
+			ModeType mode;
+			asm volatile("mrs %0, fpcr" : "=r"(mode));
+			return mode;
+		}
+		static void WriteMode(ModeType mode) noexcept { asm volatile("msr fpcr, %0" : : "r"(mode)); }
+#else
+		using ModeType = uint32_t;
+		static constexpr ModeType flushBits = 0;
+
+		static ModeType ReadMode() noexcept { return 0; }
+		static void WriteMode(ModeType) noexcept {}
+#endif
+	private:
+		ModeType previousMode = 0;
+		bool isWritten = false;
+	};
+}
@@ -0,0 +1,823 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennySIMD/PennyCPUFeatures.h>
+
+namespace Penny {
+	/** Element wise kernels of one instruction set, every pointer can be unaligned. */
+	template<typename sT>
+	struct SIMDKernelTable {
+		SIMDLevel level;
+		/** dst[i] += src[i] */
+		void (*Add)(sT* dst, const sT* src, int size);
+		/** dst[i] -= src[i] */
+		void (*Sub)(sT* dst, const sT* src, int size);
+		/** dst[i] *= src[i] */
+		void (*Mul)(sT* dst, const sT* src, int size);
+		/** dst[i] /= src[i] */
+		void (*Div)(sT* dst, const sT* src, int size);
+		/** dst[i] += value */
+		void (*AddScalar)(sT* dst, sT value, int size);
+		/** dst[i] *= value */
+		void (*MulScalar)(sT* dst, sT value, int size);
+		/** dst[i] /= value */
+		void (*DivScalar)(sT* dst, sT value, int size);
+		/** dst[i] += src[i] * gain (axpy) */
+		void (*MulAdd)(sT* dst, const sT* src, sT gain, int size);
+		/** dst[i] = src[i] * srcGain + dst[i] * dstGain (axpby) */
+		void (*LinearCombination)(sT* dst, const sT* src, sT srcGain, sT dstGain, int size);
+		/** dst[i] = src[i] + (dst[i] - src[i]) * ramp[i], a crossfade from src (ramp 0) to dst (ramp 1) */
+		void (*CrossFade)(sT* dst, const sT* src, const sT* ramp, int size);
+		/** dst[i] = dst[i] * ramp[i] + src[i] */
+		void (*MulRampAdd)(sT* dst, const sT* src, const sT* ramp, int size);
+		/** dst[i] += src[i] * ramp[i] */
+		void (*MulAddRamp)(sT* dst, const sT* src, const sT* ramp, int size);
+		/** dst[i] = start + step * i */
+		void (*LinearRamp)(sT* dst, sT start, sT step, int size);
+		/** dst[i] = start * factor^i */
+		void (*GeometricRamp)(sT* dst, sT start, sT factor, int size);
+		/** dst[i] += src[indices[i]] * gains[i], src is only read at the indices */
+		void (*GatherMulAdd)(sT* dst, const sT* src, const int32_t* indices, const sT* gains, int size);
+		/** a[i], b[i] = a[i] + b[i], a[i] - b[i], the radix 2 step of the Walsh-Hadamard transform */
+		void (*Butterfly)(sT* a, sT* b, int size);
+		/** The sum of a[i] * b[i], the taps of a FIR filter */
+		sT (*Dot)(const sT* a, const sT* b, int size);
+		/** The largest |src[i]|, 0 for an empty block */
+		sT (*Peak)(const sT* src, int size);
+	};
+
+	namespace SIMD_Impl {
+		struct AddOp {
+			template<typename T> static inline T Apply(T a, T b) { return a + b; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 a, __m512 b) { return _mm512_add_ps(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d a, __m512d b) { return _mm512_add_pd(a, b); }
+#endif
+		};
+		struct SubOp {
+			template<typename T> static inline T Apply(T a, T b) { return a - b; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 a, __m512 b) { return _mm512_sub_ps(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d a, __m512d b) { return _mm512_sub_pd(a, b); }
+#endif
+		};
+		struct MulOp {
+			template<typename T> static inline T Apply(T a, T b) { return a * b; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 a, __m512 b) { return _mm512_mul_ps(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d a, __m512d b) { return _mm512_mul_pd(a, b); }
+#endif
+		};
+		struct DivOp {
+			template<typename T> static inline T Apply(T a, T b) { return a / b; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 a, __m512 b) { return _mm512_div_ps(a, b); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d a, __m512d b) { return _mm512_div_pd(a, b); }
+#endif
+		};
+
+		/** max(a, |b|), the running peak of a block. */
+		struct MaxAbsOp {
+			template<typename T> static inline T Apply(T a, T b) { return std::max(a, std::abs(b)); }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 a, __m128 b) { return _mm_max_ps(a, _mm_andnot_ps(_mm_set1_ps(-0.0f), b)); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d a, __m128d b) { return _mm_max_pd(a, _mm_andnot_pd(_mm_set1_pd(-0.0), b)); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 a, __m256 b) { return _mm256_max_ps(a, _mm256_andnot_ps(_mm256_set1_ps(-0.0f), b)); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d a, __m256d b) { return _mm256_max_pd(a, _mm256_andnot_pd(_mm256_set1_pd(-0.0), b)); }
+			// The masked max with every lane set, the plain one has an undefined source GCC warns on.
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 a, __m512 b) { return _mm512_mask_max_ps(a, (__mmask16)0xFFFF, a, _mm512_abs_ps(b)); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d a, __m512d b) { return _mm512_mask_max_pd(a, (__mmask8)0xFF, a, _mm512_abs_pd(b)); }
+#endif
+		};
+
+		/** Fused operations, Apply(dst, src, ramp, a, b), ramp is only loaded if usesRamp. */
+		struct MulAddOp {
+			enum { usesRamp = 0 };
+			template<typename T> static inline T Apply(T d, T s, T, T a, T) { return d + s * a; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 d, __m128 s, __m128, __m128 a, __m128) { return _mm_add_ps(d, _mm_mul_ps(s, a)); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d d, __m128d s, __m128d, __m128d a, __m128d) { return _mm_add_pd(d, _mm_mul_pd(s, a)); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 d, __m256 s, __m256, __m256 a, __m256) { return _mm256_fmadd_ps(s, a, d); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d d, __m256d s, __m256d, __m256d a, __m256d) { return _mm256_fmadd_pd(s, a, d); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 d, __m512 s, __m512, __m512 a, __m512) { return _mm512_fmadd_ps(s, a, d); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d d, __m512d s, __m512d, __m512d a, __m512d) { return _mm512_fmadd_pd(s, a, d); }
+#endif
+		};
+		struct LinearCombinationOp {
+			enum { usesRamp = 0 };
+			template<typename T> static inline T Apply(T d, T s, T, T a, T b) { return s * a + d * b; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 d, __m128 s, __m128, __m128 a, __m128 b) { return _mm_add_ps(_mm_mul_ps(s, a), _mm_mul_ps(d, b)); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d d, __m128d s, __m128d, __m128d a, __m128d b) { return _mm_add_pd(_mm_mul_pd(s, a), _mm_mul_pd(d, b)); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 d, __m256 s, __m256, __m256 a, __m256 b) { return _mm256_fmadd_ps(s, a, _mm256_mul_ps(d, b)); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d d, __m256d s, __m256d, __m256d a, __m256d b) { return _mm256_fmadd_pd(s, a, _mm256_mul_pd(d, b)); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 d, __m512 s, __m512, __m512 a, __m512 b) { return _mm512_fmadd_ps(s, a, _mm512_mul_ps(d, b)); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d d, __m512d s, __m512d, __m512d a, __m512d b) { return _mm512_fmadd_pd(s, a, _mm512_mul_pd(d, b)); }
+#endif
+		};
+		struct CrossFadeOp {
+			enum { usesRamp = 1 };
+			template<typename T> static inline T Apply(T d, T s, T r, T, T) { return s + (d - s) * r; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 d, __m128 s, __m128 r, __m128, __m128) { return _mm_add_ps(s, _mm_mul_ps(_mm_sub_ps(d, s), r)); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d d, __m128d s, __m128d r, __m128d, __m128d) { return _mm_add_pd(s, _mm_mul_pd(_mm_sub_pd(d, s), r)); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 d, __m256 s, __m256 r, __m256, __m256) { return _mm256_fmadd_ps(_mm256_sub_ps(d, s), r, s); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d d, __m256d s, __m256d r, __m256d, __m256d) { return _mm256_fmadd_pd(_mm256_sub_pd(d, s), r, s); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 d, __m512 s, __m512 r, __m512, __m512) { return _mm512_fmadd_ps(_mm512_sub_ps(d, s), r, s); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d d, __m512d s, __m512d r, __m512d, __m512d) { return _mm512_fmadd_pd(_mm512_sub_pd(d, s), r, s); }
+#endif
+		};
+
+		struct MulRampAddOp {
+			enum { usesRamp = 1 };
+			template<typename T> static inline T Apply(T d, T s, T r, T, T) { return d * r + s; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 d, __m128 s, __m128 r, __m128, __m128) { return _mm_add_ps(_mm_mul_ps(d, r), s); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d d, __m128d s, __m128d r, __m128d, __m128d) { return _mm_add_pd(_mm_mul_pd(d, r), s); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 d, __m256 s, __m256 r, __m256, __m256) { return _mm256_fmadd_ps(d, r, s); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d d, __m256d s, __m256d r, __m256d, __m256d) { return _mm256_fmadd_pd(d, r, s); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 d, __m512 s, __m512 r, __m512, __m512) { return _mm512_fmadd_ps(d, r, s); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d d, __m512d s, __m512d r, __m512d, __m512d) { return _mm512_fmadd_pd(d, r, s); }
+#endif
+		};
+
+		struct MulAddRampOp {
+			enum { usesRamp = 1 };
+			template<typename T> static inline T Apply(T d, T s, T r, T, T) { return d + s * r; }
+#if PENNY_SIMD_X86
+			PENNY_TARGET("sse2") static inline __m128 Apply(__m128 d, __m128 s, __m128 r, __m128, __m128) { return _mm_add_ps(d, _mm_mul_ps(s, r)); }
+			PENNY_TARGET("sse2") static inline __m128d Apply(__m128d d, __m128d s, __m128d r, __m128d, __m128d) { return _mm_add_pd(d, _mm_mul_pd(s, r)); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Apply(__m256 d, __m256 s, __m256 r, __m256, __m256) { return _mm256_fmadd_ps(s, r, d); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Apply(__m256d d, __m256d s, __m256d r, __m256d, __m256d) { return _mm256_fmadd_pd(s, r, d); }
+			PENNY_TARGET("avx512f") static inline __m512 Apply(__m512 d, __m512 s, __m512 r, __m512, __m512) { return _mm512_fmadd_ps(s, r, d); }
+			PENNY_TARGET("avx512f") static inline __m512d Apply(__m512d d, __m512d s, __m512d r, __m512d, __m512d) { return _mm512_fmadd_pd(s, r, d); }
+#endif
+		};
+
+		/** 0, 1, 2... used as the lane index of the ramps. */
+		template<typename sT>
+		inline const sT* RampIndices() {
+			alignas(64) static const sT indices[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+			return indices;
+		}
+		/** start * factor^lane for the first width lanes, and factor^width. */
+		template<typename sT>
+		inline sT GeometricLanes(sT* lanes, sT start, sT factor, int width) {
+			sT power = 1;
+			for (int i = 0; i < width; i++) {
+				lanes[i] = start * power;
+				power *= factor;
+			}
+			return power;
+		}
+
+		struct ScalarLoops {
+			template<typename sT, typename Op>
+			static void Binary(sT* __restrict dst, const sT* __restrict src, int size) {
+				for (int i = 0; i < size; i++)
+					dst[i] = Op::Apply(dst[i], src[i]);
+			}
+			template<typename sT, typename Op>
+			static void Scalar(sT* __restrict dst, sT value, int size) {
+				for (int i = 0; i < size; i++)
+					dst[i] = Op::Apply(dst[i], value);
+			}
+			template<typename sT, typename Op>
+			static void Fused(sT* __restrict dst, const sT* __restrict src, const sT* __restrict ramp, sT a, sT b, int size) {
+				for (int i = 0; i < size; i++)
+					dst[i] = Op::Apply(dst[i], src[i], Op::usesRamp ? ramp[i] : sT{}, a, b);
+			}
+			template<typename sT>
+			static void LinearRamp(sT* __restrict dst, sT start, sT step, int size) {
+				for (int i = 0; i < size; i++)
+					dst[i] = start + step * (sT)i;
+			}
+			template<typename sT>
+			static void GeometricRamp(sT* __restrict dst, sT start, sT factor, int size) {
+				sT value = start;
+				for (int i = 0; i < size; i++) {
+					dst[i] = value;
+					value *= factor;
+				}
+			}
+			template<typename sT>
+			static void GatherMulAdd(sT* __restrict dst, const sT* __restrict src, const int32_t* __restrict indices, const sT* __restrict gains, int size) {
+				for (int i = 0; i < size; i++)
+					dst[i] += src[indices[i]] * gains[i];
+			}
+			template<typename sT>
+			static void Butterfly(sT* __restrict a, sT* __restrict b, int size) {
+				for (int i = 0; i < size; i++) {
+					sT sum = a[i] + b[i];
+					b[i] = a[i] - b[i];
+					a[i] = sum;
+				}
+			}
+			template<typename sT>
+			static sT Dot(const sT* __restrict a, const sT* __restrict b, int size) {
+				sT sum{};
+				for (int i = 0; i < size; i++)
+					sum += a[i] * b[i];
+				return sum;
+			}
+			template<typename sT>
+			static sT Peak(const sT* __restrict src, int size) {
+				sT peak{};
+				for (int i = 0; i < size; i++)
+					peak = MaxAbsOp::Apply(peak, src[i]);
+				return peak;
+			}
+		};
+
+#if PENNY_SIMD_X86
+		template<typename sT> struct SSE2Traits;
+		template<> struct SSE2Traits<float> {
+			using VectorType = __m128;
+			enum { width = 4 };
+			PENNY_TARGET("sse2") static inline __m128 Load(const float* src) { return _mm_loadu_ps(src); }
+			PENNY_TARGET("sse2") static inline void Store(float* dst, __m128 v) { _mm_storeu_ps(dst, v); }
+			PENNY_TARGET("sse2") static inline __m128 Set1(float value) { return _mm_set1_ps(value); }
+		};
+		template<> struct SSE2Traits<double> {
+			using VectorType = __m128d;
+			enum { width = 2 };
+			PENNY_TARGET("sse2") static inline __m128d Load(const double* src) { return _mm_loadu_pd(src); }
+			PENNY_TARGET("sse2") static inline void Store(double* dst, __m128d v) { _mm_storeu_pd(dst, v); }
+			PENNY_TARGET("sse2") static inline __m128d Set1(double value) { return _mm_set1_pd(value); }
+		};
+
+		/** SSE2 has no masked load/store, the tail is scalar. */
+		struct SSE2Loops {
+			template<typename sT, typename Op>
+			PENNY_TARGET("sse2") static void Binary(sT* __restrict dst, const sT* __restrict src, int size) {
+				using V = SSE2Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i)));
+				for (; i < size; i++)
+					dst[i] = Op::Apply(dst[i], src[i]);
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("sse2") static void Scalar(sT* __restrict dst, sT value, int size) {
+				using V = SSE2Traits<sT>;
+				typename V::VectorType vValue = V::Set1(value);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), vValue));
+				for (; i < size; i++)
+					dst[i] = Op::Apply(dst[i], value);
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("sse2") static void Fused(sT* __restrict dst, const sT* __restrict src, const sT* __restrict ramp, sT a, sT b, int size) {
+				using V = SSE2Traits<sT>;
+				typename V::VectorType vA = V::Set1(a), vB = V::Set1(b), vZero = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i), Op::usesRamp ? V::Load(ramp + i) : vZero, vA, vB));
+				for (; i < size; i++)
+					dst[i] = Op::Apply(dst[i], src[i], Op::usesRamp ? ramp[i] : sT{}, a, b);
+			}
+			template<typename sT>
+			PENNY_TARGET("sse2") static void LinearRamp(sT* __restrict dst, sT start, sT step, int size) {
+				using V = SSE2Traits<sT>;
+				typename V::VectorType vStart = V::Set1(start), vStep = V::Set1(step), vWidth = V::Set1((sT)V::width);
+				typename V::VectorType vIndex = V::Load(RampIndices<sT>());
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, AddOp::Apply(vStart, MulOp::Apply(vIndex, vStep)));
+					vIndex = AddOp::Apply(vIndex, vWidth);
+				}
+				for (; i < size; i++)
+					dst[i] = start + step * (sT)i;
+			}
+			template<typename sT>
+			PENNY_TARGET("sse2") static void GeometricRamp(sT* __restrict dst, sT start, sT factor, int size) {
+				using V = SSE2Traits<sT>;
+				sT lanes[V::width];
+				typename V::VectorType vFactor = V::Set1(GeometricLanes(lanes, start, factor, V::width));
+				typename V::VectorType vValue = V::Load(lanes);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, vValue);
+					vValue = MulOp::Apply(vValue, vFactor);
+				}
+				V::Store(lanes, vValue);
+				for (int j = 0; i < size; i++, j++)
+					dst[i] = lanes[j];
+			}
+			/** SSE2 has no gather instruction. */
+			template<typename sT>
+			static void GatherMulAdd(sT* __restrict dst, const sT* __restrict src, const int32_t* __restrict indices, const sT* __restrict gains, int size) {
+				ScalarLoops::GatherMulAdd(dst, src, indices, gains, size);
+			}
+			template<typename sT>
+			PENNY_TARGET("sse2") static void Butterfly(sT* __restrict a, sT* __restrict b, int size) {
+				using V = SSE2Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					typename V::VectorType vA = V::Load(a + i), vB = V::Load(b + i);
+					V::Store(a + i, AddOp::Apply(vA, vB));
+					V::Store(b + i, SubOp::Apply(vA, vB));
+				}
+				for (; i < size; i++) {
+					sT sum = a[i] + b[i];
+					b[i] = a[i] - b[i];
+					a[i] = sum;
+				}
+			}
+			template<typename sT>
+			PENNY_TARGET("sse2") static sT Dot(const sT* __restrict a, const sT* __restrict b, int size) {
+				using V = SSE2Traits<sT>;
+				typename V::VectorType vZero = V::Set1(sT{}), vSum0 = vZero, vSum1 = vZero;
+				int i = 0;
+				for (; i + 2 * V::width <= size; i += 2 * V::width) {
+					vSum0 = MulAddOp::Apply(vSum0, V::Load(a + i), vZero, V::Load(b + i), vZero);
+					vSum1 = MulAddOp::Apply(vSum1, V::Load(a + i + V::width), vZero, V::Load(b + i + V::width), vZero);
+				}
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, AddOp::Apply(vSum0, vSum1));
+				sT sum{};
+				for (int j = 0; j < V::width; j++)
+					sum += lanes[j];
+				for (; i < size; i++)
+					sum += a[i] * b[i];
+				return sum;
+			}
+			template<typename sT>
+			PENNY_TARGET("sse2") static sT Peak(const sT* __restrict src, int size) {
+				using V = SSE2Traits<sT>;
+				typename V::VectorType vPeak = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					vPeak = MaxAbsOp::Apply(vPeak, V::Load(src + i));
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, vPeak);
+				sT peak{};
+				for (int j = 0; j < V::width; j++)
+					peak = std::max(peak, lanes[j]);
+				for (; i < size; i++)
+					peak = MaxAbsOp::Apply(peak, src[i]);
+				return peak;
+			}
+		};
+
+		template<typename sT> struct AVX2Traits;
+		template<> struct AVX2Traits<float> {
+			using VectorType = __m256;
+			enum { width = 8 };
+			PENNY_TARGET("avx2,fma") static inline __m256 Load(const float* src) { return _mm256_loadu_ps(src); }
+			PENNY_TARGET("avx2,fma") static inline void Store(float* dst, __m256 v) { _mm256_storeu_ps(dst, v); }
+			PENNY_TARGET("avx2,fma") static inline __m256 Set1(float value) { return _mm256_set1_ps(value); }
+			/** Mask of the first count lanes, 0 < count < width. */
+			PENNY_TARGET("avx2,fma") static inline __m256i TailMask(int count) {
+				alignas(32) static const int32_t maskTable[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+				return _mm256_loadu_si256((const __m256i*)(maskTable + 8 - count));
+			}
+			PENNY_TARGET("avx2,fma") static inline __m256 MaskLoad(const float* src, __m256i mask) { return _mm256_maskload_ps(src, mask); }
+			PENNY_TARGET("avx2,fma") static inline void MaskStore(float* dst, __m256i mask, __m256 v) { _mm256_maskstore_ps(dst, mask, v); }
+			/** Every lane is gathered, the masked form only avoids the undefined source of the plain one (GCC warns on it). */
+			PENNY_TARGET("avx2,fma") static inline __m256 Gather(const float* src, const int32_t* indices) {
+				return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), src, _mm256_loadu_si256((const __m256i*)indices), _mm256_castsi256_ps(_mm256_set1_epi32(-1)), 4);
+			}
+		};
+		template<> struct AVX2Traits<double> {
+			using VectorType = __m256d;
+			enum { width = 4 };
+			PENNY_TARGET("avx2,fma") static inline __m256d Load(const double* src) { return _mm256_loadu_pd(src); }
+			PENNY_TARGET("avx2,fma") static inline void Store(double* dst, __m256d v) { _mm256_storeu_pd(dst, v); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Set1(double value) { return _mm256_set1_pd(value); }
+			/** Mask of the first count lanes, 0 < count < width. */
+			PENNY_TARGET("avx2,fma") static inline __m256i TailMask(int count) {
+				alignas(32) static const int64_t maskTable[8] = { -1, -1, -1, -1, 0, 0, 0, 0 };
+				return _mm256_loadu_si256((const __m256i*)(maskTable + 4 - count));
+			}
+			PENNY_TARGET("avx2,fma") static inline __m256d MaskLoad(const double* src, __m256i mask) { return _mm256_maskload_pd(src, mask); }
+			PENNY_TARGET("avx2,fma") static inline void MaskStore(double* dst, __m256i mask, __m256d v) { _mm256_maskstore_pd(dst, mask, v); }
+			PENNY_TARGET("avx2,fma") static inline __m256d Gather(const double* src, const int32_t* indices) {
+				return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), src, _mm_loadu_si128((const __m128i*)indices), _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+			}
+		};
+
+		struct AVX2Loops {
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx2,fma") static void Binary(sT* __restrict dst, const sT* __restrict src, int size) {
+				using V = AVX2Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i)));
+				if (i < size) {
+					__m256i mask = V::TailMask(size - i);
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), V::MaskLoad(src + i, mask)));
+				}
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx2,fma") static void Scalar(sT* __restrict dst, sT value, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vValue = V::Set1(value);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), vValue));
+				if (i < size) {
+					__m256i mask = V::TailMask(size - i);
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), vValue));
+				}
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx2,fma") static void Fused(sT* __restrict dst, const sT* __restrict src, const sT* __restrict ramp, sT a, sT b, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vA = V::Set1(a), vB = V::Set1(b), vZero = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i), Op::usesRamp ? V::Load(ramp + i) : vZero, vA, vB));
+				if (i < size) {
+					__m256i mask = V::TailMask(size - i);
+					typename V::VectorType vRamp = Op::usesRamp ? V::MaskLoad(ramp + i, mask) : vZero;
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), V::MaskLoad(src + i, mask), vRamp, vA, vB));
+				}
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static void LinearRamp(sT* __restrict dst, sT start, sT step, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vStart = V::Set1(start), vStep = V::Set1(step), vWidth = V::Set1((sT)V::width), vZero = V::Set1(sT{});
+				typename V::VectorType vIndex = V::Load(RampIndices<sT>());
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, MulAddOp::Apply(vStart, vIndex, vZero, vStep, vZero));
+					vIndex = AddOp::Apply(vIndex, vWidth);
+				}
+				if (i < size)
+					V::MaskStore(dst + i, V::TailMask(size - i), MulAddOp::Apply(vStart, vIndex, vZero, vStep, vZero));
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static void GeometricRamp(sT* __restrict dst, sT start, sT factor, int size) {
+				using V = AVX2Traits<sT>;
+				sT lanes[V::width];
+				typename V::VectorType vFactor = V::Set1(GeometricLanes(lanes, start, factor, V::width));
+				typename V::VectorType vValue = V::Load(lanes);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, vValue);
+					vValue = MulOp::Apply(vValue, vFactor);
+				}
+				if (i < size)
+					V::MaskStore(dst + i, V::TailMask(size - i), vValue);
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static void GatherMulAdd(sT* __restrict dst, const sT* __restrict src, const int32_t* __restrict indices, const sT* __restrict gains, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vZero = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, MulAddOp::Apply(V::Load(dst + i), V::Gather(src, indices + i), vZero, V::Load(gains + i), vZero));
+				for (; i < size; i++)
+					dst[i] += src[indices[i]] * gains[i];
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static void Butterfly(sT* __restrict a, sT* __restrict b, int size) {
+				using V = AVX2Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					typename V::VectorType vA = V::Load(a + i), vB = V::Load(b + i);
+					V::Store(a + i, AddOp::Apply(vA, vB));
+					V::Store(b + i, SubOp::Apply(vA, vB));
+				}
+				if (i < size) {
+					__m256i mask = V::TailMask(size - i);
+					typename V::VectorType vA = V::MaskLoad(a + i, mask), vB = V::MaskLoad(b + i, mask);
+					V::MaskStore(a + i, mask, AddOp::Apply(vA, vB));
+					V::MaskStore(b + i, mask, SubOp::Apply(vA, vB));
+				}
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static sT Dot(const sT* __restrict a, const sT* __restrict b, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vZero = V::Set1(sT{}), vSum0 = vZero, vSum1 = vZero;
+				int i = 0;
+				for (; i + 2 * V::width <= size; i += 2 * V::width) {
+					vSum0 = MulAddOp::Apply(vSum0, V::Load(a + i), vZero, V::Load(b + i), vZero);
+					vSum1 = MulAddOp::Apply(vSum1, V::Load(a + i + V::width), vZero, V::Load(b + i + V::width), vZero);
+				}
+				for (; i < size; i += V::width) {
+					// Masked lanes load as 0.
+					__m256i mask = V::TailMask(juce::jmin((int)V::width, size - i));
+					vSum0 = MulAddOp::Apply(vSum0, V::MaskLoad(a + i, mask), vZero, V::MaskLoad(b + i, mask), vZero);
+				}
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, AddOp::Apply(vSum0, vSum1));
+				sT sum{};
+				for (int j = 0; j < V::width; j++)
+					sum += lanes[j];
+				return sum;
+			}
+			template<typename sT>
+			PENNY_TARGET("avx2,fma") static sT Peak(const sT* __restrict src, int size) {
+				using V = AVX2Traits<sT>;
+				typename V::VectorType vPeak = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					vPeak = MaxAbsOp::Apply(vPeak, V::Load(src + i));
+				if (i < size) {
+					// Masked lanes load as 0.
+					__m256i mask = V::TailMask(size - i);
+					vPeak = MaxAbsOp::Apply(vPeak, V::MaskLoad(src + i, mask));
+				}
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, vPeak);
+				sT peak{};
+				for (int j = 0; j < V::width; j++)
+					peak = std::max(peak, lanes[j]);
+				return peak;
+			}
+		};
+
+		template<typename sT> struct AVX512Traits;
+		template<> struct AVX512Traits<float> {
+			using VectorType = __m512;
+			using MaskType = __mmask16;
+			enum { width = 16 };
+			PENNY_TARGET("avx512f") static inline __m512 Load(const float* src) { return _mm512_loadu_ps(src); }
+			PENNY_TARGET("avx512f") static inline void Store(float* dst, __m512 v) { _mm512_storeu_ps(dst, v); }
+			PENNY_TARGET("avx512f") static inline __m512 Set1(float value) { return _mm512_set1_ps(value); }
+			PENNY_TARGET("avx512f") static inline __mmask16 TailMask(int count) { return (__mmask16)((1u << count) - 1u); }
+			PENNY_TARGET("avx512f") static inline __m512 MaskLoad(const float* src, __mmask16 mask) { return _mm512_maskz_loadu_ps(mask, src); }
+			PENNY_TARGET("avx512f") static inline void MaskStore(float* dst, __mmask16 mask, __m512 v) { _mm512_mask_storeu_ps(dst, mask, v); }
+			/** Every lane is gathered, the masked form only avoids the undefined source of the plain one (GCC warns on it). */
+			PENNY_TARGET("avx512f") static inline __m512 Gather(const float* src, const int32_t* indices) {
+				return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), (__mmask16)0xFFFF, _mm512_loadu_si512(indices), src, 4);
+			}
+		};
+		template<> struct AVX512Traits<double> {
+			using VectorType = __m512d;
+			using MaskType = __mmask8;
+			enum { width = 8 };
+			PENNY_TARGET("avx512f") static inline __m512d Load(const double* src) { return _mm512_loadu_pd(src); }
+			PENNY_TARGET("avx512f") static inline void Store(double* dst, __m512d v) { _mm512_storeu_pd(dst, v); }
+			PENNY_TARGET("avx512f") static inline __m512d Set1(double value) { return _mm512_set1_pd(value); }
+			PENNY_TARGET("avx512f") static inline __mmask8 TailMask(int count) { return (__mmask8)((1u << count) - 1u); }
+			PENNY_TARGET("avx512f") static inline __m512d MaskLoad(const double* src, __mmask8 mask) { return _mm512_maskz_loadu_pd(mask, src); }
+			PENNY_TARGET("avx512f") static inline void MaskStore(double* dst, __mmask8 mask, __m512d v) { _mm512_mask_storeu_pd(dst, mask, v); }
+			PENNY_TARGET("avx512f") static inline __m512d Gather(const double* src, const int32_t* indices) {
+				return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), (__mmask8)0xFF, _mm256_loadu_si256((const __m256i*)indices), src, 8);
+			}
+		};
+
+		struct AVX512Loops {
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx512f,avx2,fma") static void Binary(sT* __restrict dst, const sT* __restrict src, int size) {
+				using V = AVX512Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i)));
+				if (i < size) {
+					typename V::MaskType mask = V::TailMask(size - i);
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), V::MaskLoad(src + i, mask)));
+				}
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx512f,avx2,fma") static void Scalar(sT* __restrict dst, sT value, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vValue = V::Set1(value);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), vValue));
+				if (i < size) {
+					typename V::MaskType mask = V::TailMask(size - i);
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), vValue));
+				}
+			}
+			template<typename sT, typename Op>
+			PENNY_TARGET("avx512f,avx2,fma") static void Fused(sT* __restrict dst, const sT* __restrict src, const sT* __restrict ramp, sT a, sT b, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vA = V::Set1(a), vB = V::Set1(b), vZero = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, Op::Apply(V::Load(dst + i), V::Load(src + i), Op::usesRamp ? V::Load(ramp + i) : vZero, vA, vB));
+				if (i < size) {
+					typename V::MaskType mask = V::TailMask(size - i);
+					typename V::VectorType vRamp = Op::usesRamp ? V::MaskLoad(ramp + i, mask) : vZero;
+					V::MaskStore(dst + i, mask, Op::Apply(V::MaskLoad(dst + i, mask), V::MaskLoad(src + i, mask), vRamp, vA, vB));
+				}
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static void LinearRamp(sT* __restrict dst, sT start, sT step, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vStart = V::Set1(start), vStep = V::Set1(step), vWidth = V::Set1((sT)V::width), vZero = V::Set1(sT{});
+				typename V::VectorType vIndex = V::Load(RampIndices<sT>());
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, MulAddOp::Apply(vStart, vIndex, vZero, vStep, vZero));
+					vIndex = AddOp::Apply(vIndex, vWidth);
+				}
+				if (i < size)
+					V::MaskStore(dst + i, V::TailMask(size - i), MulAddOp::Apply(vStart, vIndex, vZero, vStep, vZero));
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static void GeometricRamp(sT* __restrict dst, sT start, sT factor, int size) {
+				using V = AVX512Traits<sT>;
+				sT lanes[V::width];
+				typename V::VectorType vFactor = V::Set1(GeometricLanes(lanes, start, factor, V::width));
+				typename V::VectorType vValue = V::Load(lanes);
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					V::Store(dst + i, vValue);
+					vValue = MulOp::Apply(vValue, vFactor);
+				}
+				if (i < size)
+					V::MaskStore(dst + i, V::TailMask(size - i), vValue);
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static void GatherMulAdd(sT* __restrict dst, const sT* __restrict src, const int32_t* __restrict indices, const sT* __restrict gains, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vZero = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					V::Store(dst + i, MulAddOp::Apply(V::Load(dst + i), V::Gather(src, indices + i), vZero, V::Load(gains + i), vZero));
+				for (; i < size; i++)
+					dst[i] += src[indices[i]] * gains[i];
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static void Butterfly(sT* __restrict a, sT* __restrict b, int size) {
+				using V = AVX512Traits<sT>;
+				int i = 0;
+				for (; i + V::width <= size; i += V::width) {
+					typename V::VectorType vA = V::Load(a + i), vB = V::Load(b + i);
+					V::Store(a + i, AddOp::Apply(vA, vB));
+					V::Store(b + i, SubOp::Apply(vA, vB));
+				}
+				if (i < size) {
+					typename V::MaskType mask = V::TailMask(size - i);
+					typename V::VectorType vA = V::MaskLoad(a + i, mask), vB = V::MaskLoad(b + i, mask);
+					V::MaskStore(a + i, mask, AddOp::Apply(vA, vB));
+					V::MaskStore(b + i, mask, SubOp::Apply(vA, vB));
+				}
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static sT Dot(const sT* __restrict a, const sT* __restrict b, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vZero = V::Set1(sT{}), vSum0 = vZero, vSum1 = vZero;
+				int i = 0;
+				for (; i + 2 * V::width <= size; i += 2 * V::width) {
+					vSum0 = MulAddOp::Apply(vSum0, V::Load(a + i), vZero, V::Load(b + i), vZero);
+					vSum1 = MulAddOp::Apply(vSum1, V::Load(a + i + V::width), vZero, V::Load(b + i + V::width), vZero);
+				}
+				for (; i < size; i += V::width) {
+					// Masked lanes load as 0.
+					typename V::MaskType mask = V::TailMask(juce::jmin((int)V::width, size - i));
+					vSum0 = MulAddOp::Apply(vSum0, V::MaskLoad(a + i, mask), vZero, V::MaskLoad(b + i, mask), vZero);
+				}
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, AddOp::Apply(vSum0, vSum1));
+				sT sum{};
+				for (int j = 0; j < V::width; j++)
+					sum += lanes[j];
+				return sum;
+			}
+			template<typename sT>
+			PENNY_TARGET("avx512f,avx2,fma") static sT Peak(const sT* __restrict src, int size) {
+				using V = AVX512Traits<sT>;
+				typename V::VectorType vPeak = V::Set1(sT{});
+				int i = 0;
+				for (; i + V::width <= size; i += V::width)
+					vPeak = MaxAbsOp::Apply(vPeak, V::Load(src + i));
+				if (i < size) {
+					// Masked lanes load as 0.
+					typename V::MaskType mask = V::TailMask(size - i);
+					vPeak = MaxAbsOp::Apply(vPeak, V::MaskLoad(src + i, mask));
+				}
+				alignas(64) sT lanes[V::width];
+				V::Store(lanes, vPeak);
+				sT peak{};
+				for (int j = 0; j < V::width; j++)
+					peak = std::max(peak, lanes[j]);
+				return peak;
+			}
+		};
+#endif
+
+		template<typename sT, typename Loops>
+		void MulAdd(sT* dst, const sT* src, sT gain, int size) {
+			Loops::template Fused<sT, MulAddOp>(dst, src, nullptr, gain, sT{}, size);
+		}
+		template<typename sT, typename Loops>
+		void LinearCombination(sT* dst, const sT* src, sT srcGain, sT dstGain, int size) {
+			Loops::template Fused<sT, LinearCombinationOp>(dst, src, nullptr, srcGain, dstGain, size);
+		}
+		template<typename sT, typename Loops>
+		void CrossFade(sT* dst, const sT* src, const sT* ramp, int size) {
+			Loops::template Fused<sT, CrossFadeOp>(dst, src, ramp, sT{}, sT{}, size);
+		}
+
+		template<typename sT, typename Loops>
+		void MulRampAdd(sT* dst, const sT* src, const sT* ramp, int size) {
+			Loops::template Fused<sT, MulRampAddOp>(dst, src, ramp, sT{}, sT{}, size);
+		}
+		template<typename sT, typename Loops>
+		void MulAddRamp(sT* dst, const sT* src, const sT* ramp, int size) {
+			Loops::template Fused<sT, MulAddRampOp>(dst, src, ramp, sT{}, sT{}, size);
+		}
+
+		template<typename sT, typename Loops>
+		SIMDKernelTable<sT> MakeTable(SIMDLevel level) {
+			SIMDKernelTable<sT> table;
+			table.level = level;
+			table.Add = &Loops::template Binary<sT, AddOp>;
+			table.Sub = &Loops::template Binary<sT, SubOp>;
+			table.Mul = &Loops::template Binary<sT, MulOp>;
+			table.Div = &Loops::template Binary<sT, DivOp>;
+			table.AddScalar = &Loops::template Scalar<sT, AddOp>;
+			table.MulScalar = &Loops::template Scalar<sT, MulOp>;
+			table.DivScalar = &Loops::template Scalar<sT, DivOp>;
+			table.MulAdd = &MulAdd<sT, Loops>;
+			table.LinearCombination = &LinearCombination<sT, Loops>;
+			table.CrossFade = &CrossFade<sT, Loops>;
+			table.MulRampAdd = &MulRampAdd<sT, Loops>;
+			table.MulAddRamp = &MulAddRamp<sT, Loops>;
+			table.LinearRamp = &Loops::template LinearRamp<sT>;
+			table.GeometricRamp = &Loops::template GeometricRamp<sT>;
+			table.GatherMulAdd = &Loops::template GatherMulAdd<sT>;
+			table.Butterfly = &Loops::template Butterfly<sT>;
+			table.Dot = &Loops::template Dot<sT>;
+			table.Peak = &Loops::template Peak<sT>;
+			return table;
+		}
+
+		/** One table per SIMDLevel, only float and double have vectorized kernels. */
+		template<typename sT, bool vectorized = std::is_same<sT, float>::value || std::is_same<sT, double>::value>
+		struct TableSet {
+			static const SIMDKernelTable<sT>& Get(SIMDLevel) {
+				static const SIMDKernelTable<sT> table = MakeTable<sT, ScalarLoops>(SIMDLevel::Scalar);
+				return table;
+			}
+		};
+		template<typename sT>
+		struct TableSet<sT, true> {
+			static const SIMDKernelTable<sT>& Get(SIMDLevel level) {
+#if PENNY_SIMD_X86
+				static const SIMDKernelTable<sT> tables[4] = {
+					MakeTable<sT, ScalarLoops>(SIMDLevel::Scalar),
+					MakeTable<sT, SSE2Loops>(SIMDLevel::SSE2),
+					MakeTable<sT, AVX2Loops>(SIMDLevel::AVX2),
+					MakeTable<sT, AVX512Loops>(SIMDLevel::AVX512)
+				};
+				return tables[(int)level];
+#else
+				static const SIMDKernelTable<sT> table = MakeTable<sT, ScalarLoops>(SIMDLevel::Scalar);
+				return table;
+#endif
+			}
+		};
+	}
+
+	/**
+	 * Kernels dispatched at runtime, the instruction set is chosen once from CPUID.
+	 */
+	template<typename sT>
+	class SIMDKernels {
+	public:
+		/** Get the kernels of the current instruction set. */
+		static inline const SIMDKernelTable<sT>& Get() noexcept {
+			return *GetCurrent().load(std::memory_order_relaxed);
+		}
+		/** Get the kernels of the specified instruction set, it must be supported by this machine. */
+		static const SIMDKernelTable<sT>& Get(SIMDLevel level) {
+			jassert((int)level <= (int)GetSupportedSIMDLevel());
+			return SIMD_Impl::TableSet<sT>::Get(level);
+		}
+		/** Force the instruction set (limited to what is supported), for benchmarking or debugging. */
+		static void SetLevel(SIMDLevel level) {
+			if ((int)level > (int)GetSupportedSIMDLevel())
+				level = GetSupportedSIMDLevel();
+			GetCurrent().store(&SIMD_Impl::TableSet<sT>::Get(level), std::memory_order_relaxed);
+		}
+		static SIMDLevel GetLevel() {
+			return Get().level;
+		}
+	private:
+		static std::atomic<const SIMDKernelTable<sT>*>& GetCurrent() {
+			static std::atomic<const SIMDKernelTable<sT>*> current{ &SIMD_Impl::TableSet<sT>::Get(GetSupportedSIMDLevel()) };
+			return current;
+		}
+	};
+}
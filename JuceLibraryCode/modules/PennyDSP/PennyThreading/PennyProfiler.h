@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennySIMD/PennyCPUFeatures.h>
+#include <PennyDSP/PennyThreading/PennyRealtimeCheck.h>
+
+/** Set PENNY_PROFILING to 1 to compile the PENNY_PROFILE_ hooks in, they expand to nothing otherwise. */
+#ifndef PENNY_PROFILING
+	#define PENNY_PROFILING 0
+#endif
+
+namespace Penny {
+	/** Timestamp counter of the profiler, rdtsc on x86 and the steady clock elsewhere. */
+	inline uint64_t ReadProfilerTicks() noexcept {
+#if PENNY_SIMD_X86
+		return (uint64_t)__rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	/** Ticks of ReadProfilerTicks per second, measured against the steady clock on the first call (which takes 20ms). */
+	inline double GetProfilerTicksPerSecond() {
+		static const double ticksPerSecond = [] {
+#if PENNY_SIMD_X86
+			auto start = std::chrono::steady_clock::now();
+			uint64_t startTicks = ReadProfilerTicks();
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			uint64_t endTicks = ReadProfilerTicks();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return (double)(endTicks - startTicks) / seconds;
+#else
+			return (double)std::chrono::steady_clock::period::den / (double)std::chrono::steady_clock::period::num;
+#endif
+		}();
+		return ticksPerSecond;
+	}
+
+	/**
+	 * Per stage CPU profiler of an audio callback.
+	 * The audio thread brackets every callback with BeginBlock / EndBlock and calls Lap(stage) at the end of every stage,
+	 * the time since the previous lap is charged to the stage. The results go through a lock free single producer /
+	 * single consumer ring buffer, another thread drains it with Collect and reads the statistics.
+	 * The callback time, deadline misses and denormals are recorded on every block, the stages only on one block every
+	 * stageInterval to keep the cost low. One profiler per audio thread, use the PENNY_PROFILE_ macros on the audio thread.
+	 */
+	class Profiler {
+	public:
+		/** Statistics of a stage or of the whole callback, in microseconds. */
+		struct Stats {
+			int count = 0;
+			double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+		};
+	public:
+		/** Construct a profiler with a ring buffer of capacity events (rounded up to a power of 2) and history blocks of statistics. */
+		Profiler(int capacity = 4096, int history = 8192) :
+			events((size_t)juce::nextPowerOfTwo(juce::jmax(2, capacity))), history{ juce::jmax(1, history) } {
+			blockHistory.reserve((size_t)this->history);
+		}
+
+		/**
+		 * Add a stage and return its index, before the audio thread starts using the profiler.
+		 * Stages are identified by name, adding one twice returns the same index.
+		 */
+		int AddStage(const std::string& name) {
+			PENNY_ASSERT_NOT_REALTIME();
+			for (int i = 0; i < (int)stages.size(); i++)
+				if (stages[i].name == name)
+					return i;
+			stages.push_back(StageData{ name, 0, {} });
+			stages.back().durations.reserve((size_t)history);
+			return (int)stages.size() - 1;
+		}
+		int GetStagesNumber() const {
+			return (int)stages.size();
+		}
+		const std::string& GetStageName(int stage) const {
+			return stages[stage].name;
+		}
+		/** Profile the stages of one block every interval blocks. */
+		void SetStageInterval(int interval) {
+			jassert(interval > 0);
+			stageInterval = interval;
+		}
+		/** The sample rate the block deadlines are computed with. */
+		void SetSampleRate(double sampleRate) {
+			this->sampleRate.store(sampleRate, std::memory_order_relaxed);
+		}
+
+		//Audio thread
+
+		void BeginBlock(int numSamples) noexcept {
+			blockSamples = numSamples;
+			isStageBlock = ++blockCounter >= stageInterval;
+			if (isStageBlock)
+				blockCounter = 0;
+#if PENNY_SIMD_X86
+			// Clear the sticky exception flags, EndBlock reads the denormal and underflow ones.
+			_mm_setcsr(_mm_getcsr() & ~0x3fu);
+#endif
+			blockStart = lapStart = ReadProfilerTicks();
+		}
+		/** Charge the time since the previous lap (or BeginBlock) to stage. */
+		inline void Lap(int stage) noexcept {
+			jassert(stage >= 0 && stage < (int)stages.size());
+			if (!isStageBlock)
+				return;
+			uint64_t now = ReadProfilerTicks();
+			stages[stage].ticks += now - lapStart;
+			lapStart = now;
+		}
+		void EndBlock() noexcept {
+			uint64_t ticks = ReadProfilerTicks() - blockStart;
+			bool denormals = false;
+#if PENNY_SIMD_X86
+			// Denormal operand or underflow, flushed to zero or not.
+			denormals = (_mm_getcsr() & 0x12u) != 0;
+#endif
+			Push(Event{ blockEvent, blockSamples, denormals, ticks });
+			if (!isStageBlock)
+				return;
+			for (int i = 0; i < (int)stages.size(); i++) {
+				if (stages[i].ticks == 0)
+					continue;
+				Push(Event{ i, blockSamples, false, stages[i].ticks });
+				stages[i].ticks = 0;
+			}
+		}
+
+		//Reader thread
+
+		/** Drain the ring buffer into the statistics. */
+		void Collect() {
+			double microsecondsPerTick = 1e6 / GetProfilerTicksPerSecond();
+			double rate = sampleRate.load(std::memory_order_relaxed);
+			size_t read = readIndex.load(std::memory_order_relaxed);
+			size_t write = writeIndex.load(std::memory_order_acquire);
+			for (; read != write; read++) {
+				const Event& event = events[read & (events.size() - 1)];
+				double duration = (double)event.ticks * microsecondsPerTick;
+				if (event.stage == blockEvent) {
+					blocks++;
+					if (rate > 0 && duration > event.numSamples * 1e6 / rate)
+						deadlineMisses++;
+					if (event.denormals)
+						denormalBlocks++;
+					AddToHistory(blockHistory, blockHistoryPosition, duration);
+				}
+				else if (event.stage < (int)stages.size()) {
+					AddToHistory(stages[event.stage].durations, stages[event.stage].historyPosition, duration);
+				}
+			}
+			readIndex.store(read, std::memory_order_release);
+		}
+		/** Statistics of the last history profiled blocks of stage. */
+		Stats GetStageStats(int stage) const {
+			return ComputeStats(stages[stage].durations);
+		}
+		/** Statistics of the last history callbacks. */
+		Stats GetBlockStats() const {
+			return ComputeStats(blockHistory);
+		}
+		int64_t GetBlocksNumber() const {
+			return blocks;
+		}
+		/** Callbacks longer than their block of audio. */
+		int64_t GetDeadlineMisses() const {
+			return deadlineMisses;
+		}
+		/** Callbacks that met a denormal, flushed to zero or not. Always 0 outside of x86. */
+		int64_t GetDenormalBlocks() const {
+			return denormalBlocks;
+		}
+		/** Events lost because the ring buffer was full, Collect more often if it grows. */
+		int64_t GetDroppedEvents() const {
+			return droppedEvents.load(std::memory_order_relaxed);
+		}
+
+		/** A table of the statistics, for logs and command line tools. */
+		std::string GetReport() const {
+			std::string report{};
+			char line[160];
+			std::snprintf(line, sizeof(line), "%-20s %8s %9s %9s %9s %9s %9s\n", "stage (us)", "count", "mean", "p50", "p90", "p99", "max");
+			report += line;
+			auto addLine = [&](const std::string& name, const Stats& stats) {
+				std::snprintf(line, sizeof(line), "%-20s %8d %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+					name.c_str(), stats.count, stats.mean, stats.p50, stats.p90, stats.p99, stats.max);
+				report += line;
+			};
+			for (int i = 0; i < (int)stages.size(); i++)
+				addLine(stages[i].name, GetStageStats(i));
+			addLine("callback", GetBlockStats());
+			std::snprintf(line, sizeof(line), "%lld callbacks, %lld deadline misses, %lld with denormals, %lld events dropped\n",
+				(long long)blocks, (long long)deadlineMisses, (long long)denormalBlocks, (long long)GetDroppedEvents());
+			report += line;
+			return report;
+		}
+	private:
+		static constexpr int blockEvent = -1;
+
+		struct Event {
+			int stage;
+			int numSamples;
+			bool denormals;
+			uint64_t ticks;
+		};
+		struct StageData {
+			std::string name;
+			uint64_t ticks;
+			std::vector<double> durations;
+			size_t historyPosition = 0;
+		};
+
+		inline void Push(const Event& event) noexcept {
+			size_t write = writeIndex.load(std::memory_order_relaxed);
+			if (write - readIndex.load(std::memory_order_acquire) == events.size()) {
+				droppedEvents.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			events[write & (events.size() - 1)] = event;
+			writeIndex.store(write + 1, std::memory_order_release);
+		}
+
+		void AddToHistory(std::vector<double>& durations, size_t& position, double duration) {
+			if ((int)durations.size() < history)
+				durations.push_back(duration);
+			else
+				durations[position] = duration;
+			position = (position + 1) % (size_t)history;
+		}
+
+		static Stats ComputeStats(std::vector<double> durations) {
+			Stats stats{};
+			if (durations.empty())
+				return stats;
+			std::sort(durations.begin(), durations.end());
+			auto percentile = [&](double p) { return durations[(size_t)(p / 100.0 * (double)(durations.size() - 1) + 0.5)]; };
+			stats.count = (int)durations.size();
+			for (double duration : durations)
+				stats.mean += duration;
+			stats.mean /= (double)durations.size();
+			stats.p50 = percentile(50);
+			stats.p90 = percentile(90);
+			stats.p99 = percentile(99);
+			stats.max = durations.back();
+			return stats;
+		}
+	private:
+		//Audio thread
+		std::vector<StageData> stages{};
+		uint64_t blockStart = 0, lapStart = 0;
+		int blockSamples = 0;
+		int stageInterval = 8, blockCounter = 0;
+		bool isStageBlock = false;
+		//Ring buffer
+		std::vector<Event> events;
+		std::atomic<size_t> writeIndex{ 0 }, readIndex{ 0 };
+		std::atomic<int64_t> droppedEvents{ 0 };
+		std::atomic<double> sampleRate{ 0 };
+		//Reader thread
+		int history;
+		std::vector<double> blockHistory{};
+		size_t blockHistoryPosition = 0;
+		int64_t blocks = 0, deadlineMisses = 0, denormalBlocks = 0;
+	};
+
+	/** BeginBlock on construction and EndBlock on destruction, nothing if profiler is null. */
+	class ScopedProfilerBlock {
+	public:
+		ScopedProfilerBlock(Profiler* profiler, int numSamples) noexcept : profiler{ profiler } {
+			if (profiler != nullptr)
+				profiler->BeginBlock(numSamples);
+		}
+		~ScopedProfilerBlock() noexcept {
+			if (profiler != nullptr)
+				profiler->EndBlock();
+		}
+		ScopedProfilerBlock(const ScopedProfilerBlock&) = delete;
+		ScopedProfilerBlock& operator=(const ScopedProfilerBlock&) = delete;
+	private:
+		Profiler* profiler;
+	};
+}
+
+#if PENNY_PROFILING
+	/** Profile the rest of the scope as one callback of numSamples samples, profiler can be null. */
+	#define PENNY_PROFILE_BLOCK(profiler, numSamples) Penny::ScopedProfilerBlock pennyProfilerBlock{ profiler, numSamples }
+	/** Charge the time since the previous lap to stage, profiler can be null. */
+	#define PENNY_PROFILE_LAP(profiler, stage) do { if ((profiler) != nullptr) (profiler)->Lap(stage); } while (false)
+#else
+	#define PENNY_PROFILE_BLOCK(profiler, numSamples)
+	#define PENNY_PROFILE_LAP(profiler, stage) do {} while (false)
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace Penny {
+	/**
+	 * Mark the calling thread as real time for the lifetime of the object, put one at the top of the audio callback.
+	 * PennyDSP asserts when it would allocate inside this scope, and PENNY_DEFINE_REALTIME_ALLOCATION_CHECK
+	 * extends the check to every operator new.
+	 */
+	class ScopedRealtimeCheck {
+	public:
+		ScopedRealtimeCheck() noexcept : previous{ GetFlag() } { GetFlag() = true; }
+		~ScopedRealtimeCheck() noexcept { GetFlag() = previous; }
+		ScopedRealtimeCheck(const ScopedRealtimeCheck&) = delete;
+		ScopedRealtimeCheck& operator=(const ScopedRealtimeCheck&) = delete;
+
+		/** True if the calling thread is inside a ScopedRealtimeCheck. */
+		static bool IsRealtimeThread() noexcept { return GetFlag(); }
+	private:
+		static bool& GetFlag() noexcept {
+			static thread_local bool isRealtime = false;
+			return isRealtime;
+		}
+	private:
+		bool previous;
+	};
+}
+
+/** Assert the calling thread is not inside a ScopedRealtimeCheck, before anything that allocates. */
+#define PENNY_ASSERT_NOT_REALTIME() jassert(!Penny::ScopedRealtimeCheck::IsRealtimeThread())
+
+/**
+ * Replace the global operator new and delete to assert inside a ScopedRealtimeCheck.
+ * Expand it once, in a single translation unit of a debug build. juce::HeapBlock uses malloc and is not covered,
+ * PennyDSP checks its own allocations with PENNY_ASSERT_NOT_REALTIME.
+ */
+#define PENNY_DEFINE_REALTIME_ALLOCATION_CHECK \
+	void* operator new(std::size_t size) { \
+		PENNY_ASSERT_NOT_REALTIME(); \
+		if (void* ptr = std::malloc(size == 0 ? 1 : size)) \
+			return ptr; \
+		throw std::bad_alloc{}; \
+	} \
+	void* operator new[](std::size_t size) { return operator new(size); } \
+	void operator delete(void* ptr) noexcept { if (ptr != nullptr) PENNY_ASSERT_NOT_REALTIME(); std::free(ptr); } \
+	void operator delete[](void* ptr) noexcept { operator delete(ptr); } \
+	void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); } \
+	void operator delete[](void* ptr, std::size_t) noexcept { operator delete(ptr); }
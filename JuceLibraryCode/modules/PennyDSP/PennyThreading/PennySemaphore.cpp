@@ -0,0 +1,26 @@
+#include "PennySemaphore.h"
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+
+namespace Penny {
+	void* Semaphore::CreateWin32Semaphore() noexcept {
+		return CreateSemaphoreW(nullptr, 0, 0x7fffffff, nullptr);
+	}
+	void Semaphore::CloseWin32Semaphore(void* handle) noexcept {
+		CloseHandle(handle);
+	}
+	void Semaphore::WaitWin32Semaphore(void* handle) noexcept {
+		WaitForSingleObject(handle, INFINITE);
+	}
+	void Semaphore::PostWin32Semaphore(void* handle) noexcept {
+		ReleaseSemaphore(handle, 1, nullptr);
+	}
+}
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+
+#if defined(__APPLE__)
+	#include <dispatch/dispatch.h>
+#elif !defined(_WIN32)
+	#include <semaphore.h>
+#endif
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace Penny {
+	/**
+	 * Counting semaphore whose Signal never takes a lock, so the audio thread can wake a worker.
+	 * The count is an atomic, the semaphore of the OS is only posted when a thread is asleep in Wait,
+	 * and posting it is a single system call (futex, Mach semaphore or kernel object), never a mutex.
+	 */
+	class Semaphore {
+	public:
+		Semaphore() {
+#if defined(_WIN32)
+			handle = CreateWin32Semaphore();
+			jassert(handle != nullptr);
+#elif defined(__APPLE__)
+			handle = dispatch_semaphore_create(0);
+			jassert(handle != nullptr);
+#else
+			int result = sem_init(&handle, 0, 0);
+			jassert(result == 0);
+			juce::ignoreUnused(result);
+#endif
+		}
+		~Semaphore() {
+#if defined(_WIN32)
+			CloseWin32Semaphore(handle);
+#elif defined(__APPLE__)
+			dispatch_release(handle);
+#else
+			sem_destroy(&handle);
+#endif
+		}
+		Semaphore(const Semaphore&) = delete;
+		Semaphore& operator=(const Semaphore&) = delete;
+
+		/** Increment the count, wake one waiting thread if there is one. Lock free, real time safe. */
+		void Signal() noexcept {
+			if (count.fetch_add(1, std::memory_order_release) < 0)
+				Post();
+		}
+		/** Decrement the count, sleep until a Signal if it was not positive. */
+		void Wait() noexcept {
+			if (count.fetch_sub(1, std::memory_order_acquire) > 0)
+				return;
+#if defined(_WIN32)
+			WaitWin32Semaphore(handle);
+#elif defined(__APPLE__)
+			dispatch_semaphore_wait(handle, DISPATCH_TIME_FOREVER);
+#else
+			while (sem_wait(&handle) != 0 && errno == EINTR) {}
+#endif
+		}
+	private:
+		void Post() noexcept {
+#if defined(_WIN32)
+			PostWin32Semaphore(handle);
+#elif defined(__APPLE__)
+			dispatch_semaphore_signal(handle);
+#else
+			sem_post(&handle);
+#endif
+		}
+	private:
+		// Negative when threads are asleep in Wait, minus their number.
+		std::atomic<int> count{ 0 };
+#if defined(_WIN32)
+		// The Win32 calls are in PennySemaphore.cpp, so windows.h is not included by every file using the module.
+		static void* CreateWin32Semaphore() noexcept;
+		static void CloseWin32Semaphore(void* handle) noexcept;
+		static void WaitWin32Semaphore(void* handle) noexcept;
+		static void PostWin32Semaphore(void* handle) noexcept;
+		void* handle = nullptr;
+#elif defined(__APPLE__)
+		dispatch_semaphore_t handle = nullptr;
+#else
+		sem_t handle{};
+#endif
+	};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace Penny {
+	/**
+	 * Lock free triple buffer, one writer thread publishes values and one reader thread takes the latest one.
+	 * The writer fills the back slot and swaps it with the middle one, the reader swaps its front slot with the middle one
+	 * only when something new was published, so a reader with nothing new does a single acquire load.
+	 * Neither side ever waits, values published faster than the reader takes them are skipped.
+	 */
+	template<typename T>
+	class TripleBuffer {
+		static_assert(std::is_trivially_copyable<T>::value, "T is copied on the writer thread and read as is on the reader thread");
+	public:
+		TripleBuffer() {}
+		/** Construct a triple buffer with every slot set to value, what Get returns before the first Acquire. */
+		explicit TripleBuffer(const T& value) {
+			for (Slot& slot : slots)
+				slot.value = value;
+		}
+
+		//Writer thread
+
+		/** The slot the next Publish sends, only the writer touches it. */
+		T& GetWriteBuffer() noexcept {
+			return slots[backIndex].value;
+		}
+		/** Make the write buffer the latest value, the writer gets another slot to write in. */
+		void Publish() noexcept {
+			backIndex = middle.exchange(backIndex | newBit, std::memory_order_acq_rel) & indexMask;
+		}
+		void Publish(const T& value) noexcept {
+			GetWriteBuffer() = value;
+			Publish();
+		}
+
+		//Reader thread
+
+		/** Take the latest published value if there is one the reader has not seen, true if so. */
+		bool Acquire() noexcept {
+			if ((middle.load(std::memory_order_acquire) & newBit) == 0)
+				return false;
+			frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+			return true;
+		}
+		/** The value taken by the last Acquire. */
+		const T& Get() const noexcept {
+			return slots[frontIndex].value;
+		}
+	private:
+		static constexpr uint32_t indexMask = 3, newBit = 4;
+
+		/** One cache line per slot, the writer and the reader never share one. */
+		struct alignas(64) Slot {
+			T value{};
+		};
+	private:
+		Slot slots[3]{};
+		alignas(64) std::atomic<uint32_t> middle{ 1 };
+		alignas(64) uint32_t frontIndex = 0;
+		alignas(64) uint32_t backIndex = 2;
+	};
+}
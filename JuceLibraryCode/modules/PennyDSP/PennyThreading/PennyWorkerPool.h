@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyThreading/PennySemaphore.h>
+
+namespace Penny {
+	/**
+	 * A unit of work run by a WorkerPool thread. Once pushed, only the worker runs it: the owner can check
+	 * whether it is done without blocking (IsIdle), it never takes the job back.
+	 */
+	class BackgroundJob {
+	public:
+		virtual ~BackgroundJob() = default;
+		virtual void Run() = 0;
+
+		/** Wait until the worker is done with the job. It waits as long as the worker takes, never call it on the audio thread. */
+		void Complete() {
+			while (!IsIdle())
+				std::this_thread::yield();
+		}
+		/** True when the job is neither queued nor running, its results can then be read. Lock free. */
+		inline bool IsIdle() const noexcept { return state.load(std::memory_order_acquire) == Idle; }
+	private:
+		friend class WorkerPool;
+		enum State { Idle, Queued, Running };
+		std::atomic<int> state{ Idle };
+	};
+
+	/**
+	 * Fixed set of worker threads, each one fed by a lock free single producer / single consumer queue.
+	 * A queue must only be pushed to from one thread (the audio thread of the owner). Push wakes the worker
+	 * through a Semaphore, it never takes a lock.
+	 */
+	class WorkerPool {
+	public:
+		WorkerPool(int numThreads, int queueSize = 64) {
+			jassert(numThreads > 0);
+			for (int i = 0; i < numThreads; i++) {
+				workers.push_back(std::make_unique<Worker>(queueSize));
+				workers.back()->startThread();
+			}
+		}
+		~WorkerPool() {
+			for (auto& worker : workers)
+				worker->signalThreadShouldExit();
+			for (auto& worker : workers) {
+				worker->wakeUp.Signal();
+				worker->stopThread(1000);
+			}
+		}
+
+		int GetNumThreads() const {
+			return (int)workers.size();
+		}
+
+		/**
+		 * Queue job on the specified worker, the jobs of one worker are run in the order they are pushed.
+		 * Return false if the queue is full, the job is then left idle: it is never run on the calling thread.
+		 */
+		bool Push(int thread, BackgroundJob& job) {
+			jassert(job.IsIdle());
+			Worker& worker = *workers[thread % workers.size()];
+
+			int start1, size1, start2, size2;
+			worker.fifo.prepareToWrite(1, start1, size1, start2, size2);
+			if (size1 + size2 == 0)
+				return false;
+
+			job.state.store(BackgroundJob::Queued, std::memory_order_release);
+			worker.jobs[size1 > 0 ? start1 : start2] = &job;
+			worker.fifo.finishedWrite(1);
+			worker.wakeUp.Signal();
+			return true;
+		}
+	private:
+		class Worker : public juce::Thread {
+		public:
+			Worker(int queueSize) : juce::Thread{ "Penny Worker" }, fifo{ queueSize }, jobs(queueSize, nullptr) {}
+
+			void run() override {
+				// Every queued job signals the semaphore once, so a wake up always finds a job, unless it is the exit.
+				for (;;) {
+					wakeUp.Wait();
+					if (threadShouldExit())
+						return;
+					int start1, size1, start2, size2;
+					fifo.prepareToRead(1, start1, size1, start2, size2);
+					jassert(size1 + size2 > 0);
+					BackgroundJob* job = jobs[size1 > 0 ? start1 : start2];
+					fifo.finishedRead(1);
+					job->state.store(BackgroundJob::Running, std::memory_order_relaxed);
+					job->Run();
+					job->state.store(BackgroundJob::Idle, std::memory_order_release);
+				}
+			}
+		public:
+			juce::AbstractFifo fifo;
+			std::vector<BackgroundJob*> jobs;
+			Semaphore wakeUp{};
+		};
+	private:
+		std::vector<std::unique_ptr<Worker>> workers{};
+	};
+}
@@ -0,0 +1,434 @@
+/*
+  ==============================================================================
+
+    The DeepReverb processing graph, without the plugin around it.
+
+  ==============================================================================
+*/
+
+#include "DeepReverb.h"
+
+//==============================================================================
+DeepReverbParameters DeepReverbParameters::Make(float feedback, float size, float drywetmixratio)
+{
+    DeepReverbParameters parameters{ feedback, size, drywetmixratio };
+    parameters.initialGain = juce::jmap<float>(feedback, 0.25f, 0.6f);
+    parameters.mainGain = -juce::jmap<float>(feedback, 0.0f, 0.9f);
+    parameters.initialDelayInSeconds = juce::jmap<float>(size, 0.02f, 0.15f);
+    return parameters;
+}
+
+//==============================================================================
+template<typename sT>
+DeepReverb<sT>::DeepReverb()
+{
+    initialAllPass.SetLayout(Penny::DelayLineLayout::Mirrored);
+    mainDelayLine.SetLayout(Penny::DelayLineLayout::Mirrored);
+    ConfigureMainAllPass(mainAllPassReverberator.template Get<0>());
+    ConfigureMainAllPass(mainAllPassReverberator.template Get<1>());
+    ConfigureMainAllPass(mainAllPassReverberator.template Get<2>());
+    ConfigureMainAllPass(mainAllPassReverberator.template Get<3>());
+    ConfigureMainAllPass(mainAllPassReverberator.template Get<4>());
+    drywetMixer.SetMixingType(Penny::DryWetMixingType::Linear);
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetParameters(const DeepReverbParameters& parameters)
+{
+    DeepReverbParameters previous = this->parameters;
+    this->parameters = parameters;
+    if (parameters.feedback != previous.feedback)
+        ApplyFeedback();
+    if (parameters.size != previous.size)
+        ApplySize();
+    if (parameters.drywetmixratio != previous.drywetmixratio)
+        ApplyDryWetMixRatio();
+    if (parameters.feedback != previous.feedback || parameters.size != previous.size)
+        UpdateTailLength();
+}
+
+template<typename sT>
+const DeepReverbParameters& DeepReverb<sT>::GetParameters()
+{
+    return parameters;
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetFeedback(float feedback)
+{
+    SetParameters(DeepReverbParameters::Make(feedback, parameters.size, parameters.drywetmixratio));
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetSize(float size)
+{
+    SetParameters(DeepReverbParameters::Make(parameters.feedback, size, parameters.drywetmixratio));
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetDryWetMixRatio(float ratio)
+{
+    SetParameters(DeepReverbParameters::Make(parameters.feedback, parameters.size, ratio));
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetSubBlockSize(int subBlockSize)
+{
+    jassert(subBlockSize >= 0);
+    this->subBlockSize = subBlockSize;
+}
+
+template<typename sT>
+int DeepReverb<sT>::GetSubBlockSize()
+{
+    return subBlockSize;
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetInternalSampleRate(int internalSampleRate)
+{
+    jassert(internalSampleRate >= 0);
+    this->internalSampleRate = internalSampleRate;
+}
+
+template<typename sT>
+int DeepReverb<sT>::GetInternalSampleRate()
+{
+    return internalSampleRate;
+}
+
+template<typename sT>
+int DeepReverb<sT>::GetLatencyInSamples()
+{
+    return latencyInSamples;
+}
+
+template<typename sT>
+int DeepReverb<sT>::GetTailLengthInSamples()
+{
+    return tailLengthInSamples;
+}
+
+template<typename sT>
+bool DeepReverb<sT>::IsIdle()
+{
+    return isIdle;
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetDenormalProtection(Penny::DenormalProtection protection)
+{
+    denormalProtection = protection;
+    initialAllPass.SetDenormalProtection(protection);
+    mainAllPassReverberator.ForEach([&](Penny::AllPassFilter<sT>& allPass) { allPass.SetDenormalProtection(protection); });
+}
+
+template<typename sT>
+void DeepReverb<sT>::SetProfiler(Penny::Profiler* profiler)
+{
+    this->profiler = profiler;
+    if (profiler == nullptr)
+    {
+        mainAllPassReverberator.SetProfiler(nullptr, 0);
+        return;
+    }
+
+    mixingStage = profiler->AddStage("Dry/wet mix");
+    initialStage = profiler->AddStage("Initial all-pass");
+    mainDelayStage = profiler->AddStage("Main delay");
+    int firstAllPassStage = profiler->AddStage("Main all-pass 1");
+    for (int i = 2; i <= 5; i++)
+        profiler->AddStage("Main all-pass " + std::to_string(i));
+    mainAllPassReverberator.SetProfiler(profiler, firstAllPassStage);
+    mainFeedbackStage = profiler->AddStage("Main feedback");
+    resamplingStage = profiler->AddStage("Resampling");
+}
+
+//==============================================================================
+template<typename sT>
+void DeepReverb<sT>::Prepare(int sampleRate, int samplesPerBlock)
+{
+    ownArena.Layout([&] { Prepare(sampleRate, samplesPerBlock, ownArena); });
+}
+
+template<typename sT>
+void DeepReverb<sT>::Prepare(int sampleRate, int samplesPerBlock, Penny::Arena& arena)
+{
+    hostSampleRate = sampleRate;
+    this->samplesPerBlock = samplesPerBlock;
+    isResampling = internalSampleRate != 0 && internalSampleRate != hostSampleRate;
+    this->sampleRate = isResampling ? internalSampleRate : hostSampleRate;
+
+    int internalBlockSize = samplesPerBlock;
+    latencyInSamples = 0;
+    if (isResampling)
+    {
+        downsampler.SetOutputSampleRate(internalSampleRate);
+        downsampler.Prepare(hostSampleRate, samplesPerBlock, arena);
+        internalBlockSize = downsampler.GetMaxOutputSamples(samplesPerBlock);
+        upsampler.SetOutputSampleRate(hostSampleRate);
+        upsampler.Prepare(internalSampleRate, internalBlockSize, arena);
+
+        arena.AllocateBuffer(internalBuffer, numChannels, internalBlockSize);
+        arena.AllocateBuffer(upsampledBuffer, numChannels, upsampler.GetMaxOutputSamples(internalBlockSize) + hostSampleRate / internalSampleRate + 2);
+        latencyInSamples = (int)std::lround(downsampler.GetLatencyInSamples()
+            + upsampler.GetLatencyInSamples() * hostSampleRate / internalSampleRate);
+    }
+    // The graph only ever sees sub-blocks, its buffers are sized for them. The main loop reads its delay line
+    // before pushing the sub-block, so a sub-block can't be longer than the loop delay.
+    graphBlockSize = subBlockSize == 0 ? internalBlockSize : juce::jmin(subBlockSize, internalBlockSize);
+    graphBlockSize = juce::jmin(graphBlockSize, (int)(this->sampleRate * mainDelayInSeconds));
+
+    mainAllPassReverberator.template Get<0>().SetDelay(this->sampleRate * 0.0723f);
+    mainAllPassReverberator.template Get<1>().SetDelay(this->sampleRate * 0.0934f);
+    mainAllPassReverberator.template Get<2>().SetDelay(this->sampleRate * 0.0633f);
+    mainAllPassReverberator.template Get<3>().SetDelay(this->sampleRate * 0.0337f);
+    mainAllPassReverberator.template Get<4>().SetDelay(this->sampleRate * 0.1340f);
+
+    initialAllPass.Prepare(this->sampleRate, graphBlockSize, arena);
+    arena.AllocateBuffer(mainAudioBuffer, numChannels, graphBlockSize);
+    arena.AllocateBuffer(delayedMainAudioBuffer, numChannels, graphBlockSize);
+    mainDelayLine.Prepare(this->sampleRate, graphBlockSize, arena);
+    mainAllPassReverberator.Prepare(this->sampleRate, graphBlockSize, arena);
+    // Resampled, the dry signal is mixed at the host rate once per host block.
+    drywetMixer.Prepare(hostSampleRate, isResampling ? samplesPerBlock : graphBlockSize, arena);
+
+    ApplyFeedback();
+    ApplySize();
+    ApplyDryWetMixRatio();
+    UpdateTailLength();
+
+    // Start from the configured values instead of ramping from the defaults.
+    Reset();
+}
+
+template<typename sT>
+void DeepReverb<sT>::Process(Penny::AudioBufferView<sT>& buffer)
+{
+    // An idle graph is skipped until the input comes back, and wakes up on the first block that is not silent.
+    if (buffer.GetPeak() > silenceThreshold)
+    {
+        silentSamples = 0;
+        nextStateCheck = 0;
+        isIdle = false;
+    }
+    else if (isIdle)
+    {
+        buffer.Clear();
+        ClearNextComponent();
+        return;
+    }
+    else
+    {
+        silentSamples = (int)juce::jmin((long long)silentSamples + buffer.GetNumSamples(), (long long)std::numeric_limits<int>::max());
+    }
+
+    // One scope for the whole graph, the components nested in it find the mode already set.
+    Penny::ScopedFlushDenormals flushDenormals{ denormalProtection == Penny::DenormalProtection::FlushToZero };
+    Penny::ProcessContext<sT> ctx{ buffer };
+    if (isResampling)
+        ctx.ForEachSubBlock(samplesPerBlock, [this](Penny::ProcessContext<sT>& hostCtx) { ProcessResampled(hostCtx); });
+    else
+        // Large blocks go through the whole graph one sub-block at a time so it stays in the L1 cache.
+        ctx.ForEachSubBlock(graphBlockSize, [this](Penny::ProcessContext<sT>& subCtx) { ProcessSubBlock(subCtx); });
+
+    if (silentSamples > 0 && IsTailSilent(buffer))
+    {
+        isIdle = true;
+        numClearedComponents = 0;
+    }
+    noiseFloor = -noiseFloor;
+}
+
+template<typename sT>
+void DeepReverb<sT>::Reset()
+{
+    initialAllPass.Reset();
+    mainDelayLine.Reset();
+    mainAllPassReverberator.Reset();
+    drywetMixer.Reset();
+    if (isResampling)
+    {
+        downsampler.Reset();
+        upsampler.Reset();
+    }
+    numUpsampledSamples = 0;
+    silentSamples = 0;
+    nextStateCheck = 0;
+    isIdle = false;
+}
+
+//==============================================================================
+template<typename sT>
+void DeepReverb<sT>::ConfigureMainAllPass(Penny::AllPassFilter<sT>& allPass)
+{
+    allPass.SetChannelsNumber(numChannels);
+    allPass.SetMaxDelay(maxDelayInSamples);
+    allPass.SetLayout(Penny::DelayLineLayout::Mirrored);
+    allPass.SetGain(1);
+}
+
+template<typename sT>
+void DeepReverb<sT>::ApplyFeedback()
+{
+    initialAllPass.SetGain(parameters.initialGain);
+    mainGain = (sT)parameters.mainGain;
+}
+
+template<typename sT>
+void DeepReverb<sT>::ApplySize()
+{
+    initialAllPass.SetDelay(sampleRate * parameters.initialDelayInSeconds);
+}
+
+template<typename sT>
+void DeepReverb<sT>::ApplyDryWetMixRatio()
+{
+    drywetMixer.SetMixingRatio(parameters.drywetmixratio);
+}
+
+template<typename sT>
+void DeepReverb<sT>::UpdateTailLength()
+{
+    constexpr double silenceInDecibels = 120.0;
+    long long tailLength = initialAllPass.GetTailLengthInSamples(silenceInDecibels);
+    tailLength += Penny::CombFilter<sT>::ComputeTailLength(parameters.mainGain, sampleRate * mainDelayInSeconds, silenceInDecibels);
+    mainAllPassReverberator.ForEach([&](Penny::AllPassFilter<sT>& allPass) { tailLength += allPass.GetTailLengthInSamples(silenceInDecibels); });
+
+    // In host samples, plus what is still in the resamplers.
+    double hostTailLength = (double)tailLength * hostSampleRate / sampleRate + latencyInSamples;
+    tailLengthInSamples = (int)juce::jmin(hostTailLength, (double)std::numeric_limits<int>::max());
+}
+
+template<typename sT>
+bool DeepReverb<sT>::IsTailSilent(const Penny::AudioBufferView<sT>& output)
+{
+    if (silentSamples >= tailLengthInSamples)
+        return true;
+
+    // The worst case tail is seconds long, the feedback stages are measured every 50ms once the input has left
+    // the resamplers and the dry delay.
+    if (silentSamples < latencyInSamples + samplesPerBlock || silentSamples < nextStateCheck)
+        return false;
+    nextStateCheck = silentSamples + hostSampleRate / 20;
+    if (output.GetPeak() > silenceThreshold)
+        return false;
+
+    sT statePeak = juce::jmax(initialAllPass.GetStatePeak(), mainDelayLine.GetPeak((int)(sampleRate * mainDelayInSeconds)));
+    mainAllPassReverberator.ForEach([&](Penny::AllPassFilter<sT>& allPass) { statePeak = juce::jmax(statePeak, allPass.GetStatePeak()); });
+    return statePeak <= silenceThreshold;
+}
+
+template<typename sT>
+void DeepReverb<sT>::ClearNextComponent()
+{
+    // What is left is under the silence threshold, it only has to be gone by the time the graph wakes up again.
+    constexpr int numMainAllPasses = (int)decltype(mainAllPassReverberator)::numStages;
+    if (numClearedComponents > 3 + numMainAllPasses)
+        return;
+    int component = numClearedComponents++;
+    if (component == 0)
+        initialAllPass.Reset();
+    else if (component == 1)
+        mainDelayLine.Reset();
+    else if (component < 2 + numMainAllPasses)
+    {
+        int index = 2;
+        mainAllPassReverberator.ForEach([&](Penny::AllPassFilter<sT>& allPass) { if (index++ == component) allPass.Reset(); });
+    }
+    else if (component == 2 + numMainAllPasses)
+        drywetMixer.Reset();
+    else if (component == 3 + numMainAllPasses && isResampling)
+    {
+        downsampler.Reset();
+        upsampler.Reset();
+        numUpsampledSamples = 0;
+    }
+}
+
+template<typename sT>
+void DeepReverb<sT>::ProcessSubBlock(Penny::ProcessContext<sT>& ctx)
+{
+    Penny::AudioBufferView<sT>& bufferView = ctx.GetOutput();
+
+    drywetMixer.PushDrySamples(bufferView);
+    PENNY_PROFILE_LAP(profiler, mixingStage);
+
+    ProcessTank(ctx);
+
+    //End
+    drywetMixer.DryWetMixing(bufferView, 0);
+    PENNY_PROFILE_LAP(profiler, mixingStage);
+}
+
+template<typename sT>
+void DeepReverb<sT>::ProcessResampled(Penny::ProcessContext<sT>& ctx)
+{
+    Penny::AudioBufferView<sT>& bufferView = ctx.GetOutput();
+    int numSamples = bufferView.GetNumSamples();
+
+    drywetMixer.PushDrySamples(bufferView);
+    PENNY_PROFILE_LAP(profiler, mixingStage);
+
+    Penny::AudioBufferView<sT> internalView{ internalBuffer };
+    Penny::AudioBufferView<sT> tankView = internalView.GetSubView(0, downsampler.Process(bufferView, internalView));
+    PENNY_PROFILE_LAP(profiler, resamplingStage);
+
+    Penny::ProcessContext<sT> tankCtx{ tankView };
+    tankCtx.ForEachSubBlock(graphBlockSize, [this](Penny::ProcessContext<sT>& subCtx) { ProcessTank(subCtx); });
+
+    // The upsampler writes after the samples left from the previous block, the extra ones are kept for the next.
+    Penny::AudioBufferView<sT> upsampledView{ upsampledBuffer };
+    Penny::AudioBufferView<sT> freeView = upsampledView.GetOffsetView(numUpsampledSamples);
+    numUpsampledSamples += upsampler.Process(tankView, freeView);
+    jassert(numUpsampledSamples >= numSamples);
+
+    bufferView.CopyFrom(upsampledView.GetSubView(0, numSamples));
+    numUpsampledSamples -= numSamples;
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        sT* data = upsampledBuffer.getWritePointer(channel);
+        memmove(data, data + numSamples, sizeof(sT) * numUpsampledSamples);
+    }
+    PENNY_PROFILE_LAP(profiler, resamplingStage);
+
+    // The dry signal is delayed as much as the wet one to stay aligned with the reported latency.
+    drywetMixer.DryWetMixing(bufferView, latencyInSamples);
+    PENNY_PROFILE_LAP(profiler, mixingStage);
+}
+
+template<typename sT>
+void DeepReverb<sT>::ProcessTank(Penny::ProcessContext<sT>& ctx)
+{
+    Penny::AudioBufferView<sT>& bufferView = ctx.GetOutput();
+    int numSamples = bufferView.GetNumSamples();
+
+    //Initial
+    initialAllPass.Process(ctx);
+    PENNY_PROFILE_LAP(profiler, initialStage);
+    //Main
+    Penny::AudioBufferView<sT> mainAudioBufferView{ mainAudioBuffer, 0, numSamples };
+    mainAudioBufferView.CopyFrom(bufferView);
+
+    // Popped before the sub-block is pushed, so the read is pulled in by its length to keep the loop delay
+    // the same whatever the block size.
+    mainDelayLine.PopSamples(bufferView, (int)(sampleRate * mainDelayInSeconds) - numSamples);
+    PENNY_PROFILE_LAP(profiler, mainDelayStage);
+
+    mainAllPassReverberator.Process(ctx);
+
+    Penny::AudioBufferView<sT> delayedMainAudioBufferView{ delayedMainAudioBuffer, 0, numSamples };
+    delayedMainAudioBufferView.CopyFrom(bufferView);
+    delayedMainAudioBufferView.LinearCombination(mainAudioBufferView, 1, mainGain);
+    if (denormalProtection == Penny::DenormalProtection::NoiseFloor)
+        delayedMainAudioBufferView += noiseFloor;
+
+    mainDelayLine.PushSamples(delayedMainAudioBufferView);
+
+    bufferView.LinearCombination(mainAudioBufferView, -mainGain, 1 - (mainGain * mainGain));
+    PENNY_PROFILE_LAP(profiler, mainFeedbackStage);
+}
+
+//==============================================================================
+template class DeepReverb<float>;
+template class DeepReverb<double>;
@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    The DeepReverb processing graph, without the plugin around it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+//==============================================================================
+/** The parameters of DeepReverb and the coefficients derived from them, a plain struct to be built off the audio thread. */
+struct DeepReverbParameters
+{
+    float feedback = 0.5f, size = 0.5f, drywetmixratio = 0.5f;
+    //Derived
+    float initialGain = 0.0f, initialDelayInSeconds = 0.0f, mainGain = 0.0f;
+
+    /** Map feedback, size and the dry/wet mix ratio, from 0 to 1, to the coefficients of the graph. */
+    static DeepReverbParameters Make(float feedback, float size, float drywetmixratio);
+};
+
+//==============================================================================
+/**
+    Initial all-pass, main delay loop through five all-pass reverberators, then dry/wet mix.
+    The plugin runs one, the batch renderer runs many of them with their memory carved out of a shared arena.
+    Instantiated for float and double, double keeps the long feedback loops from accumulating float rounding.
+*/
+template<typename sT>
+class DeepReverb
+{
+public:
+    using SampleType = sT;
+    static constexpr int numChannels = 2;
+    static constexpr int maxDelayInSamples = 44110;
+    /** Input and tail peaks under it count as silence, -120dB. */
+    static constexpr float silenceThreshold = 1e-6f;
+public:
+    DeepReverb();
+
+    /** Set every parameter at once, only the components whose parameter changed are updated. */
+    void SetParameters(const DeepReverbParameters& parameters);
+    const DeepReverbParameters& GetParameters();
+
+    /** Set the feedback, from 0 to 1. */
+    void SetFeedback(float feedback);
+    /** Set the size, from 0 to 1. */
+    void SetSize(float size);
+    void SetDryWetMixRatio(float ratio);
+
+    /** Set the length of the sub-blocks the graph processes, 0 for the whole block, capped to the 67ms main loop delay. It takes effect at the next Prepare. */
+    void SetSubBlockSize(int subBlockSize);
+    int GetSubBlockSize();
+    /**
+        Run the graph at internalSampleRate whatever the host rate, the host blocks are resampled around it.
+        0 (the default) runs it at the host rate. It takes effect at the next Prepare.
+    */
+    void SetInternalSampleRate(int internalSampleRate);
+    int GetInternalSampleRate();
+    /** The latency added by the resampling, in host samples, 0 at the host rate. Known after Prepare. */
+    int GetLatencyInSamples();
+    /**
+        Host samples for the output to decay under the silence threshold once the input stops, from the feedback
+        gains and delays of every stage. It follows the parameters, known after Prepare.
+    */
+    int GetTailLengthInSamples();
+    /** True once the input and the tail are silent, Process then only outputs zeros until the input comes back. */
+    bool IsIdle();
+    /**
+        Set how the feedback loops are kept from decaying through denormals. FlushToZero (the default) sets the CPU mode
+        for the duration of Process, the caller does not need to. NoiseFloor leaves the mode alone and keeps
+        the loops above the denormals instead.
+    */
+    void SetDenormalProtection(Penny::DenormalProtection protection);
+    /** Add the stages of the graph to profiler and lap it after each of them, nullptr to stop. Not while processing. */
+    void SetProfiler(Penny::Profiler* profiler);
+
+    void Prepare(int sampleRate, int samplesPerBlock);
+    /** Same as Prepare, with every delay line and scratch buffer of the graph allocated from arena. */
+    void Prepare(int sampleRate, int samplesPerBlock, Penny::Arena& arena);
+    /** Process numChannels channels in place, blocks longer than the prepared one are split. */
+    void Process(Penny::AudioBufferView<sT>& buffer);
+    void Reset();
+
+private:
+    void ConfigureMainAllPass(Penny::AllPassFilter<sT>& allPass);
+    void ApplyFeedback();
+    void ApplySize();
+    void ApplyDryWetMixRatio();
+    void UpdateTailLength();
+    /** Whether the tail has decayed, from the silence length or by measuring what every feedback stage holds. */
+    bool IsTailSilent(const Penny::AudioBufferView<sT>& output);
+    /** Clear one more component, once per idle block so that no block pays for clearing the whole graph. */
+    void ClearNextComponent();
+    void ProcessSubBlock(Penny::ProcessContext<sT>& ctx);
+    void ProcessResampled(Penny::ProcessContext<sT>& ctx);
+    /** Everything between the dry push and the dry/wet mix. */
+    void ProcessTank(Penny::ProcessContext<sT>& ctx);
+
+    //Parameters
+    DeepReverbParameters parameters = DeepReverbParameters::Make(0.5f, 0.5f, 0.5f);
+    sT mainGain = (sT)-0.45;
+    //Var
+    /** Rate the graph runs at, the host rate unless it is resampled. */
+    int sampleRate = 44100, samplesPerBlock = 0;
+    int hostSampleRate = 44100;
+    int subBlockSize = 256, graphBlockSize = 0;
+    Penny::Arena ownArena{};
+    Penny::DenormalProtection denormalProtection = Penny::DenormalProtection::FlushToZero;
+    sT noiseFloor = (sT)Penny::denormalNoiseFloor;
+    //Profiling
+    Penny::Profiler* profiler = nullptr;
+    int initialStage = 0, mainDelayStage = 0, mainFeedbackStage = 0, mixingStage = 0, resamplingStage = 0;
+    //Resampling
+    int internalSampleRate = 0, latencyInSamples = 0;
+    bool isResampling = false;
+    Penny::Resampler<sT> downsampler{ numChannels }, upsampler{ numChannels };
+    juce::AudioBuffer<sT> internalBuffer{};
+    /** Upsampled samples not output yet, the upsampler can be a few samples ahead of the host. */
+    juce::AudioBuffer<sT> upsampledBuffer{};
+    int numUpsampledSamples = 0;
+    //Silence
+    int tailLengthInSamples = 0;
+    /** Host samples since the input was last above the silence threshold. */
+    int silentSamples = 0;
+    int nextStateCheck = 0;
+    bool isIdle = false;
+    int numClearedComponents = 0;
+    //Initial
+    Penny::AllPassFilter<sT> initialAllPass{ numChannels, maxDelayInSamples };
+    //Main
+    static constexpr float mainDelayInSeconds = 0.067f;
+    juce::AudioBuffer<sT> mainAudioBuffer{};
+    juce::AudioBuffer<sT> delayedMainAudioBuffer{};
+    Penny::DelayLine<sT> mainDelayLine{ numChannels, maxDelayInSamples };
+
+    Penny::Chain<Penny::AllPassFilter<sT>, Penny::AllPassFilter<sT>, Penny::AllPassFilter<sT>,
+        Penny::AllPassFilter<sT>, Penny::AllPassFilter<sT>> mainAllPassReverberator{};
+    //Other
+    Penny::DryWetMixer<sT> drywetMixer{ numChannels, maxDelayInSamples };
+};
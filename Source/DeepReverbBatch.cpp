@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    Offline rendering of many DeepReverb voices across threads.
+
+  ==============================================================================
+*/
+
+#include "DeepReverbBatch.h"
+
+//==============================================================================
+DeepReverbBatch::DeepReverbBatch(int numVoices, int numThreads)
+    : numVoices{ numVoices }, voices{ new Voice[(size_t)numVoices] }, workerPool{ numThreads }
+{
+    jassert(numVoices > 0);
+    for (int i = 0; i < numThreads; i++)
+        jobs.push_back(std::make_unique<RenderJob>(*this));
+}
+
+DeepReverbBatch::~DeepReverbBatch()
+{
+    for (auto& job : jobs)
+        job->Complete();
+}
+
+int DeepReverbBatch::GetNumVoices()
+{
+    return numVoices;
+}
+
+int DeepReverbBatch::GetNumThreads()
+{
+    return workerPool.GetNumThreads();
+}
+
+DeepReverb<float>& DeepReverbBatch::GetVoice(int voice)
+{
+    jassert(voice >= 0 && voice < numVoices);
+    return voices[voice].reverb;
+}
+
+//==============================================================================
+void DeepReverbBatch::Prepare(int sampleRate, int samplesPerBlock)
+{
+    this->samplesPerBlock = samplesPerBlock;
+
+    // Each voice gets one contiguous, cache line aligned run of the arena, and the voices themselves are padded
+    // to whole lines, so threads never share a line.
+    arena.Layout([&] {
+        for (int i = 0; i < numVoices; i++)
+            voices[i].reverb.Prepare(sampleRate, samplesPerBlock, arena);
+    });
+}
+
+void DeepReverbBatch::Render(juce::AudioBuffer<float>* const* buffers)
+{
+    this->buffers = buffers;
+    nextVoice.store(0, std::memory_order_relaxed);
+
+    for (int i = 0; i < (int)jobs.size(); i++)
+        workerPool.Push(i, *jobs[i]);
+
+    RenderVoices();
+
+    // A job no worker started yet finds no voice left and returns at once.
+    for (auto& job : jobs)
+        job->Complete();
+    this->buffers = nullptr;
+}
+
+void DeepReverbBatch::Reset()
+{
+    for (int i = 0; i < numVoices; i++)
+        voices[i].reverb.Reset();
+}
+
+//==============================================================================
+void DeepReverbBatch::RenderVoices()
+{
+    for (int voice = nextVoice.fetch_add(1, std::memory_order_relaxed); voice < numVoices;
+         voice = nextVoice.fetch_add(1, std::memory_order_relaxed))
+        RenderVoice(voice, *buffers[voice]);
+}
+
+void DeepReverbBatch::RenderVoice(int voice, juce::AudioBuffer<float>& buffer)
+{
+    jassert(buffer.getNumChannels() == DeepReverb<float>::numChannels);
+
+    for (int offset = 0; offset < buffer.getNumSamples(); offset += samplesPerBlock)
+    {
+        Penny::AudioBufferView<float> block{ buffer, offset, juce::jmin(samplesPerBlock, buffer.getNumSamples() - offset) };
+        voices[voice].reverb.Process(block);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    Offline rendering of many DeepReverb voices across threads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+#include "DeepReverb.h"
+
+//==============================================================================
+/**
+    Owns numVoices DeepReverb graphs in a single array, with the memory of all of them carved out of one arena.
+    Render processes every voice over its own buffer, the voices being shared between the worker threads and
+    the calling thread: whoever is free takes the next voice, so long buffers do not leave threads idle.
+*/
+class DeepReverbBatch
+{
+public:
+    /** numThreads worker threads are started, the calling thread of Render works too. */
+    DeepReverbBatch(int numVoices, int numThreads);
+    ~DeepReverbBatch();
+
+    int GetNumVoices();
+    int GetNumThreads();
+    /** Get a voice to configure it, between Render calls only. */
+    DeepReverb<float>& GetVoice(int voice);
+
+    void Prepare(int sampleRate, int samplesPerBlock);
+    /**
+        Process buffers[i] in place through voice i, samplesPerBlock samples at a time.
+        Every buffer holds DeepReverb<float>::numChannels channels, their lengths can differ.
+    */
+    void Render(juce::AudioBuffer<float>* const* buffers);
+    void Reset();
+
+private:
+    /** Claim voices until there are none left, one is queued per worker thread. */
+    class RenderJob : public Penny::BackgroundJob
+    {
+    public:
+        explicit RenderJob(DeepReverbBatch& batch) : batch{ batch } {}
+        void Run() override { batch.RenderVoices(); }
+    private:
+        DeepReverbBatch& batch;
+    };
+
+    /** A voice on cache lines of its own, the state it writes in Process is never next to another voice's. */
+    struct alignas(64) Voice
+    {
+        DeepReverb<float> reverb;
+    };
+
+    void RenderVoices();
+    void RenderVoice(int voice, juce::AudioBuffer<float>& buffer);
+
+    int numVoices;
+    int samplesPerBlock = 0;
+    std::unique_ptr<Voice[]> voices;
+    Penny::Arena arena{};
+    Penny::WorkerPool workerPool;
+    std::vector<std::unique_ptr<RenderJob>> jobs{};
+    //State of the current Render
+    juce::AudioBuffer<float>* const* buffers = nullptr;
+    std::atomic<int> nextVoice{ 0 };
+};
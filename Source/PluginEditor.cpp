@@ -13,7 +13,7 @@
 PennyDeepReverbAudioProcessorEditor::PennyDeepReverbAudioProcessorEditor(PennyDeepReverbAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
     : AudioProcessorEditor(&p), audioProcessor(p), valueTreeState{ vts }
 {
-    setSize (300, 150);
+    setSize (300, 175);
 
     titleLabel.setJustificationType(juce::Justification::centred);
     titleLabel.setFont(juce::Font{ 25.0f, juce::Font::bold });
@@ -41,6 +41,20 @@ PennyDeepReverbAudioProcessorEditor::PennyDeepReverbAudioProcessorEditor(PennyDe
     addAndMakeVisible(reverbfeedbackLabel);
     addAndMakeVisible(reverbsizeLabel);
     addAndMakeVisible(drywetLabel);
+
+    // Item ids are the tank rates in Hz, 1 stands for the host rate since 0 is not a valid id.
+    tankRateLabel.setFont(juce::Font{ 13.0f, juce::Font::bold });
+    tankRateBox.addItem("Host rate", 1);
+    tankRateBox.addItem("44.1 kHz", 44100);
+    tankRateBox.addItem("48 kHz", 48000);
+    tankRateBox.setSelectedId(juce::jmax(1, audioProcessor.GetTankSampleRate()), juce::dontSendNotification);
+    tankRateBox.onChange = [this] {
+        int id = tankRateBox.getSelectedId();
+        audioProcessor.SetTankSampleRate(id == 1 ? 0 : id);
+    };
+
+    addAndMakeVisible(tankRateLabel);
+    addAndMakeVisible(tankRateBox);
 }
 
 PennyDeepReverbAudioProcessorEditor::~PennyDeepReverbAudioProcessorEditor()
@@ -57,10 +71,14 @@ void PennyDeepReverbAudioProcessorEditor::resized()
 {
     juce::Rectangle<int> localBounds = getLocalBounds();
     juce::Rectangle<int> headerBounds = localBounds.removeFromTop(headerHeight);
+    juce::Rectangle<int> optionsBounds = localBounds.removeFromBottom(optionsHeight);
     juce::Rectangle<int> footerBounds = localBounds.removeFromBottom(footerHeight);
 
     titleLabel.setBounds(headerBounds);
 
+    tankRateLabel.setBounds(optionsBounds.removeFromLeft(optionsBounds.getWidth() / 2));
+    tankRateBox.setBounds(optionsBounds.reduced(2));
+
     reverbfeedbackSlider.setBounds(localBounds.removeFromLeft(localBounds.getHeight()));
     reverbsizeSlider.setBounds(localBounds.removeFromLeft(localBounds.getHeight()));
 
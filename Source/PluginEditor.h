@@ -29,6 +29,7 @@ public:
 private:
     int headerHeight = 50;
     int footerHeight = 25;
+    int optionsHeight = 25;
 
     juce::Label titleLabel{ "titleLabel", "PENNY DEEP REVERB" };
 
@@ -42,6 +43,9 @@ private:
     
     juce::Label drywetLabel{ "drywetLabel", "Dry/Wet" };
 
+    juce::Label tankRateLabel{ "tankRateLabel", "Tank rate" };
+    juce::ComboBox tankRateBox{ "tankRateBox" };
+
     juce::AudioProcessorValueTreeState& valueTreeState;
 
     std::unique_ptr<SliderAttachement> feedbackSliderAttachement;
@@ -9,6 +9,13 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#if JUCE_DEBUG && PENNY_REALTIME_ALLOCATION_CHECK
+PENNY_DEFINE_REALTIME_ALLOCATION_CHECK
+#endif
+
+// Not a parameter, the host cannot automate it, it is a property of the saved state.
+static const juce::Identifier tankSampleRateID{ "TankSampleRate" };
+
 //==============================================================================
 PennyDeepReverbAudioProcessor::PennyDeepReverbAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -26,10 +33,24 @@ PennyDeepReverbAudioProcessor::PennyDeepReverbAudioProcessor()
     feedbackvalue = parameters.getRawParameterValue("FeedbackValue");
     sizevalue = parameters.getRawParameterValue("SizeValue");
     drywetmixratio = parameters.getRawParameterValue("DryWetMixRatio");
+    for (auto* parameter : getParameters())
+        if (auto* parameterWithID = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+            parameters.addParameterListener(parameterWithID->paramID, this);
+
+   #if PENNY_PROFILING
+    profiler = std::make_unique<Penny::Profiler>();
+    parametersStage = profiler->AddStage("Parameters");
+    deepReverb.SetProfiler(profiler.get());
+    doubleDeepReverb.SetProfiler(profiler.get());
+    profilerCollector = std::make_unique<ProfilerCollector>(*profiler);
+   #endif
 }
 
 PennyDeepReverbAudioProcessor::~PennyDeepReverbAudioProcessor()
 {
+    for (auto* parameter : getParameters())
+        if (auto* parameterWithID = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+            parameters.removeParameterListener(parameterWithID->paramID, this);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout PennyDeepReverbAudioProcessor::createParameterLayout()
@@ -79,7 +100,7 @@ bool PennyDeepReverbAudioProcessor::isMidiEffect() const
 
 double PennyDeepReverbAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load(std::memory_order_relaxed);
 }
 
 int PennyDeepReverbAudioProcessor::getNumPrograms()
@@ -111,41 +132,34 @@ void PennyDeepReverbAudioProcessor::prepareToPlay (double sampleRate, int sample
     this->sampleRate = sampleRate;
     this->samplesPerBlock = samplesPerBlock;
 
-    initialAllPass.Prepare(sampleRate, samplesPerBlock);
-    initialAllPass.SetDelay(sampleRate * juce::jmap<float>(*sizevalue, 0.02f, 0.15f));
-    initialAllPass.SetGain(juce::jmap<float>(*feedbackvalue, 0.25f, 0.6f));
-
-    mainAudioBuffer.setSize(2, samplesPerBlock);
-    mainAudioBuffer.clear();
-
-    delayedMainAudioBuffer.setSize(2, samplesPerBlock);
-    delayedMainAudioBuffer.clear();
-
-    mainDelayLine.Prepare(sampleRate, samplesPerBlock);
-
-    mainAllPassReverberator0.Prepare(sampleRate, samplesPerBlock);
-    mainAllPassReverberator0.SetDelay(sampleRate * 0.0723f);
-    mainAllPassReverberator0.SetGain(1);
-
-    mainAllPassReverberator1.Prepare(sampleRate, samplesPerBlock);
-    mainAllPassReverberator1.SetDelay(sampleRate * 0.0934f);
-    mainAllPassReverberator1.SetGain(1);
-
-    mainAllPassReverberator2.Prepare(sampleRate, samplesPerBlock);
-    mainAllPassReverberator2.SetDelay(sampleRate * 0.0633f);
-    mainAllPassReverberator2.SetGain(1);
-
-    mainAllPassReverberator3.Prepare(sampleRate, samplesPerBlock);
-    mainAllPassReverberator3.SetDelay(sampleRate * 0.0337f);
-    mainAllPassReverberator3.SetGain(1);
-
-    mainAllPassReverberator4.Prepare(sampleRate, samplesPerBlock);
-    mainAllPassReverberator4.SetDelay(sampleRate * 0.1340f);
-    mainAllPassReverberator4.SetGain(1);
-
-    drywetMixer.Prepare(sampleRate, samplesPerBlock);
-    drywetMixer.SetMixingRatio(*drywetmixratio);
-    drywetMixer.SetMixingType(Penny::DryWetMixingType::Linear);
+    if (profiler != nullptr)
+        profiler->SetSampleRate(sampleRate);
+
+    int tankSampleRate = GetTankSampleRate();
+    int internalSampleRate = tankSampleRate != 0 && (int)sampleRate > tankSampleRate ? tankSampleRate : 0;
+    deepReverb.SetInternalSampleRate(internalSampleRate);
+    doubleDeepReverb.SetInternalSampleRate(internalSampleRate);
+
+    // The graph starts from the current values, a snapshot published before them is dropped.
+    offlineVersion = parametersVersion.load(std::memory_order_acquire);
+    parameterSnapshots.Acquire();
+
+    // Every delay line and scratch buffer of the graph is carved out of a single block, only the graph
+    // of the precision in use is prepared.
+    if (getProcessingPrecision() == doublePrecision)
+    {
+        doubleDeepReverb.SetParameters(ReadParameters());
+        arena.Layout([&] { doubleDeepReverb.Prepare(sampleRate, samplesPerBlock, arena); });
+        setLatencySamples(doubleDeepReverb.GetLatencyInSamples());
+        UpdateTailLength(doubleDeepReverb);
+    }
+    else
+    {
+        deepReverb.SetParameters(ReadParameters());
+        arena.Layout([&] { deepReverb.Prepare(sampleRate, samplesPerBlock, arena); });
+        setLatencySamples(deepReverb.GetLatencyInSamples());
+        UpdateTailLength(deepReverb);
+    }
 }
 
 void PennyDeepReverbAudioProcessor::releaseResources()
@@ -175,58 +189,109 @@ bool PennyDeepReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& l
 
 void PennyDeepReverbAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    initialAllPass.SetDelay(sampleRate * juce::jmap<float>(*sizevalue, 0.02f, 0.15f));
-    initialAllPass.SetGain(juce::jmap<float>(*feedbackvalue, 0.25f, 0.6f));
-
-    drywetMixer.SetMixingRatio(*drywetmixratio);
-
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-
-    Penny::AudioBufferView<float> bufferView{ buffer };
+    Process(buffer, deepReverb);
+}
 
-    drywetMixer.PushDrySamples(bufferView);
+void PennyDeepReverbAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    Process(buffer, doubleDeepReverb);
+}
 
-    Penny::ProcessContext<float> ctx{ bufferView };
+bool PennyDeepReverbAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
 
-    //Initial
-    initialAllPass.Process(ctx);
-    //Main
-    Penny::AudioBufferView<float> mainAudioBufferView{mainAudioBuffer};
+juce::String PennyDeepReverbAudioProcessor::GetProfilerReport()
+{
+    if (profiler == nullptr)
+        return {};
+    profiler->Collect();
+    return profiler->GetReport();
+}
 
-    for (int i = 0; i < mainAudioBuffer.getNumChannels(); i++)
-        mainAudioBuffer.copyFrom(i, 0, buffer, i, 0, buffer.getNumSamples());
+void PennyDeepReverbAudioProcessor::SetTankSampleRate(int newTankSampleRate)
+{
+    jassert(newTankSampleRate >= 0);
+    if (tankSampleRate.exchange(newTankSampleRate) == newTankSampleRate)
+        return;
+
+    // suspendProcessing takes the callback lock, processBlock is not running while the graph is prepared again.
+    if (sampleRate > 0)
+    {
+        suspendProcessing(true);
+        prepareToPlay(sampleRate, samplesPerBlock);
+        suspendProcessing(false);
+    }
+}
 
-    float mainGain = -juce::jmap<float>(*feedbackvalue, 0.0f, 0.9f);
+void PennyDeepReverbAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    parametersVersion.fetch_add(1, std::memory_order_release);
+}
 
-    mainDelayLine.PopSamples(bufferView, sampleRate * 0.067f);
+DeepReverbParameters PennyDeepReverbAudioProcessor::ReadParameters()
+{
+    return DeepReverbParameters::Make(feedbackvalue->load(std::memory_order_relaxed),
+                                      sizevalue->load(std::memory_order_relaxed),
+                                      drywetmixratio->load(std::memory_order_relaxed));
+}
 
-    mainAllPassReverberator0.Process(ctx);
-    mainAllPassReverberator1.Process(ctx);
+void PennyDeepReverbAudioProcessor::PublishParameters()
+{
+    juce::uint32 version = parametersVersion.load(std::memory_order_acquire);
+    if (version == publishedVersion)
+        return;
+    publishedVersion = version;
+    parameterSnapshots.Publish(ReadParameters());
+}
 
-    mainAllPassReverberator2.Process(ctx);
-    mainAllPassReverberator3.Process(ctx);
-    mainAllPassReverberator4.Process(ctx);
+template<typename sT>
+void PennyDeepReverbAudioProcessor::UpdateParameters(DeepReverb<sT>& reverb)
+{
+    // Offline renders run ahead of the message thread, the snapshot is built on the audio thread instead.
+    if (isNonRealtime())
+    {
+        juce::uint32 version = parametersVersion.load(std::memory_order_acquire);
+        if (version != offlineVersion)
+        {
+            offlineVersion = version;
+            reverb.SetParameters(ReadParameters());
+            UpdateTailLength(reverb);
+        }
+        return;
+    }
+
+    if (parameterSnapshots.Acquire())
+    {
+        reverb.SetParameters(parameterSnapshots.Get());
+        UpdateTailLength(reverb);
+    }
+}
 
-    for (int i = 0; i < delayedMainAudioBuffer.getNumChannels(); i++)
-        delayedMainAudioBuffer.copyFrom(i, 0, buffer, i, 0, buffer.getNumSamples());
+template<typename sT>
+void PennyDeepReverbAudioProcessor::UpdateTailLength(DeepReverb<sT>& reverb)
+{
+    if (sampleRate > 0)
+        tailLengthSeconds.store(reverb.GetTailLengthInSamples() / (double)sampleRate, std::memory_order_relaxed);
+}
 
-    Penny::AudioBufferView<float> delayedMainAudioBufferView{ delayedMainAudioBuffer };
-    delayedMainAudioBufferView *= mainGain;
-    delayedMainAudioBufferView += mainAudioBufferView;
+template<typename sT>
+void PennyDeepReverbAudioProcessor::Process(juce::AudioBuffer<sT>& buffer, DeepReverb<sT>& reverb)
+{
+    Penny::ScopedRealtimeCheck realtimeCheck;
+    PENNY_PROFILE_BLOCK(profiler.get(), buffer.getNumSamples());
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    mainDelayLine.PushSamples(delayedMainAudioBufferView);
+    UpdateParameters(reverb);
 
-    bufferView *= 1 - (mainGain * mainGain);
-    mainAudioBufferView *= -mainGain;
-    bufferView += mainAudioBufferView;
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+    PENNY_PROFILE_LAP(profiler, parametersStage);
 
-    //End
-    drywetMixer.DryWetMixing(bufferView, 0);
+    Penny::AudioBufferView<sT> bufferView{ buffer };
+    reverb.Process(bufferView);
 }
 
 //==============================================================================
@@ -244,6 +309,7 @@ juce::AudioProcessorEditor* PennyDeepReverbAudioProcessor::createEditor()
 void PennyDeepReverbAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     juce::ValueTree state = parameters.copyState();
+    state.setProperty(tankSampleRateID, GetTankSampleRate(), nullptr);
     copyXmlToBinary(*state.createXml(), destData);
 }
 
@@ -253,7 +319,11 @@ void PennyDeepReverbAudioProcessor::setStateInformation (const void* data, int s
 
     if (xmlState.get() != nullptr)
         if (xmlState->hasTagName(parameters.state.getType()))
-            parameters.replaceState(juce::ValueTree::fromXml(*xmlState));
+        {
+            juce::ValueTree state = juce::ValueTree::fromXml(*xmlState);
+            SetTankSampleRate(state.getProperty(tankSampleRateID, 0));
+            parameters.replaceState(state);
+        }
 }
 
 //==============================================================================
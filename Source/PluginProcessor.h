@@ -9,11 +9,13 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "DeepReverb.h"
 
 //==============================================================================
 /**
 */
-class PennyDeepReverbAudioProcessor  : public juce::AudioProcessor
+class PennyDeepReverbAudioProcessor  : public juce::AudioProcessor,
+                                       private juce::AudioProcessorValueTreeState::Listener
 {
 public:
     //==============================================================================
@@ -32,6 +34,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -57,9 +61,49 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     void SetDryWetMixRatio(float ratio) {
-        drywetMixer.SetMixingRatio(ratio);
+        deepReverb.SetDryWetMixRatio(ratio);
+        doubleDeepReverb.SetDryWetMixRatio(ratio);
     }
+    /** Set the length of the sub-blocks the graph processes, 0 for the whole host block. It takes effect at the next prepareToPlay. */
+    void SetSubBlockSize(int subBlockSize) {
+        deepReverb.SetSubBlockSize(subBlockSize);
+        doubleDeepReverb.SetSubBlockSize(subBlockSize);
+    }
+    int GetSubBlockSize() {
+        return deepReverb.GetSubBlockSize();
+    }
+    /**
+        Host rates above tankSampleRate run the graph resampled to it, e.g. 48000 to keep its character the same at
+        96 or 192kHz, with the latency reported to the host. 0 (the default) always runs it at the host rate.
+        It is saved with the state and set from the editor. Message thread, a prepared processor is prepared again
+        with processing suspended, the resampling changes the layout of the graph.
+    */
+    void SetTankSampleRate(int tankSampleRate);
+    int GetTankSampleRate() const {
+        return tankSampleRate.load(std::memory_order_relaxed);
+    }
+    /** The per stage profiler of processBlock, nullptr unless built with PENNY_PROFILING. Read it on the message thread. */
+    Penny::Profiler* GetProfiler() {
+        return profiler.get();
+    }
+    /** The time spent in every stage and the deadline misses since the start, empty unless built with PENNY_PROFILING. Message thread. */
+    juce::String GetProfilerReport();
 private:
+    /** Any thread, bumps the parameters version. */
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    /** The current APVTS values and their coefficients. */
+    DeepReverbParameters ReadParameters();
+    /** Message thread, publish a new snapshot if a parameter changed since the last one. */
+    void PublishParameters();
+    /** Audio thread, hand reverb the latest snapshot if there is one it has not seen. */
+    template<typename sT>
+    void UpdateParameters(DeepReverb<sT>& reverb);
+    /** Store the tail of reverb for getTailLengthSeconds, which the host can call from any thread. */
+    template<typename sT>
+    void UpdateTailLength(DeepReverb<sT>& reverb);
+    template<typename sT>
+    void Process(juce::AudioBuffer<sT>& buffer, DeepReverb<sT>& reverb);
+
     //Parameters
     juce::AudioProcessorValueTreeState parameters;
     std::atomic<float>* feedbackvalue{};
@@ -67,20 +111,33 @@ private:
     std::atomic<float>* drywetmixratio{};
     //Var
     int sampleRate = 0, samplesPerBlock = 0;
-    //Initial
-    Penny::AllPassFilter<float> initialAllPass{ 2, 44110 };
-    //Main
-    juce::AudioBuffer<float> mainAudioBuffer{};
-    juce::AudioBuffer<float> delayedMainAudioBuffer{};
-    Penny::DelayLine<float> mainDelayLine{ 2, 44110 };
-
-    Penny::AllPassFilter<float> mainAllPassReverberator0{ 2, 44110 };
-    Penny::AllPassFilter<float> mainAllPassReverberator1{ 2, 44110 };
-    Penny::AllPassFilter<float> mainAllPassReverberator2{ 2, 44110 };
-    Penny::AllPassFilter<float> mainAllPassReverberator3{ 2, 44110 };
-    Penny::AllPassFilter<float> mainAllPassReverberator4{ 2, 44110 };
-    //Other
-    Penny::DryWetMixer<float> drywetMixer{ 2, 44110 };
+    std::atomic<int> tankSampleRate{ 0 };
+    std::atomic<double> tailLengthSeconds{ 0.0 };
+    //Memory of every delay line and buffer of the graph, laid out in prepareToPlay for the precision the host asked for
+    Penny::Arena arena{};
+    DeepReverb<float> deepReverb{};
+    DeepReverb<double> doubleDeepReverb{};
+    //Profiling, the profiler is drained on the message thread
+    struct ProfilerCollector : public juce::Timer
+    {
+        explicit ProfilerCollector(Penny::Profiler& profiler) : profiler{ profiler } { startTimer(100); }
+        void timerCallback() override { profiler.Collect(); }
+        Penny::Profiler& profiler;
+    };
+    std::unique_ptr<Penny::Profiler> profiler{};
+    std::unique_ptr<ProfilerCollector> profilerCollector{};
+    int parametersStage = 0;
+    //Parameter snapshots, built and published on the message thread, taken by the audio thread
+    struct ParametersPublisher : public juce::Timer
+    {
+        explicit ParametersPublisher(PennyDeepReverbAudioProcessor& processor) : processor{ processor } { startTimer(10); }
+        void timerCallback() override { processor.PublishParameters(); }
+        PennyDeepReverbAudioProcessor& processor;
+    };
+    Penny::TripleBuffer<DeepReverbParameters> parameterSnapshots{};
+    std::atomic<juce::uint32> parametersVersion{ 0 };
+    juce::uint32 publishedVersion = 0, offlineVersion = 0;
+    ParametersPublisher parametersPublisher{ *this };
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PennyDeepReverbAudioProcessor)
 };
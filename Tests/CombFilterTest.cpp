@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    CombFilter must compute the recursion w[n] = x[n] + g * w[n - D], output w[n - D],
+    whatever the block size: for Linear, Lagrange3 and Thiran reads of a fractional
+    delay, every block size is checked bit for bit against the same input processed
+    one sample at a time, and against a per sample reference of the recursion.
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numChannels = 2;
+    constexpr int sampleRate = 48000;
+    constexpr int numSamples = 12000;
+    constexpr int maxDelay = 1000;
+    constexpr float feedbackGain = 0.7f;
+
+    const char* GetName(Penny::DelayInterpolation interpolation)
+    {
+        switch (interpolation)
+        {
+        case Penny::DelayInterpolation::Linear: return "Linear";
+        case Penny::DelayInterpolation::Lagrange3: return "Lagrange3";
+        case Penny::DelayInterpolation::Thiran: return "Thiran";
+        default: return "None";
+        }
+    }
+
+    /** A noise burst then silence, so the output is mostly the feedback loop ringing. */
+    template<typename sT>
+    juce::AudioBuffer<sT> MakeInput()
+    {
+        juce::AudioBuffer<sT> input{ numChannels, numSamples };
+        input.clear();
+        juce::Random random{ 1 };
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples / 4; i++)
+                input.setSample(channel, i, (sT)(random.nextFloat() * 2.0f - 1.0f));
+        return input;
+    }
+
+    template<typename sT>
+    juce::AudioBuffer<sT> Render(const juce::AudioBuffer<sT>& input, Penny::DelayInterpolation interpolation, float delay, int blockSize)
+    {
+        Penny::CombFilter<sT> filter{ numChannels, maxDelay };
+        filter.SetInterpolation(interpolation);
+        filter.SetDelay(delay);
+        filter.SetGain(feedbackGain);
+        filter.Prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<sT> output{ input };
+        for (int offset = 0; offset < numSamples; offset += blockSize)
+        {
+            Penny::AudioBufferView<sT> block{ output, offset, juce::jmin(blockSize, numSamples - offset) };
+            Penny::ProcessContext<sT> ctx{ block };
+            filter.Process(ctx);
+        }
+        return output;
+    }
+
+    /** The recursion one sample at a time in double precision, with the read of each interpolation written out. */
+    std::vector<double> RenderReference(const juce::AudioBuffer<float>& input, int channel, Penny::DelayInterpolation interpolation, double delay)
+    {
+        std::vector<double> w((size_t)numSamples, 0.0), output((size_t)numSamples, 0.0);
+        auto past = [&](int n, int k) { return n - k >= 0 ? w[(size_t)(n - k)] : 0.0; };
+        double thiranState = 0.0;
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            double delayed = 0.0;
+            if (interpolation == Penny::DelayInterpolation::Linear)
+            {
+                int d = (int)delay;
+                double fraction = delay - d;
+                delayed = past(n, d) * (1.0 - fraction) + past(n, d + 1) * fraction;
+            }
+            else if (interpolation == Penny::DelayInterpolation::Lagrange3)
+            {
+                // The 4 samples around the delay, the fractional part kept in [1, 2).
+                int d = (int)delay - 1;
+                double t = delay - d;
+                delayed = -past(n, d) * (t - 1) * (t - 2) * (t - 3) / 6 + past(n, d + 1) * t * (t - 2) * (t - 3) / 2
+                          - past(n, d + 2) * t * (t - 1) * (t - 3) / 2 + past(n, d + 3) * t * (t - 1) * (t - 2) / 6;
+            }
+            else
+            {
+                // First order allpass, the fractional part kept in [0.5, 1.5).
+                int d = (int)std::floor(delay - 0.5);
+                double fraction = delay - d;
+                double coefficient = (1 - fraction) / (1 + fraction);
+                thiranState = coefficient * (past(n, d) - thiranState) + past(n, d + 1);
+                delayed = thiranState;
+            }
+            w[(size_t)n] = input.getSample(channel, n) + (double)feedbackGain * delayed;
+            output[(size_t)n] = delayed;
+        }
+        return output;
+    }
+
+    /** Index of the first sample differing between a and b, -1 if they are bit identical. */
+    template<typename sT>
+    int FindFirstDifference(const juce::AudioBuffer<sT>& a, const juce::AudioBuffer<sT>& b, int& channel)
+    {
+        for (channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+                if (a.getSample(channel, i) != b.getSample(channel, i))
+                    return i;
+        return -1;
+    }
+
+    /** Check every block size against one sample blocks, and the result against the reference, return the failures. */
+    template<typename sT>
+    int CheckComb(const char* typeName, Penny::DelayInterpolation interpolation, float delay, double maxRelativeError)
+    {
+        juce::AudioBuffer<sT> input = MakeInput<sT>();
+        juce::AudioBuffer<float> floatInput{ numChannels, numSamples };
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+                floatInput.setSample(channel, i, (float)input.getSample(channel, i));
+        juce::AudioBuffer<sT> single = Render(input, interpolation, delay, 1);
+
+        int numFailures = 0;
+        for (int blockSize : { 2, 3, 64, 500, 4096 })
+        {
+            juce::AudioBuffer<sT> output = Render(input, interpolation, delay, blockSize);
+            int channel = 0;
+            int difference = FindFirstDifference(single, output, channel);
+            if (difference < 0)
+                continue;
+            std::printf("%s %-9s delay %6.2f block %4d: FAILED, channel %d differs from sample %d (%.9g != %.9g)\n", typeName,
+                        GetName(interpolation), delay, blockSize, channel, difference, (double)single.getSample(channel, difference),
+                        (double)output.getSample(channel, difference));
+            numFailures++;
+        }
+
+        double maxError = 0.0, peak = 0.0;
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            std::vector<double> reference = RenderReference(floatInput, channel, interpolation, (double)delay);
+            for (int i = 0; i < numSamples; i++)
+            {
+                maxError = juce::jmax(maxError, std::abs((double)single.getSample(channel, i) - reference[(size_t)i]));
+                peak = juce::jmax(peak, std::abs(reference[(size_t)i]));
+            }
+        }
+        double relativeError = maxError / peak;
+        if (relativeError > maxRelativeError)
+        {
+            std::printf("%s %-9s delay %6.2f: FAILED, relative error %.3g from the reference\n", typeName, GetName(interpolation),
+                        delay, relativeError);
+            return numFailures + 1;
+        }
+        if (numFailures == 0)
+            std::printf("%s %-9s delay %6.2f: bit identical across blocks, relative error %.3g\n", typeName, GetName(interpolation),
+                        delay, relativeError);
+        return numFailures;
+    }
+}
+
+int main()
+{
+    int numFailures = 0;
+    for (auto interpolation : { Penny::DelayInterpolation::Linear, Penny::DelayInterpolation::Lagrange3, Penny::DelayInterpolation::Thiran })
+    {
+        // A delay shorter than most blocks, so the filter has to cut them, and a longer one.
+        for (float delay : { 3.6f, 100.3f })
+        {
+            numFailures += CheckComb<float>("float ", interpolation, delay, 1e-4);
+            numFailures += CheckComb<double>("double", interpolation, delay, 1e-9);
+        }
+    }
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    The background threads of NonUniformConvolution must not change its output:
+    a convolution computing its large stages on worker threads is checked bit for bit
+    against the same convolution run on the calling thread only, offline, and paced
+    like a live host, where the workers must never be late.
+
+  ==============================================================================
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numChannels = 2;
+    constexpr int sampleRate = 44100;
+    constexpr int irLength = 24000;
+    constexpr int numSamples = 96000;
+
+    void FillNoise(juce::AudioBuffer<float>& buffer, int seed)
+    {
+        juce::Random random{ seed };
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                buffer.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    /**
+     * Stream the whole input through a convolution of ir, blockSize samples at a time.
+     * Real time, the blocks come no faster than a host would send them and the late blocks are counted in lateBlocks.
+     */
+    juce::AudioBuffer<float> Render(juce::AudioBuffer<float>& ir, const juce::AudioBuffer<float>& input,
+                                    int blockSize, int numThreads, bool realtime, int& lateBlocks)
+    {
+        Penny::NonUniformConvolution<float> convolution{ numChannels, 128, 8192 };
+        convolution.SetImpulseResponse(Penny::AudioBufferView<float>{ ir });
+        convolution.SetBackgroundThreads(numThreads, 256);
+        // Offline, the calling thread waits for a late worker instead of playing its block as silence.
+        convolution.SetNonRealtime(!realtime);
+        convolution.Prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> output{ input };
+        auto start = std::chrono::steady_clock::now();
+        for (int offset = 0; offset < output.getNumSamples(); offset += blockSize)
+        {
+            if (realtime)
+                std::this_thread::sleep_until(start + std::chrono::duration<double>((double)offset / sampleRate));
+            Penny::AudioBufferView<float> block{ output, offset, juce::jmin(blockSize, output.getNumSamples() - offset) };
+            Penny::ProcessContext<float> ctx{ block };
+            convolution.Process(ctx);
+        }
+        lateBlocks = convolution.GetLateBlocks();
+        return output;
+    }
+
+    /** Index of the first sample differing between a and b, -1 if they are bit identical. */
+    int FindFirstDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b, int& channel)
+    {
+        for (channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < a.getNumSamples(); i++)
+                if (a.getSample(channel, i) != b.getSample(channel, i))
+                    return i;
+        return -1;
+    }
+}
+
+int main()
+{
+    juce::AudioBuffer<float> ir{ numChannels, irLength }, input{ numChannels, numSamples };
+    FillNoise(ir, 1);
+    FillNoise(input, 2);
+    // A decaying IR, so every stage contributes in the same range as the head.
+    for (int channel = 0; channel < numChannels; channel++)
+        for (int i = 0; i < irLength; i++)
+            ir.setSample(channel, i, ir.getSample(channel, i) * std::exp(-(float)i / 6000.0f));
+
+    int numFailures = 0;
+    for (int blockSize : { 1, 32, 100, 512 })
+    {
+        for (bool realtime : { false, true })
+        {
+            // Pacing every block size would take seconds each, a host block of 512 is enough for the real time case.
+            if (realtime && blockSize != 512)
+                continue;
+            const char* mode = realtime ? "real time" : "offline";
+
+            int lateBlocks = 0;
+            juce::AudioBuffer<float> reference = Render(ir, input, blockSize, 0, false, lateBlocks);
+            juce::AudioBuffer<float> threaded = Render(ir, input, blockSize, 2, realtime, lateBlocks);
+            if (lateBlocks > 0)
+            {
+                std::printf("block %4d, %s: FAILED, %d late blocks\n", blockSize, mode, lateBlocks);
+                numFailures++;
+                continue;
+            }
+
+            int channel = 0;
+            int difference = FindFirstDifference(reference, threaded, channel);
+            if (difference < 0)
+            {
+                std::printf("block %4d, %s: bit identical\n", blockSize, mode);
+                continue;
+            }
+            std::printf("block %4d, %s: FAILED, channel %d differs from sample %d (%.9g != %.9g)\n", blockSize, mode, channel,
+                        difference, reference.getSample(channel, difference), threaded.getSample(channel, difference));
+            numFailures++;
+        }
+    }
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    The output of DeepReverb must not depend on how it is cut in blocks:
+    every host block and sub-block size is checked bit for bit against the same
+    input processed 64 samples at a time, at the host rate and resampled.
+    The host blocks go past the 67ms main loop delay.
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "DeepReverb.h"
+
+namespace
+{
+    constexpr int sampleRate = 44100;
+    constexpr int numSamples = sampleRate * 3 / 2;
+    constexpr int burstLength = sampleRate / 2;
+
+    /** Half a second of noise then silence, the tail is still well above the silence threshold at the end. */
+    juce::AudioBuffer<float> MakeInput()
+    {
+        juce::AudioBuffer<float> input{ DeepReverb<float>::numChannels, numSamples };
+        input.clear();
+        juce::Random random{ 1 };
+        for (int channel = 0; channel < input.getNumChannels(); channel++)
+            for (int i = 0; i < burstLength; i++)
+                input.setSample(channel, i, (random.nextFloat() * 2.0f - 1.0f) * 0.5f);
+        return input;
+    }
+
+    juce::AudioBuffer<float> Render(const juce::AudioBuffer<float>& input, int blockSize, int subBlockSize, int internalSampleRate)
+    {
+        DeepReverb<float> reverb{};
+        reverb.SetSubBlockSize(subBlockSize);
+        reverb.SetInternalSampleRate(internalSampleRate);
+        reverb.SetFeedback(0.8f);
+        reverb.SetDryWetMixRatio(1.0f);
+        reverb.Prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> output{ input };
+        for (int offset = 0; offset < numSamples; offset += blockSize)
+        {
+            Penny::AudioBufferView<float> block{ output, offset, juce::jmin(blockSize, numSamples - offset) };
+            reverb.Process(block);
+        }
+        return output;
+    }
+
+    /** Index of the first sample differing between a and b, -1 if they are bit identical. */
+    int FindFirstDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b, int& channel)
+    {
+        for (channel = 0; channel < a.getNumChannels(); channel++)
+            for (int i = 0; i < a.getNumSamples(); i++)
+                if (a.getSample(channel, i) != b.getSample(channel, i))
+                    return i;
+        return -1;
+    }
+}
+
+int main()
+{
+    juce::AudioBuffer<float> input = MakeInput();
+
+    int numFailures = 0;
+    for (int internalSampleRate : { 0, 48000 })
+    {
+        juce::AudioBuffer<float> reference = Render(input, 64, 64, internalSampleRate);
+        for (int subBlockSize : { 0, 64, 256 })
+        {
+            for (int blockSize : { 1, 37, 512, 4096, 8192 })
+            {
+                juce::AudioBuffer<float> output = Render(input, blockSize, subBlockSize, internalSampleRate);
+
+                int channel = 0;
+                int difference = FindFirstDifference(reference, output, channel);
+                if (difference < 0)
+                {
+                    std::printf("rate %5d, block %4d, sub-block %3d: bit identical\n", internalSampleRate, blockSize, subBlockSize);
+                    continue;
+                }
+                std::printf("rate %5d, block %4d, sub-block %3d: FAILED, channel %d differs from sample %d (%.9g != %.9g)\n",
+                            internalSampleRate, blockSize, subBlockSize, channel, difference,
+                            reference.getSample(channel, difference), output.getSample(channel, difference));
+                numFailures++;
+            }
+        }
+    }
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/*
+  ==============================================================================
+
+    FDN must compute its recursion whatever the block size, and decay at its decay time:
+    a network with damping is checked bit for bit across block sizes, against a per sample
+    reference with the mixing matrix written out, and the level of its impulse response
+    must fall by 60dB per decay time.
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numLines = 8;
+    constexpr int numChannels = 2;
+    constexpr int sampleRate = 48000;
+    constexpr int numSamples = sampleRate * 3 / 2;
+    constexpr float decayTime = 1.0f;
+    constexpr float dampingFrequency = 6000.0f;
+    const int delays[numLines] = { 401, 577, 691, 823, 967, 1109, 1249, 1399 };
+
+    /** One sample impulse on every channel. */
+    juce::AudioBuffer<double> MakeImpulse()
+    {
+        juce::AudioBuffer<double> input{ numChannels, numSamples };
+        input.clear();
+        for (int channel = 0; channel < numChannels; channel++)
+            input.setSample(channel, 0, 1.0);
+        return input;
+    }
+
+    template<typename MixingMatrix>
+    juce::AudioBuffer<double> Render(const juce::AudioBuffer<double>& input, float damping, int blockSize)
+    {
+        Penny::FDN<double, numLines, MixingMatrix> network{ numChannels, 2000 };
+        for (int line = 0; line < numLines; line++)
+            network.SetDelay(line, delays[line]);
+        network.SetDecayTime(decayTime);
+        network.SetDamping(damping);
+        network.Prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<double> output{ input };
+        for (int offset = 0; offset < numSamples; offset += blockSize)
+        {
+            Penny::AudioBufferView<double> block{ output, offset, juce::jmin(blockSize, numSamples - offset) };
+            Penny::ProcessContext<double> ctx{ block };
+            network.Process(ctx);
+        }
+        return output;
+    }
+
+    /** The network one sample at a time, with the unitary matrix as a full N x N product. */
+    juce::AudioBuffer<double> RenderReference(const juce::AudioBuffer<double>& input, const double (&matrix)[numLines][numLines], float damping)
+    {
+        std::vector<double> lines[numLines];
+        double gains[numLines], states[numLines] = {};
+        for (int i = 0; i < numLines; i++)
+        {
+            lines[i].assign((size_t)numSamples, 0.0);
+            gains[i] = std::pow(10.0, -3.0 * delays[i] / (decayTime * sampleRate));
+        }
+        double coefficient = damping > 0 ? 1.0 - std::exp(-2.0 * juce::MathConstants<double>::pi * damping / sampleRate) : 1.0;
+        double outputGain = std::sqrt((double)numChannels / numLines);
+
+        juce::AudioBuffer<double> output{ numChannels, numSamples };
+        output.clear();
+        for (int n = 0; n < numSamples; n++)
+        {
+            double rows[numLines], mixed[numLines] = {};
+            for (int i = 0; i < numLines; i++)
+            {
+                rows[i] = n >= delays[i] ? lines[i][(size_t)(n - delays[i])] : 0.0;
+                output.setSample(i % numChannels, n, output.getSample(i % numChannels, n) + rows[i] * outputGain);
+                states[i] += coefficient * (rows[i] * gains[i] - states[i]);
+            }
+            for (int i = 0; i < numLines; i++)
+                for (int j = 0; j < numLines; j++)
+                    mixed[i] += matrix[i][j] * states[j];
+            for (int i = 0; i < numLines; i++)
+                lines[i][(size_t)n] = mixed[i] + input.getSample(i % numChannels, n);
+        }
+        return output;
+    }
+
+    /** Check every block size against one sample blocks and the result against the reference, return the failures. */
+    template<typename MixingMatrix>
+    int CheckNetwork(const char* name, const double (&matrix)[numLines][numLines], float damping)
+    {
+        juce::AudioBuffer<double> input = MakeImpulse();
+        juce::AudioBuffer<double> single = Render<MixingMatrix>(input, damping, 1);
+        juce::AudioBuffer<double> reference = RenderReference(input, matrix, damping);
+
+        int numFailures = 0;
+        for (int blockSize : { 7, 64, 512, 4096 })
+        {
+            juce::AudioBuffer<double> output = Render<MixingMatrix>(input, damping, blockSize);
+            for (int channel = 0; channel < numChannels; channel++)
+                for (int i = 0; i < numSamples; i++)
+                    if (output.getSample(channel, i) != single.getSample(channel, i))
+                    {
+                        std::printf("%s damping %5.0f block %4d: FAILED, channel %d differs from sample %d\n", name, damping,
+                                    blockSize, channel, i);
+                        numFailures++;
+                        channel = numChannels;
+                        break;
+                    }
+        }
+
+        double maxError = 0.0;
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+                maxError = juce::jmax(maxError, std::abs(single.getSample(channel, i) - reference.getSample(channel, i)));
+        if (maxError > 1e-9)
+        {
+            std::printf("%s damping %5.0f: FAILED, error %.3g from the reference\n", name, damping, maxError);
+            return numFailures + 1;
+        }
+
+        // Without damping every line loses 60dB per decay time, so does the level of the whole network.
+        if (damping <= 0)
+        {
+            auto levelAt = [&](double time) {
+                int start = (int)(time * sampleRate), length = sampleRate / 10;
+                double energy = 0.0;
+                for (int channel = 0; channel < numChannels; channel++)
+                    for (int i = start; i < start + length; i++)
+                        energy += single.getSample(channel, i) * single.getSample(channel, i);
+                return 10.0 * std::log10(energy / length);
+            };
+            // The levels are one second apart.
+            double decayPerDecayTime = (levelAt(0.2) - levelAt(1.2)) * decayTime;
+            if (std::abs(decayPerDecayTime - 60.0) > 3.0)
+            {
+                std::printf("%s: FAILED, decays by %.1fdB per decay time instead of 60dB\n", name, decayPerDecayTime);
+                return numFailures + 1;
+            }
+            if (numFailures == 0)
+                std::printf("%s damping %5.0f: bit identical across blocks, error %.3g, %.1fdB per decay time\n", name, damping,
+                            maxError, decayPerDecayTime);
+            return numFailures;
+        }
+
+        if (numFailures == 0)
+            std::printf("%s damping %5.0f: bit identical across blocks, error %.3g\n", name, damping, maxError);
+        return numFailures;
+    }
+}
+
+int main()
+{
+    double hadamard[numLines][numLines], householder[numLines][numLines];
+    for (int i = 0; i < numLines; i++)
+        for (int j = 0; j < numLines; j++)
+        {
+            // Sylvester order, the sign is the parity of the common bits of the row and column.
+            int commonBits = 0;
+            for (int bits = i & j; bits != 0; bits >>= 1)
+                commonBits += bits & 1;
+            hadamard[i][j] = (commonBits % 2 == 0 ? 1.0 : -1.0) / std::sqrt((double)numLines);
+            householder[i][j] = (i == j ? 1.0 : 0.0) - 2.0 / numLines;
+        }
+
+    int numFailures = 0;
+    for (float damping : { 0.0f, dampingFrequency })
+    {
+        numFailures += CheckNetwork<Penny::HadamardMatrix>("Hadamard   ", hadamard, damping);
+        numFailures += CheckNetwork<Penny::HouseholderMatrix>("Householder", householder, damping);
+    }
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    FFTConvolution must compute the same convolution as the direct form:
+    its output is checked against Convolution::Convolve in double precision,
+    at block sizes below, equal to, above and not multiple of the partition size.
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numChannels = 2;
+    constexpr int sampleRate = 48000;
+    constexpr int partitionSize = 512;
+    constexpr int irLength = 3000;
+    constexpr int numSamples = 20000;
+    // The float path is about 2.5e-7 off the double reference, relative to the peak of the output.
+    constexpr double maxRelativeError = 1e-5;
+
+    void FillNoise(juce::AudioBuffer<float>& buffer, int seed)
+    {
+        juce::Random random{ seed };
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                buffer.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    /** The direct form convolution of the whole input, in double precision. */
+    juce::AudioBuffer<double> RenderDirect(const juce::AudioBuffer<float>& ir, const juce::AudioBuffer<float>& input)
+    {
+        juce::AudioBuffer<double> irDouble{ numChannels, irLength }, inputDouble{ numChannels, numSamples };
+        irDouble.makeCopyOf(ir);
+        inputDouble.makeCopyOf(input);
+        juce::AudioBuffer<double> output{ numChannels, numSamples + irLength - 1 };
+        output.clear();
+
+        Penny::AudioBufferView<double> inputView{ inputDouble }, irView{ irDouble }, outputView{ output };
+        Penny::Convolution<double>::Convolve(inputView, irView, outputView);
+        return output;
+    }
+
+    /** Stream the whole input through an FFTConvolution of ir, blockSize samples at a time. */
+    juce::AudioBuffer<float> RenderFFT(juce::AudioBuffer<float>& ir, const juce::AudioBuffer<float>& input, int blockSize)
+    {
+        Penny::FFTConvolution<float> convolution{ numChannels, partitionSize };
+        convolution.SetIRCache(nullptr);
+        convolution.SetImpulseResponse(Penny::AudioBufferView<float>{ ir });
+        convolution.Prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> output{ input };
+        for (int offset = 0; offset < output.getNumSamples(); offset += blockSize)
+        {
+            Penny::AudioBufferView<float> block{ output, offset, juce::jmin(blockSize, output.getNumSamples() - offset) };
+            Penny::ProcessContext<float> ctx{ block };
+            convolution.Process(ctx);
+        }
+        return output;
+    }
+}
+
+int main()
+{
+    juce::AudioBuffer<float> ir{ numChannels, irLength }, input{ numChannels, numSamples };
+    FillNoise(ir, 1);
+    FillNoise(input, 2);
+    juce::AudioBuffer<double> reference = RenderDirect(ir, input);
+
+    double peak = 0.0;
+    for (int channel = 0; channel < numChannels; channel++)
+        for (int i = 0; i < numSamples; i++)
+            peak = juce::jmax(peak, std::abs(reference.getSample(channel, i)));
+
+    int numFailures = 0;
+    for (int blockSize : { 1, 37, 64, 512, 1000 })
+    {
+        juce::AudioBuffer<float> output = RenderFFT(ir, input, blockSize);
+
+        double maxError = 0.0;
+        int worstChannel = 0, worstSample = 0;
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+            {
+                double error = std::abs(output.getSample(channel, i) - reference.getSample(channel, i));
+                if (error > maxError)
+                {
+                    maxError = error;
+                    worstChannel = channel;
+                    worstSample = i;
+                }
+            }
+
+        double relativeError = maxError / peak;
+        if (relativeError <= maxRelativeError)
+        {
+            std::printf("block %4d: relative error %.3g\n", blockSize, relativeError);
+            continue;
+        }
+        std::printf("block %4d: FAILED, relative error %.3g, channel %d sample %d (%.9g != %.9g)\n", blockSize, relativeError,
+                    worstChannel, worstSample, output.getSample(worstChannel, worstSample),
+                    reference.getSample(worstChannel, worstSample));
+        numFailures++;
+    }
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+    Resampler must convert the rate whatever the block size: for fractional and integer
+    factors, up and down, every block size is checked bit for bit against the whole input
+    converted at once, the number of output samples against the ratio of the rates,
+    a sine in the passband against the same sine at the output rate, delayed by the latency,
+    and a sine above the lower Nyquist frequency must be rejected.
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numChannels = 2;
+    constexpr int preparedBlockSize = 512;
+    constexpr double inputLength = 0.5;
+    constexpr double sineFrequency = 1000.0;
+    constexpr double sineAmplitude = 0.5;
+    // The passband ripple of the filter, relative to the amplitude of the sine.
+    constexpr double maxPassbandError = 1e-3;
+    constexpr double minRejectionInDecibels = 60.0;
+
+    juce::AudioBuffer<double> MakeSine(int sampleRate, double frequency)
+    {
+        juce::AudioBuffer<double> input{ numChannels, (int)(inputLength * sampleRate) };
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < input.getNumSamples(); i++)
+                input.setSample(channel, i, sineAmplitude * std::sin(2.0 * juce::MathConstants<double>::pi * frequency * i / sampleRate));
+        return input;
+    }
+
+    /** Convert the whole input blockSize samples at a time, the output is sized to the samples written. */
+    juce::AudioBuffer<double> Render(juce::AudioBuffer<double>& input, int inputRate, int outputRate, int blockSize, double& latency)
+    {
+        Penny::Resampler<double> resampler{ numChannels };
+        resampler.SetOutputSampleRate(outputRate);
+        resampler.Prepare(inputRate, preparedBlockSize);
+        latency = resampler.GetLatencyInSamples();
+
+        int numInputSamples = input.getNumSamples();
+        juce::AudioBuffer<double> output{ numChannels, resampler.GetMaxOutputSamples(numInputSamples) + blockSize };
+        juce::AudioBuffer<double> blockOutput{ numChannels, resampler.GetMaxOutputSamples(blockSize) };
+        int numWritten = 0;
+        for (int offset = 0; offset < numInputSamples; offset += blockSize)
+        {
+            int length = juce::jmin(blockSize, numInputSamples - offset);
+            Penny::AudioBufferView<double> inputView{ input, offset, length };
+            Penny::AudioBufferView<double> outputView{ blockOutput, 0, resampler.GetMaxOutputSamples(length) };
+            int written = resampler.Process(inputView, outputView);
+            for (int channel = 0; channel < numChannels; channel++)
+                output.copyFrom(channel, numWritten, blockOutput, channel, 0, written);
+            numWritten += written;
+        }
+        output.setSize(numChannels, numWritten, true);
+        return output;
+    }
+
+    /** Largest error from the input sine delayed by the latency, once the filter is full and before it empties. */
+    double GetPassbandError(const juce::AudioBuffer<double>& output, int inputRate, int outputRate, double latency)
+    {
+        double ratio = (double)outputRate / inputRate;
+        int margin = (int)std::ceil(latency * 2.0 * ratio) + 1;
+        double maxError = 0.0;
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = margin; i < output.getNumSamples() - margin; i++)
+            {
+                double time = (double)i / outputRate - latency / inputRate;
+                double expected = sineAmplitude * std::sin(2.0 * juce::MathConstants<double>::pi * sineFrequency * time);
+                maxError = juce::jmax(maxError, std::abs(output.getSample(channel, i) - expected));
+            }
+        return maxError / sineAmplitude;
+    }
+
+    /** Level of what is left of the sine, relative to its amplitude. */
+    double GetLevelInDecibels(const juce::AudioBuffer<double>& output, int skip)
+    {
+        double peak = 0.0;
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = skip; i < output.getNumSamples() - skip; i++)
+                peak = juce::jmax(peak, std::abs(output.getSample(channel, i)));
+        return 20.0 * std::log10(juce::jmax(peak, 1e-30) / sineAmplitude);
+    }
+
+    int CheckRates(int inputRate, int outputRate)
+    {
+        juce::AudioBuffer<double> input = MakeSine(inputRate, sineFrequency);
+        double latency = 0.0;
+        juce::AudioBuffer<double> whole = Render(input, inputRate, outputRate, input.getNumSamples(), latency);
+
+        int numFailures = 0;
+        long long expectedLength = ((long long)input.getNumSamples() * outputRate + inputRate - 1) / inputRate;
+        if (whole.getNumSamples() != expectedLength)
+        {
+            std::printf("%6d -> %6d: FAILED, %d samples written instead of %lld\n", inputRate, outputRate, whole.getNumSamples(), expectedLength);
+            numFailures++;
+        }
+
+        // Blocks shorter than, equal to and longer than the prepared block.
+        for (int blockSize : { 1, 37, preparedBlockSize, 3000 })
+        {
+            juce::AudioBuffer<double> output = Render(input, inputRate, outputRate, blockSize, latency);
+            bool isIdentical = output.getNumSamples() == whole.getNumSamples();
+            for (int channel = 0; channel < numChannels && isIdentical; channel++)
+                for (int i = 0; i < output.getNumSamples() && isIdentical; i++)
+                    isIdentical = output.getSample(channel, i) == whole.getSample(channel, i);
+            if (!isIdentical)
+            {
+                std::printf("%6d -> %6d block %4d: FAILED, differs from the whole input converted at once\n", inputRate, outputRate, blockSize);
+                numFailures++;
+            }
+        }
+
+        double passbandError = GetPassbandError(whole, inputRate, outputRate, latency);
+        if (passbandError > maxPassbandError)
+        {
+            std::printf("%6d -> %6d: FAILED, the passband sine is %.3g off\n", inputRate, outputRate, passbandError);
+            numFailures++;
+        }
+
+        // Above the Nyquist frequency of the lower rate, the sine would fold back into the band.
+        double rejection = 0.0;
+        int lowerRate = juce::jmin(inputRate, outputRate);
+        if (lowerRate < inputRate)
+        {
+            juce::AudioBuffer<double> highSine = MakeSine(inputRate, lowerRate * 0.5 + 4000.0);
+            juce::AudioBuffer<double> aliased = Render(highSine, inputRate, outputRate, preparedBlockSize, latency);
+            rejection = -GetLevelInDecibels(aliased, (int)std::ceil(latency * 2.0 * outputRate / inputRate) + 1);
+            if (rejection < minRejectionInDecibels)
+            {
+                std::printf("%6d -> %6d: FAILED, a sine above the output Nyquist frequency is only %.1fdB down\n", inputRate,
+                            outputRate, rejection);
+                numFailures++;
+            }
+        }
+
+        if (numFailures == 0)
+        {
+            std::printf("%6d -> %6d: bit identical across blocks, passband error %.3g", inputRate, outputRate, passbandError);
+            if (rejection > 0.0)
+                std::printf(", alias %.1fdB down", rejection);
+            std::printf("\n");
+        }
+        return numFailures;
+    }
+}
+
+int main()
+{
+    int numFailures = 0;
+    numFailures += CheckRates(44100, 48000);
+    numFailures += CheckRates(48000, 44100);
+    numFailures += CheckRates(48000, 96000);
+    numFailures += CheckRates(96000, 48000);
+    return numFailures == 0 ? 0 : 1;
+}
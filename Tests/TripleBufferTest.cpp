@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    TripleBuffer must hand the reader whole values, in order, and always the latest:
+    its single thread semantics are checked step by step, then a writer thread publishes
+    a million values the reader thread checks for tearing, going back in time and
+    missing the last one.
+
+  ==============================================================================
+*/
+
+#include <cstdio>
+#include <thread>
+
+#include <PennyDSP/PennyDSP.h>
+
+namespace
+{
+    constexpr int numValues = 1000000;
+    constexpr int numFields = 16;
+
+    /** A value spanning several words, every field derives from the sequence number so a torn read shows. */
+    struct Value
+    {
+        int sequence;
+        int fields[numFields];
+    };
+
+    Value MakeValue(int sequence)
+    {
+        Value value{};
+        value.sequence = sequence;
+        for (int i = 0; i < numFields; i++)
+            value.fields[i] = sequence * (i + 1);
+        return value;
+    }
+
+    bool IsWhole(const Value& value)
+    {
+        for (int i = 0; i < numFields; i++)
+            if (value.fields[i] != value.sequence * (i + 1))
+                return false;
+        return true;
+    }
+
+    int CheckSingleThread()
+    {
+        Penny::TripleBuffer<int> buffer{ -1 };
+        int numFailures = 0;
+        auto expect = [&](bool condition, const char* what) {
+            if (condition)
+                return;
+            std::printf("single thread: FAILED, %s\n", what);
+            numFailures++;
+        };
+
+        expect(buffer.Get() == -1, "Get before the first Acquire is not the initial value");
+        expect(!buffer.Acquire(), "Acquire found a value before any Publish");
+        buffer.Publish(1);
+        expect(buffer.Acquire() && buffer.Get() == 1, "Acquire did not take the published value");
+        expect(!buffer.Acquire() && buffer.Get() == 1, "a second Acquire found a new value or lost the current one");
+        buffer.Publish(2);
+        buffer.Publish(3);
+        expect(buffer.Acquire() && buffer.Get() == 3, "Acquire did not take the latest of two values");
+        buffer.GetWriteBuffer() = 4;
+        expect(!buffer.Acquire() && buffer.Get() == 3, "a value written but not published was taken");
+        buffer.Publish();
+        expect(buffer.Acquire() && buffer.Get() == 4, "Publish did not send the write buffer");
+
+        if (numFailures == 0)
+            std::printf("single thread: every step as expected\n");
+        return numFailures;
+    }
+
+    int CheckTwoThreads()
+    {
+        Penny::TripleBuffer<Value> buffer{ MakeValue(0) };
+        std::thread writer{ [&] {
+            for (int sequence = 1; sequence <= numValues; sequence++)
+                buffer.Publish(MakeValue(sequence));
+        } };
+
+        int last = 0, numAcquired = 0, numTorn = 0, numBackwards = 0;
+        while (last < numValues)
+        {
+            if (!buffer.Acquire())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            const Value& value = buffer.Get();
+            numAcquired++;
+            if (!IsWhole(value))
+                numTorn++;
+            if (value.sequence <= last)
+                numBackwards++;
+            last = value.sequence;
+        }
+        writer.join();
+
+        // The reader stops at the last value, so it did not miss it.
+        if (numTorn > 0 || numBackwards > 0)
+        {
+            std::printf("two threads: FAILED, %d torn values and %d values going back out of %d taken\n", numTorn, numBackwards, numAcquired);
+            return 1;
+        }
+        std::printf("two threads: %d values taken in order out of %d, none torn\n", numAcquired, numValues);
+        return 0;
+    }
+}
+
+int main()
+{
+    int numFailures = CheckSingleThread() + CheckTwoThreads();
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/*
+  ==============================================================================
+
+    penny-render, streams a WAV file through DeepReverb without a host.
+
+  ==============================================================================
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "DeepReverb.h"
+#include "DeepReverbBatch.h"
+
+namespace
+{
+    constexpr int numChannels = DeepReverb<float>::numChannels;
+
+    struct Options
+    {
+        juce::String inputPath, outputPath;
+        int blockSize = 512;
+        int subBlockSize = 256;
+        int internalSampleRate = 0;
+        float feedback = 0.5f, size = 0.5f, drywetmixratio = 0.5f;
+        int numInstances = 0;
+        bool profile = false;
+        bool doublePrecision = false;
+        int numThreads = juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+    };
+
+    void PrintUsage()
+    {
+        std::printf("usage: penny-render <input.wav> [output.wav] [options]\n"
+                    "  --block-size <n>       samples per Process call (512)\n"
+                    "  --sub-block-size <n>   samples per graph sub-block, 0 for the whole block (256)\n"
+                    "  --internal-rate <hz>   run the graph resampled to this rate, 0 for the file rate (0)\n"
+                    "  --feedback <0..1>      (0.5)\n"
+                    "  --size <0..1>          (0.5)\n"
+                    "  --mix <0..1>           dry/wet mix ratio (0.5)\n"
+                    "  --instances <n>        render n voices with the batch renderer and report the throughput\n"
+                    "  --threads <n>          worker threads of the batch renderer (cpus - 1)\n"
+                    "  --double               process in double precision (single voice only)\n"
+                    "  --profile              print the time spent in every stage, needs a PENNY_PROFILING build\n");
+    }
+
+    bool ParseOptions(int argc, char* argv[], Options& options)
+    {
+        juce::StringArray positional;
+        for (int i = 1; i < argc; i++)
+        {
+            juce::String arg{ argv[i] };
+            if (!arg.startsWith("--"))
+            {
+                positional.add(arg);
+                continue;
+            }
+            if (arg == "--profile")
+            {
+                options.profile = true;
+                continue;
+            }
+            if (arg == "--double")
+            {
+                options.doublePrecision = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                return false;
+
+            juce::String value{ argv[++i] };
+            if (arg == "--block-size")           options.blockSize = value.getIntValue();
+            else if (arg == "--sub-block-size")  options.subBlockSize = value.getIntValue();
+            else if (arg == "--internal-rate")   options.internalSampleRate = value.getIntValue();
+            else if (arg == "--feedback")        options.feedback = value.getFloatValue();
+            else if (arg == "--size")            options.size = value.getFloatValue();
+            else if (arg == "--mix")             options.drywetmixratio = value.getFloatValue();
+            else if (arg == "--instances")       options.numInstances = value.getIntValue();
+            else if (arg == "--threads")         options.numThreads = value.getIntValue();
+            else return false;
+        }
+
+        if (positional.size() < 1 || positional.size() > 2)
+            return false;
+        options.inputPath = positional[0];
+        options.outputPath = positional[1];
+        return options.blockSize > 0 && options.subBlockSize >= 0 && options.internalSampleRate >= 0
+            && options.numInstances >= 0 && options.numThreads > 0;
+    }
+
+    template<typename sT>
+    void Configure(DeepReverb<sT>& reverb, const Options& options)
+    {
+        reverb.SetSubBlockSize(options.subBlockSize);
+        reverb.SetInternalSampleRate(options.internalSampleRate);
+        reverb.SetFeedback(options.feedback);
+        reverb.SetSize(options.size);
+        reverb.SetDryWetMixRatio(options.drywetmixratio);
+    }
+
+    /**
+        Read numSamples samples from startSample into the numChannels channels of block, mono is duplicated.
+        Past the end of the file the block is silent, it feeds the reverb tail.
+    */
+    void ReadBlock(juce::AudioFormatReader& reader, juce::AudioBuffer<float>& block, juce::int64 startSample, int numSamples)
+    {
+        int numFileSamples = (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples, reader.lengthInSamples - startSample);
+        int numReadChannels = juce::jmin((int)reader.numChannels, numChannels);
+        if (numFileSamples > 0)
+            reader.read(block.getArrayOfWritePointers(), numReadChannels, startSample, numFileSamples);
+        for (int i = numReadChannels; i < numChannels; i++)
+            block.copyFrom(i, 0, block, 0, 0, numFileSamples);
+        block.clear(numFileSamples, numSamples - numFileSamples);
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> CreateWriter(const Options& options, double sampleRate)
+    {
+        if (options.outputPath.isEmpty())
+            return {};
+
+        juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(options.outputPath);
+        file.deleteFile();
+        std::unique_ptr<juce::FileOutputStream> stream{ file.createOutputStream() };
+        if (stream == nullptr)
+            return {};
+
+        juce::WavAudioFormat format{};
+        std::unique_ptr<juce::AudioFormatWriter> writer{ format.createWriterFor(stream.get(), sampleRate, numChannels, 24, {}, 0) };
+        if (writer != nullptr)
+            stream.release();
+        return writer;
+    }
+
+    double GetPercentile(std::vector<double>& sorted, double percentile)
+    {
+        size_t index = (size_t)(percentile / 100.0 * (double)(sorted.size() - 1) + 0.5);
+        return sorted[juce::jmin(index, sorted.size() - 1)];
+    }
+
+    /** Stream the file through a single voice, one block at a time, timing every Process call. */
+    template<typename sT>
+    int RenderSingle(juce::AudioFormatReader& reader, const Options& options)
+    {
+        std::unique_ptr<juce::AudioFormatWriter> writer = CreateWriter(options, reader.sampleRate);
+        if (options.outputPath.isNotEmpty() && writer == nullptr)
+        {
+            std::printf("error: cannot write %s\n", options.outputPath.toRawUTF8());
+            return 1;
+        }
+
+        DeepReverb<sT> reverb{};
+        Configure(reverb, options);
+
+        std::unique_ptr<Penny::Profiler> profiler{};
+        if (options.profile)
+        {
+           #if PENNY_PROFILING
+            profiler = std::make_unique<Penny::Profiler>();
+            profiler->SetSampleRate(reader.sampleRate);
+            // Offline, every block can be profiled.
+            profiler->SetStageInterval(1);
+            reverb.SetProfiler(profiler.get());
+           #else
+            std::printf("warning: --profile needs a build with PENNY_PROFILING, ignored\n");
+           #endif
+        }
+        reverb.Prepare((int)reader.sampleRate, options.blockSize);
+
+        // The file is followed by the reverb tail, rendered from silence.
+        juce::int64 renderLength = reader.lengthInSamples + reverb.GetTailLengthInSamples();
+
+        // The file is read and written in float, samples is what the voice processes.
+        juce::AudioBuffer<float> block{ numChannels, options.blockSize };
+        juce::AudioBuffer<sT> samples{ numChannels, options.blockSize };
+        std::vector<double> blockTimes{};
+        blockTimes.reserve((size_t)(renderLength / options.blockSize + 1));
+        double processTime = 0;
+
+        for (juce::int64 position = 0; position < renderLength; position += options.blockSize)
+        {
+            int numSamples = (int)juce::jmin((juce::int64)options.blockSize, renderLength - position);
+            ReadBlock(reader, block, position, numSamples);
+            samples.makeCopyOf(block, true);
+
+            Penny::AudioBufferView<sT> view{ samples, 0, numSamples };
+            auto start = std::chrono::steady_clock::now();
+            {
+                PENNY_PROFILE_BLOCK(profiler.get(), numSamples);
+                reverb.Process(view);
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            processTime += elapsed;
+            blockTimes.push_back(elapsed);
+
+            if (writer != nullptr)
+            {
+                block.makeCopyOf(samples, true);
+                writer->writeFromAudioSampleBuffer(block, 0, numSamples);
+            }
+            if (profiler != nullptr)
+                profiler->Collect();
+        }
+
+        double audioTime = (double)renderLength / reader.sampleRate;
+        double blockDeadline = options.blockSize / reader.sampleRate;
+        std::sort(blockTimes.begin(), blockTimes.end());
+
+        std::printf("rendered %.2f s of audio (%.2f s of tail) at %.0f Hz in %s precision, block %d, sub-block %d\n",
+                    audioTime, reverb.GetTailLengthInSamples() / reader.sampleRate, reader.sampleRate,
+                    sizeof(sT) == sizeof(double) ? "double" : "single", options.blockSize, options.subBlockSize);
+        if (reverb.GetLatencyInSamples() != 0)
+            std::printf("graph resampled to %d Hz, latency %d samples\n", options.internalSampleRate, reverb.GetLatencyInSamples());
+        std::printf("real-time factor: %.1fx (%.3f s of processing)\n", audioTime / processTime, processTime);
+        std::printf("block latency (us): p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f  (deadline %.2f)\n",
+                    GetPercentile(blockTimes, 50) * 1e6, GetPercentile(blockTimes, 90) * 1e6, GetPercentile(blockTimes, 99) * 1e6,
+                    GetPercentile(blockTimes, 99.9) * 1e6, blockTimes.back() * 1e6, blockDeadline * 1e6);
+        if (profiler != nullptr)
+            std::printf("\n%s", profiler->GetReport().c_str());
+        return 0;
+    }
+
+    /** Render the whole file through numInstances voices at once, voice 0 is written. */
+    int RenderBatch(juce::AudioFormatReader& reader, const Options& options)
+    {
+        DeepReverbBatch batch{ options.numInstances, options.numThreads };
+        for (int i = 0; i < options.numInstances; i++)
+            Configure(batch.GetVoice(i), options);
+        batch.Prepare((int)reader.sampleRate, options.blockSize);
+
+        // Every voice has the same settings, so the same tail.
+        juce::int64 renderLength = reader.lengthInSamples + batch.GetVoice(0).GetTailLengthInSamples();
+        if (renderLength > std::numeric_limits<int>::max())
+        {
+            std::printf("error: %s is too long for the batch renderer\n", options.inputPath.toRawUTF8());
+            return 1;
+        }
+
+        int numSamples = (int)renderLength;
+        juce::AudioBuffer<float> input{ numChannels, numSamples };
+        ReadBlock(reader, input, 0, numSamples);
+
+        std::vector<juce::AudioBuffer<float>> buffers((size_t)options.numInstances, input);
+        std::vector<juce::AudioBuffer<float>*> bufferPtrs{};
+        for (auto& buffer : buffers)
+            bufferPtrs.push_back(&buffer);
+
+        auto start = std::chrono::steady_clock::now();
+        batch.Render(bufferPtrs.data());
+        double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double audioTime = (double)numSamples / reader.sampleRate;
+        std::printf("rendered %d instances x %.2f s of audio at %.0f Hz on %d + 1 threads, block %d, sub-block %d\n",
+                    options.numInstances, audioTime, reader.sampleRate, batch.GetNumThreads(), options.blockSize, options.subBlockSize);
+        std::printf("throughput: %.1f instance-seconds per wall-second (%.3f s wall)\n",
+                    options.numInstances * audioTime / wallTime, wallTime);
+
+        if (options.outputPath.isNotEmpty())
+        {
+            std::unique_ptr<juce::AudioFormatWriter> writer = CreateWriter(options, reader.sampleRate);
+            if (writer == nullptr || !writer->writeFromAudioSampleBuffer(buffers[0], 0, numSamples))
+            {
+                std::printf("error: cannot write %s\n", options.outputPath.toRawUTF8());
+                return 1;
+            }
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options{};
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    juce::File inputFile = juce::File::getCurrentWorkingDirectory().getChildFile(options.inputPath);
+    std::unique_ptr<juce::FileInputStream> stream{ inputFile.createInputStream() };
+    if (stream == nullptr)
+    {
+        std::printf("error: cannot open %s\n", options.inputPath.toRawUTF8());
+        return 1;
+    }
+
+    juce::WavAudioFormat format{};
+    std::unique_ptr<juce::AudioFormatReader> reader{ format.createReaderFor(stream.get(), false) };
+    if (reader == nullptr)
+    {
+        std::printf("error: cannot read %s\n", options.inputPath.toRawUTF8());
+        return 1;
+    }
+    stream.release();
+    if (reader->lengthInSamples == 0)
+    {
+        std::printf("error: %s is empty\n", options.inputPath.toRawUTF8());
+        return 1;
+    }
+
+    if (options.numInstances > 0)
+        return RenderBatch(*reader, options);
+    return options.doublePrecision ? RenderSingle<double>(*reader, options) : RenderSingle<float>(*reader, options);
+}